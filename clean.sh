@@ -1,2 +1,2 @@
 #!/bin/sh
-rm `find . -name *.o` tools/* novaplc writefifo
+rm `find . -name *.o` tools/* novaplc writefifo modbus_bench
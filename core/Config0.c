@@ -25,5 +25,55 @@ void RES0_run__(unsigned long tick);
 void config_run__(unsigned long tick) {
   RES0_run__(tick);
 }
+
+extern IEC_TASK RES0__tasks__[];
+
+IEC_TASK *config_tasks__[] = {
+  RES0__tasks__,
+  NULL
+};
 unsigned long long common_ticktime__ = 50000000ULL; /*ns*/
 unsigned long greatest_tick_count__ = (unsigned long)0UL; /*tick*/
+
+
+
+void _backup__(void *varptr, int varsize, void **buffer, int *maxsize) {
+  if (varsize <= *maxsize) {memmove(*buffer, varptr, varsize); *buffer = (char *)*buffer + varsize;}
+  *maxsize -= varsize;
+}
+void _restore__(void *varptr, int varsize, void **buffer, int *maxsize) {
+  if (varsize <= *maxsize) {memmove(varptr, *buffer, varsize); *buffer = (char *)*buffer + varsize;}
+  *maxsize -= varsize;
+}
+
+
+
+#undef __DECLARE_GLOBAL
+#undef __DECLARE_GLOBAL_FB
+#undef __DECLARE_GLOBAL_LOCATION
+#undef __DECLARE_GLOBAL_LOCATED
+void RES0_retain__(__IEC_RETAIN_OP op, void **buffer, int *maxsize);
+
+void config_retain__(__IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  #define __DECLARE_GLOBAL(vartype, domain, varname) \
+    __RETAIN_VAR(domain##__##varname)
+  #define __DECLARE_GLOBAL_FB(vartype, domain, varname) \
+    __RETAIN_FB(vartype, domain##__##varname)
+  #define __DECLARE_GLOBAL_LOCATION(vartype, location)
+  #define __DECLARE_GLOBAL_LOCATED(vartype, domain, varname) \
+    __RETAIN_LOCATED(domain##__##varname)
+
+  RES0_retain__(op, buffer, maxsize);
+  #undef __DECLARE_GLOBAL
+  #undef __DECLARE_GLOBAL_FB
+  #undef __DECLARE_GLOBAL_LOCATION
+  #undef __DECLARE_GLOBAL_LOCATED
+}
+
+void config_backup__(void **buffer, int *maxsize) {
+  config_retain__(_backup__, buffer, maxsize);
+}
+
+void config_restore__(void **buffer, int *maxsize) {
+  config_retain__(_restore__, buffer, maxsize);
+}
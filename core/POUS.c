@@ -7,6 +7,13 @@ void MY_PROGRAM_init__(MY_PROGRAM *data__, BOOL retain) {
   __INIT_VAR(data__->NOT9_OUT,__BOOL_LITERAL(FALSE),retain)
 }
 
+void MY_PROGRAM_retain__(MY_PROGRAM *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_LOCATED(data__->BUTTON)
+  __RETAIN_LOCATED(data__->LAMP)
+  __RETAIN_FB(TOF,data__->T0)
+  __RETAIN_VAR(data__->NOT9_OUT)
+}
+
 // Code part
 void MY_PROGRAM_body__(MY_PROGRAM *data__) {
   // Initialise TEMP variables
@@ -18,6 +18,7 @@ typedef struct {
 } MY_PROGRAM;
 
 void MY_PROGRAM_init__(MY_PROGRAM *data__, BOOL retain);
+void MY_PROGRAM_retain__(MY_PROGRAM *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize);
 // Code part
 void MY_PROGRAM_body__(MY_PROGRAM *data__);
 #endif //__POUS_H
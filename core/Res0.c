@@ -35,3 +35,37 @@ void RES0_run__(unsigned long tick) {
   }
 }
 
+void RES0__TASKMAIN_run__(unsigned long tick) {
+  TASKMAIN = 1;
+  if (TASKMAIN) {
+    MY_PROGRAM_body__(&INST0);
+  }
+}
+
+IEC_TASK RES0__tasks__[] = {
+  {"TASKMAIN", RES0__TASKMAIN_run__, 50000000ULL, 0},
+  {NULL, NULL, 0ULL, 0}
+};
+
+
+
+
+#undef __DECLARE_GLOBAL
+#undef __DECLARE_GLOBAL_FB
+#undef __DECLARE_GLOBAL_LOCATION
+#undef __DECLARE_GLOBAL_LOCATED
+
+void RES0_retain__(__IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  #define __DECLARE_GLOBAL(vartype, domain, varname) \
+    __RETAIN_VAR(domain##__##varname)
+  #define __DECLARE_GLOBAL_FB(vartype, domain, varname) \
+    __RETAIN_FB(vartype, domain##__##varname)
+  #define __DECLARE_GLOBAL_LOCATION(vartype, location)
+  #define __DECLARE_GLOBAL_LOCATED(vartype, domain, varname) \
+    __RETAIN_LOCATED(domain##__##varname)
+  __RETAIN_FB(MY_PROGRAM,INST0)
+  #undef __DECLARE_GLOBAL
+  #undef __DECLARE_GLOBAL_FB
+  #undef __DECLARE_GLOBAL_LOCATION
+  #undef __DECLARE_GLOBAL_LOCATED
+}
@@ -0,0 +1,449 @@
+//-----------------------------------------------------------------------------
+// Copyright 2019 Novasom Industries
+//
+// Based on the software by Thiago Alves
+// This file is part of the OpenPLC Software Stack.
+//
+// OpenPLC is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenPLC is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenPLC.  If not, see <http://www.gnu.org/licenses/>.
+//------
+//
+// This is the control socket of the OpenPLC. A Unix domain socket takes one
+// command per line and answers every command with one line:
+//
+//     START        -> OK RUNNING
+//     PAUSE        -> OK PAUSED
+//     STOP         -> OK STOPPED, then the outputs go low and the runtime exits
+//     STEP [n]     -> OK STEP <tick>, once n scans have run (only when paused)
+//     STATUS       -> OK <state> tick <n> cycles <n> overruns <n>
+//     FORCE <var> <value>  -> OK FORCED <var>, e.g. FORCE %QX0.1 1 or FORCE %MW3 100
+//     UNFORCE <var>|ALL    -> OK UNFORCED <var>
+//
+// The socket is served by a thread with a normal priority. The scan thread
+// only reads plc_state at the start of each cycle; the scans run by STEP are
+// reported back through an eventfd so the answer waits for them.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "ladder.h"
+
+#define CONTROL_MAX_CLIENTS		8
+#define CONTROL_LINE_SIZE		128
+#define CONTROL_MAX_EVENTS		(CONTROL_MAX_CLIENTS + 2)
+
+//epoll tags, the clients are tagged with their slot
+#define CONTROL_TAG_LISTEN		CONTROL_MAX_CLIENTS
+#define CONTROL_TAG_STEP		(CONTROL_MAX_CLIENTS + 1)
+
+//defaults, can be changed in novaplc.cfg
+#define DEFAULT_CONTROL_SOCKET	"/tmp/novaplc.sock"
+
+struct control_client
+{
+	int fd; //-1 if the slot is free
+	int rx_len;
+	char rx_buffer[CONTROL_LINE_SIZE];
+	uint64_t step_target; //steps_done to reach before answering, 0 if none
+	bool closing; //shut down by the client, closed once the steps are answered
+};
+
+//read by the scan thread at the start of each cycle
+int plc_state = PLC_STATE_PAUSED;
+static int pending_steps = 0;
+
+static struct control_client clients[CONTROL_MAX_CLIENTS];
+static int listen_fd = -1;
+static int epoll_fd = -1;
+static int step_fd = -1; //eventfd, counts the steps run by the scan thread
+static uint64_t steps_requested = 0;
+static uint64_t steps_done = 0;
+static unsigned long last_step_tick = 0;
+
+static const char *state_names[] = { "PAUSED", "RUNNING", "STOPPED" };
+
+//-----------------------------------------------------------------------------
+// Called by the scan thread when paused. Returns true, and takes it, if a
+// single step has been requested
+//-----------------------------------------------------------------------------
+bool takeScanStep()
+{
+	int steps = __atomic_load_n(&pending_steps, __ATOMIC_ACQUIRE);
+	while (steps > 0)
+	{
+		if (__atomic_compare_exchange_n(&pending_steps, &steps, steps - 1, false,
+			__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			return true;
+	}
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// Called by the scan thread once a single step has run
+//-----------------------------------------------------------------------------
+void scanStepDone(unsigned long step_tick)
+{
+	uint64_t one = 1;
+
+	__atomic_store_n(&last_step_tick, step_tick, __ATOMIC_RELEASE);
+	if (write(step_fd, &one, sizeof(one)) < 0)
+		perror("Control: error signaling the step");
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Closes the client and frees its slot
+//-----------------------------------------------------------------------------
+static void controlClose(struct control_client *client)
+{
+	close(client->fd); //also takes it out of the epoll set
+	client->fd = -1;
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Sends a line to the client. The answers are short, a
+// client not reading them is closed
+//-----------------------------------------------------------------------------
+static void controlReply(struct control_client *client, const char *fmt, ...)
+{
+	char line[CONTROL_LINE_SIZE];
+	va_list args;
+
+	va_start(args, fmt);
+	int len = vsnprintf(line, sizeof(line) - 1, fmt, args);
+	va_end(args);
+	if (len > (int)sizeof(line) - 2) len = sizeof(line) - 2;
+	line[len++] = '\n';
+
+	if (send(client->fd, line, len, MSG_NOSIGNAL | MSG_DONTWAIT) != len)
+		controlClose(client);
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Takes back the steps the scan thread has not run yet and
+// answers the clients waiting for them
+//-----------------------------------------------------------------------------
+static void cancelSteps()
+{
+	steps_requested -= __atomic_exchange_n(&pending_steps, 0, __ATOMIC_ACQ_REL);
+
+	for (int i = 0; i < CONTROL_MAX_CLIENTS; i++)
+	{
+		struct control_client *client = &clients[i];
+		if (client->fd >= 0 && client->step_target > steps_requested)
+		{
+			client->step_target = 0;
+			controlReply(client, "ERROR step cancelled");
+			if (client->fd >= 0 && client->closing)
+				controlClose(client);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Changes the state seen by the scan thread. Steps are only
+// run while paused
+//-----------------------------------------------------------------------------
+static void setPlcState(int state)
+{
+	if (state != PLC_STATE_PAUSED)
+		cancelSteps();
+
+	int old_state = __atomic_exchange_n(&plc_state, state, __ATOMIC_ACQ_REL);
+	if (old_state != state)
+		printf("Control: %s\n", state_names[state]);
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Runs a command line and answers it
+//-----------------------------------------------------------------------------
+static void controlCommand(struct control_client *client, char *line)
+{
+	char *save;
+	char *command = strtok_r(line, " \t\r", &save);
+	char *argument = strtok_r(NULL, " \t\r", &save);
+	int state = __atomic_load_n(&plc_state, __ATOMIC_ACQUIRE);
+
+	if (command == NULL)
+		return;
+
+	if (strcmp(command, "START") == 0)
+	{
+		//the outputs held low by the watchdog are driven again
+		__atomic_store_n(&outputs_safe, 0, __ATOMIC_RELEASE);
+		setPlcState(PLC_STATE_RUNNING);
+		controlReply(client, "OK RUNNING");
+	}
+	else if (strcmp(command, "PAUSE") == 0)
+	{
+		setPlcState(PLC_STATE_PAUSED);
+		controlReply(client, "OK PAUSED");
+	}
+	else if (strcmp(command, "STOP") == 0)
+	{
+		//the scan thread drives the outputs low and exits on its next cycle
+		controlReply(client, "OK STOPPED");
+		setPlcState(PLC_STATE_STOPPED);
+	}
+	else if (strcmp(command, "STEP") == 0)
+	{
+		int count = argument != NULL ? atoi(argument) : 1;
+		if (state != PLC_STATE_PAUSED)
+			controlReply(client, "ERROR %s, STEP needs PAUSED", state_names[state]);
+		else if (count <= 0)
+			controlReply(client, "ERROR bad step count");
+		else if (client->step_target != 0)
+			controlReply(client, "ERROR step already pending");
+		else
+		{
+			steps_requested += count;
+			client->step_target = steps_requested;
+			__atomic_add_fetch(&pending_steps, count, __ATOMIC_RELEASE);
+		}
+	}
+	else if (strcmp(command, "STATUS") == 0)
+	{
+		controlReply(client, "OK %s tick %lu cycles %llu overruns %llu", state_names[state],
+			__atomic_load_n(&scan_tick, __ATOMIC_RELAXED),
+			(unsigned long long)__atomic_load_n(&scan_stats->cycles, __ATOMIC_RELAXED),
+			(unsigned long long)__atomic_load_n(&scan_stats->overruns, __ATOMIC_RELAXED));
+	}
+	else if (strcmp(command, "FORCE") == 0)
+	{
+		const char *error = forceVariable(argument, strtok_r(NULL, " \t\r", &save));
+		if (error != NULL)
+			controlReply(client, "ERROR %s", error);
+		else
+			controlReply(client, "OK FORCED %s", argument);
+	}
+	else if (strcmp(command, "UNFORCE") == 0)
+	{
+		const char *error = unforceVariable(argument);
+		if (error != NULL)
+			controlReply(client, "ERROR %s", error);
+		else
+			controlReply(client, "OK UNFORCED %s", argument);
+	}
+	else
+	{
+		controlReply(client, "ERROR unknown command %s", command);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Reads from the client and runs every complete line
+//-----------------------------------------------------------------------------
+static void controlRead(struct control_client *client)
+{
+	int len = read(client->fd, client->rx_buffer + client->rx_len,
+		CONTROL_LINE_SIZE - 1 - client->rx_len);
+	if (len <= 0)
+	{
+		//an unterminated command is still run when the client shuts down
+		if (len == 0 && client->rx_len > 0)
+		{
+			client->rx_buffer[client->rx_len] = '\0';
+			client->rx_len = 0;
+			controlCommand(client, client->rx_buffer);
+		}
+		if (client->fd < 0)
+			return;
+
+		//a pending step is still answered, the socket is only written to
+		if (len == 0 && client->step_target != 0)
+		{
+			epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+			client->closing = true;
+		}
+		else
+			controlClose(client);
+		return;
+	}
+	client->rx_len += len;
+
+	char *start = client->rx_buffer;
+	char *end;
+	while (client->fd >= 0 && (end = (char *)memchr(start, '\n',
+		client->rx_len - (start - client->rx_buffer))) != NULL)
+	{
+		*end = '\0';
+		controlCommand(client, start);
+		start = end + 1;
+	}
+	if (client->fd < 0)
+		return;
+
+	client->rx_len -= start - client->rx_buffer;
+	memmove(client->rx_buffer, start, client->rx_len);
+	if (client->rx_len == CONTROL_LINE_SIZE - 1)
+	{
+		controlReply(client, "ERROR line too long");
+		client->rx_len = 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Answers the clients whose steps have all run
+//-----------------------------------------------------------------------------
+static void controlStepsDone()
+{
+	uint64_t count;
+
+	if (read(step_fd, &count, sizeof(count)) != sizeof(count))
+		return;
+	steps_done += count;
+
+	for (int i = 0; i < CONTROL_MAX_CLIENTS; i++)
+	{
+		struct control_client *client = &clients[i];
+		if (client->fd >= 0 && client->step_target != 0 && client->step_target <= steps_done)
+		{
+			client->step_target = 0;
+			controlReply(client, "OK STEP %lu", __atomic_load_n(&last_step_tick, __ATOMIC_ACQUIRE));
+			if (client->fd >= 0 && client->closing)
+				controlClose(client);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Main function for the thread. Accepts the clients and serves them from a
+// single epoll loop
+//-----------------------------------------------------------------------------
+static void *controlThread(void *arg)
+{
+	struct epoll_event events[CONTROL_MAX_EVENTS];
+
+	while (1)
+	{
+		int count = epoll_wait(epoll_fd, events, CONTROL_MAX_EVENTS, -1);
+		if (count < 0 && errno != EINTR)
+		{
+			perror("Control: epoll_wait failed");
+			return NULL;
+		}
+
+		for (int i = 0; i < count; i++)
+		{
+			if (events[i].data.u32 == CONTROL_TAG_LISTEN)
+			{
+				int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+				if (fd < 0) continue;
+
+				struct control_client *client = NULL;
+				for (int j = 0; j < CONTROL_MAX_CLIENTS && client == NULL; j++)
+					if (clients[j].fd < 0) client = &clients[j];
+				if (client == NULL)
+				{
+					close(fd);
+					continue;
+				}
+
+				client->fd = fd;
+				client->rx_len = 0;
+				client->step_target = 0;
+				client->closing = false;
+
+				struct epoll_event event;
+				event.events = EPOLLIN;
+				event.data.u64 = client - clients;
+				epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+			}
+			else if (events[i].data.u32 == CONTROL_TAG_STEP)
+			{
+				controlStepsDone();
+			}
+			else
+			{
+				controlRead(&clients[events[i].data.u32]);
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Creates the control socket and starts the thread serving it. Returns -1 if
+// the socket could not be created
+//-----------------------------------------------------------------------------
+int startControlServer()
+{
+	const char *path = configString("control.socket", DEFAULT_CONTROL_SOCKET);
+	struct sockaddr_un addr;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+	{
+		printf("Control: socket path %s is too long\n", path);
+		return -1;
+	}
+
+	for (int i = 0; i < CONTROL_MAX_CLIENTS; i++)
+		clients[i].fd = -1;
+
+	listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (listen_fd < 0)
+	{
+		perror("Control: error creating socket");
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	unlink(path); //left behind by a previous run
+	if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, CONTROL_MAX_CLIENTS) < 0)
+	{
+		perror("Control: error binding socket");
+		close(listen_fd);
+		return -1;
+	}
+	chmod(path, 0660);
+
+	step_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (step_fd < 0 || epoll_fd < 0)
+	{
+		perror("Control: error creating the event descriptors");
+		close(listen_fd);
+		return -1;
+	}
+
+	struct epoll_event event;
+	event.events = EPOLLIN;
+	event.data.u64 = CONTROL_TAG_LISTEN;
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+	event.data.u64 = CONTROL_TAG_STEP;
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, step_fd, &event);
+
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, controlThread, NULL) != 0)
+	{
+		printf("Control: error starting the thread\n");
+		return -1;
+	}
+	setupThread(thread, THREAD_CLASS_NETWORK, "control", -1);
+
+	printf("Control: listening on %s\n", path);
+	return 0;
+}
@@ -0,0 +1,343 @@
+//-----------------------------------------------------------------------------
+// Copyright 2019 Novasom Industries
+//
+// Based on the software by Thiago Alves
+// This file is part of the OpenPLC Software Stack.
+//
+// OpenPLC is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenPLC is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenPLC.  If not, see <http://www.gnu.org/licenses/>.
+//------
+//
+// Edge capture for the inputs listed in io.edge_inputs. A thread waits on the
+// edge events of those lines and stores every edge, with its timestamp, in a
+// ring per input. The scan takes one edge per input from the rings in the
+// input phase, so a pulse shorter than the scan period is seen for one scan
+// as 1 and then as 0 instead of being lost. The longest time an edge has
+// waited for the scan that took it is kept per input. The rings have one writer (the
+// capture thread) and one reader (the scan thread) and need no lock.
+// An edge on one of the io.interrupt_inputs also wakes the scan thread for
+// an extra scan, without waiting for the next cycle.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "ladder.h"
+
+#define EDGE_RING_SIZE			64 //power of 2
+
+struct edge_event
+{
+	uint64_t timestamp_ns;
+	IEC_BOOL value;
+};
+
+struct edge_ring
+{
+	int input; //index in the pin map, 0 = %IX0.0
+	int fd;
+	bool interrupt;
+	IEC_BOOL level; //level after the last edge stored
+
+	struct edge_event events[EDGE_RING_SIZE];
+	unsigned int head; //written by the capture thread
+	unsigned int tail; //written by the scan thread
+
+	uint64_t rising;
+	uint64_t falling;
+	uint64_t lost;
+	uint64_t max_wait_ns; //written by the scan thread
+};
+
+static struct edge_ring edge_rings[MAX_IO_PINS];
+static int edge_count = 0;
+
+//wakes the scan thread for an extra scan, -1 without interrupt inputs
+static int trigger_fd = -1;
+static uint64_t trigger_ns = 0;
+
+//extra scans done and the time from the edge to their end
+static uint64_t interrupt_scans = 0;
+static uint64_t interrupt_latency_total_ns = 0;
+static uint64_t interrupt_latency_max_ns = 0;
+
+//-----------------------------------------------------------------------------
+// Helper function - Monotonic time in nanoseconds
+//-----------------------------------------------------------------------------
+static inline uint64_t nowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Stores an edge in the ring of an input. If the scan
+// thread is too far behind the edge is counted as lost
+//-----------------------------------------------------------------------------
+static void pushEdge(struct edge_ring *ring, IEC_BOOL value, uint64_t timestamp)
+{
+	unsigned int head = ring->head;
+
+	//the level follows the lost edges too, or the next one looks like a pulse
+	ring->level = value;
+	if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= EDGE_RING_SIZE)
+	{
+		__atomic_store_n(&ring->lost, ring->lost + 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	ring->events[head % EDGE_RING_SIZE].timestamp_ns = timestamp;
+	ring->events[head % EDGE_RING_SIZE].value = value;
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+	if (value)
+		__atomic_store_n(&ring->rising, ring->rising + 1, __ATOMIC_RELAXED);
+	else
+		__atomic_store_n(&ring->falling, ring->falling + 1, __ATOMIC_RELAXED);
+}
+
+//-----------------------------------------------------------------------------
+// Thread waiting on the edge events of the captured inputs
+//-----------------------------------------------------------------------------
+static void *edgeCaptureThread(void *arg)
+{
+	struct pollfd pfds[MAX_IO_PINS];
+
+	prefaultStack();
+	for (int i = 0; i < edge_count; i++)
+	{
+		pfds[i].fd = edge_rings[i].fd;
+		pfds[i].events = POLLPRI | POLLERR;
+	}
+
+	while (1)
+	{
+		if (poll(pfds, edge_count, -1) < 0)
+		{
+			if (errno == EINTR) continue;
+			printf("Edge capture: error waiting for the edges\n");
+			return NULL;
+		}
+		uint64_t timestamp = nowNs();
+		bool trigger = false;
+
+		for (int i = 0; i < edge_count; i++)
+		{
+			if (!(pfds[i].revents & (POLLPRI | POLLERR)))
+				continue;
+
+			struct edge_ring *ring = &edge_rings[i];
+			char value;
+			if (pread(ring->fd, &value, 1, 0) != 1)
+				continue;
+
+			//when two edges are reported as one the level is back where it
+			//was: store both, it was a pulse
+			IEC_BOOL level = value & 0x01;
+			if (level == ring->level)
+				pushEdge(ring, !level, timestamp);
+			pushEdge(ring, level, timestamp);
+
+			trigger |= ring->interrupt;
+		}
+
+		if (trigger)
+		{
+			uint64_t one = 1;
+			__atomic_store_n(&trigger_ns, timestamp, __ATOMIC_RELAXED);
+			if (write(trigger_fd, &one, sizeof(one)) != sizeof(one))
+				printf("Edge capture: could not trigger a scan\n");
+		}
+	}
+
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Starts the capture of the inputs listed in io.edge_inputs and
+// io.interrupt_inputs, if the driver can report their edges
+//-----------------------------------------------------------------------------
+void startEdgeCapture(struct io_driver *driver, struct io_map *map)
+{
+	int edge_inputs[MAX_IO_PINS];
+	int interrupt_inputs[MAX_IO_PINS];
+	int edges = parseIntList(configString("io.edge_inputs", ""), edge_inputs, MAX_IO_PINS);
+	int interrupts = parseIntList(configString("io.interrupt_inputs", ""), interrupt_inputs, MAX_IO_PINS);
+
+	if (edges + interrupts == 0)
+		return;
+
+	if (driver->edge_fd == NULL)
+	{
+		printf("WARNING: The %s driver can't capture edges, inputs are only read by the scan\n", driver->name);
+		return;
+	}
+
+	for (int input = 0; input < map->inputs; input++)
+	{
+		bool captured = false, interrupt = false;
+		for (int i = 0; i < edges; i++)
+			captured |= edge_inputs[i] == input;
+		for (int i = 0; i < interrupts; i++)
+			interrupt |= interrupt_inputs[i] == input;
+
+		if (!captured && !interrupt)
+			continue;
+
+		int fd = driver->edge_fd(input);
+		if (fd < 0)
+		{
+			printf("WARNING: Edges of input %d can't be captured\n", input);
+			continue;
+		}
+
+		struct edge_ring *ring = &edge_rings[edge_count++];
+		memset(ring, 0, sizeof(struct edge_ring));
+		ring->input = input;
+		ring->fd = fd;
+		ring->interrupt = interrupt;
+
+		char value;
+		if (pread(fd, &value, 1, 0) == 1)
+			ring->level = value & 0x01;
+
+		if (interrupt && trigger_fd < 0)
+			trigger_fd = eventfd(0, EFD_NONBLOCK);
+	}
+
+	if (edge_count == 0)
+		return;
+
+	//the io class runs above the scan thread by default
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, edgeCaptureThread, NULL) != 0)
+	{
+		printf("Edge capture: could not create the thread\n");
+		return;
+	}
+	setupThread(thread, THREAD_CLASS_IO, "edge capture", -1);
+
+	printf("Edge capture: %d inputs\n", edge_count);
+}
+
+//-----------------------------------------------------------------------------
+// Called by the scan in the input phase. For every captured input with an
+// edge waiting, the level after the oldest edge replaces the value read
+//-----------------------------------------------------------------------------
+void applyEdgeEvents(IEC_BOOL *values)
+{
+	uint64_t now = 0;
+
+	for (int i = 0; i < edge_count; i++)
+	{
+		struct edge_ring *ring = &edge_rings[i];
+		unsigned int tail = ring->tail;
+
+		if (tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+			continue;
+
+		struct edge_event *event = &ring->events[tail % EDGE_RING_SIZE];
+		if (now == 0) now = nowNs();
+		if (now - event->timestamp_ns > ring->max_wait_ns)
+			__atomic_store_n(&ring->max_wait_ns, now - event->timestamp_ns, __ATOMIC_RELAXED);
+
+		values[ring->input] = event->value;
+		__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Waits until the deadline, or until an interrupt input asks for a scan.
+// Returns true in the second case
+//-----------------------------------------------------------------------------
+bool waitScanTrigger(struct timespec *deadline)
+{
+	if (trigger_fd < 0)
+	{
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL);
+		return false;
+	}
+
+	struct pollfd pfd;
+	pfd.fd = trigger_fd;
+	pfd.events = POLLIN;
+
+	while (1)
+	{
+		struct timespec now, timeout;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		long long left = (long long)(deadline->tv_sec - now.tv_sec) * 1000000000LL + (deadline->tv_nsec - now.tv_nsec);
+		if (left <= 0)
+			return false;
+		timeout.tv_sec = left / 1000000000LL;
+		timeout.tv_nsec = left % 1000000000LL;
+
+		int ret = ppoll(&pfd, 1, &timeout, NULL);
+		if (ret == 0)
+			return false;
+		if (ret < 0)
+		{
+			if (errno == EINTR) continue;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL);
+			return false;
+		}
+
+		uint64_t count;
+		if (read(trigger_fd, &count, sizeof(count)) == sizeof(count))
+			return true;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Called at the end of an extra scan, to measure the time from the edge
+//-----------------------------------------------------------------------------
+void interruptScanDone()
+{
+	uint64_t latency = nowNs() - __atomic_load_n(&trigger_ns, __ATOMIC_RELAXED);
+
+	if (latency > interrupt_latency_max_ns)
+		interrupt_latency_max_ns = latency;
+	interrupt_latency_total_ns += latency;
+	interrupt_scans++;
+}
+
+//-----------------------------------------------------------------------------
+// Prints the edges captured on every input and the extra scans
+//-----------------------------------------------------------------------------
+void printEdgeStats()
+{
+	for (int i = 0; i < edge_count; i++)
+	{
+		struct edge_ring *ring = &edge_rings[i];
+		printf("Edges %%IX%d.%d: %llu rising, %llu falling, %llu lost, edge->scan max %llu ns\n",
+			ring->input / 8, ring->input % 8,
+			(unsigned long long)__atomic_load_n(&ring->rising, __ATOMIC_RELAXED),
+			(unsigned long long)__atomic_load_n(&ring->falling, __ATOMIC_RELAXED),
+			(unsigned long long)__atomic_load_n(&ring->lost, __ATOMIC_RELAXED),
+			(unsigned long long)__atomic_load_n(&ring->max_wait_ns, __ATOMIC_RELAXED));
+	}
+
+	if (trigger_fd >= 0)
+	{
+		printf("  %llu interrupt scans, edge->output avg %llu ns  max %llu ns\n", (unsigned long long)interrupt_scans,
+			(unsigned long long)(interrupt_scans ? interrupt_latency_total_ns / interrupt_scans : 0),
+			(unsigned long long)interrupt_latency_max_ns);
+	}
+}
@@ -0,0 +1,223 @@
+//-----------------------------------------------------------------------------
+// Copyright 2019 Novasom Industries
+//
+// Based on the software by Thiago Alves
+// This file is part of the OpenPLC Software Stack.
+//
+// OpenPLC is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenPLC is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenPLC.  If not, see <http://www.gnu.org/licenses/>.
+//------
+//
+// Forcing of the located variables (%IX0.0, %QW3, %MD10...). The forced
+// variables are kept in a table, and the scan thread writes their values in
+// the buffers twice per cycle: after the inputs have been read and the
+// network writes applied, so the program reads them, and again after the
+// logic, so the outputs and the process image get them whatever the program
+// wrote. Only the table is walked, the variables that are not forced cost
+// nothing.
+//
+// This works the same when the program is built with IEC_NO_FORCING, where
+// the variables have no force flag (see lib/accessor.h).
+//
+// With the task scheduler (-t) every task thread applies them as well around
+// its own run, since the scan thread writes the outputs after unlocking.
+//
+// The table is changed by the control thread and applied by the scan and
+// task threads, all with the mutex bufferLock held.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "ladder.h"
+
+#define MAX_FORCED				64
+
+struct forced_var
+{
+	void *ptr; //in the buffers of glueVars.cpp
+	int size;
+	int64_t value;
+};
+
+static struct forced_var forced[MAX_FORCED];
+static int forced_count = 0;
+
+//-----------------------------------------------------------------------------
+// Helper function - Finds the buffer entry of a located variable, e.g. %QX0.1
+// or %MW3. Returns NULL if the name is not valid or the program does not use
+// the variable
+//-----------------------------------------------------------------------------
+static void *locatedVariable(const char *name, int *size, bool *is_bool)
+{
+	char area, type;
+	int index, bit = 0, end = 0, bit_end = 0;
+
+	if (sscanf(name, "%%%c%c%d%n", &area, &type, &index, &end) < 3)
+		return NULL;
+	*is_bool = (type == 'X');
+	if (*is_bool)
+	{
+		if (sscanf(name + end, ".%d%n", &bit, &bit_end) < 1)
+			return NULL;
+		end += bit_end;
+	}
+	if (name[end] != '\0' || index < 0 || index >= BUFFER_SIZE || bit < 0 || bit > 7)
+		return NULL;
+
+	if (area == 'I' && type == 'X') { *size = sizeof(IEC_BOOL); return bool_input[index][bit]; }
+	if (area == 'Q' && type == 'X') { *size = sizeof(IEC_BOOL); return bool_output[index][bit]; }
+	if (area == 'I' && type == 'B') { *size = sizeof(IEC_BYTE); return byte_input[index]; }
+	if (area == 'Q' && type == 'B') { *size = sizeof(IEC_BYTE); return byte_output[index]; }
+	if (area == 'I' && type == 'W') { *size = sizeof(IEC_UINT); return int_input[index]; }
+	if (area == 'Q' && type == 'W') { *size = sizeof(IEC_UINT); return int_output[index]; }
+	if (area == 'M' && type == 'W') { *size = sizeof(IEC_UINT); return int_memory[index]; }
+	if (area == 'M' && type == 'D') { *size = sizeof(IEC_DINT); return dint_memory[index]; }
+	if (area == 'M' && type == 'L') { *size = sizeof(IEC_LINT); return lint_memory[index]; }
+
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Parses a value for a variable of the given size. Returns
+// false if it is not a number or does not fit
+//-----------------------------------------------------------------------------
+static bool parseForcedValue(const char *text, int size, bool is_bool, int64_t *value)
+{
+	char *end;
+
+	if (!strcmp(text, "TRUE")) text = "1";
+	else if (!strcmp(text, "FALSE")) text = "0";
+
+	*value = strtoll(text, &end, 0);
+	if (end == text || *end != '\0')
+		return false;
+	if (is_bool)
+		return *value == 0 || *value == 1;
+	if (size == 8)
+		return true;
+
+	//signed or unsigned values of the variable are accepted
+	int64_t limit = 1LL << (8 * size);
+	return *value >= -(limit / 2) && *value < limit;
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Writes the forced value in the buffer
+//-----------------------------------------------------------------------------
+static inline void writeForced(struct forced_var *var)
+{
+	switch (var->size)
+	{
+		case 1: *(IEC_BYTE *)var->ptr = (IEC_BYTE)var->value; break;
+		case 2: *(IEC_UINT *)var->ptr = (IEC_UINT)var->value; break;
+		case 4: *(IEC_DINT *)var->ptr = (IEC_DINT)var->value; break;
+		case 8: *(IEC_LINT *)var->ptr = (IEC_LINT)var->value; break;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Forces a located variable to a value, or changes the value it is forced
+// to. Returns NULL, or the reason it was refused
+//-----------------------------------------------------------------------------
+const char *forceVariable(const char *name, const char *value)
+{
+	int size;
+	bool is_bool;
+	int64_t parsed;
+
+	if (name == NULL || value == NULL)
+		return "FORCE needs a variable and a value";
+
+	void *ptr = locatedVariable(name, &size, &is_bool);
+	if (ptr == NULL)
+		return "unknown variable";
+	if (!parseForcedValue(value, size, is_bool, &parsed))
+		return "bad value";
+
+	pthread_mutex_lock(&bufferLock);
+	int i = 0;
+	while (i < forced_count && forced[i].ptr != ptr)
+		i++;
+	if (i == MAX_FORCED)
+	{
+		pthread_mutex_unlock(&bufferLock);
+		return "too many forced variables";
+	}
+	if (i == forced_count)
+	{
+		forced[i].ptr = ptr;
+		forced[i].size = size;
+		forced_count++;
+	}
+	forced[i].value = parsed;
+	writeForced(&forced[i]);
+	pthread_mutex_unlock(&bufferLock);
+
+	printf("Forcing: %s = %lld\n", name, (long long)parsed);
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Releases a forced variable, or all of them with ALL. The variable keeps
+// its value until the program or the I/O change it. Returns NULL, or the
+// reason it was refused
+//-----------------------------------------------------------------------------
+const char *unforceVariable(const char *name)
+{
+	int size;
+	bool is_bool;
+
+	if (name == NULL)
+		return "UNFORCE needs a variable or ALL";
+
+	if (!strcmp(name, "ALL"))
+	{
+		pthread_mutex_lock(&bufferLock);
+		forced_count = 0;
+		pthread_mutex_unlock(&bufferLock);
+		printf("Forcing: all variables released\n");
+		return NULL;
+	}
+
+	void *ptr = locatedVariable(name, &size, &is_bool);
+	if (ptr == NULL)
+		return "unknown variable";
+
+	pthread_mutex_lock(&bufferLock);
+	int i = 0;
+	while (i < forced_count && forced[i].ptr != ptr)
+		i++;
+	if (i == forced_count)
+	{
+		pthread_mutex_unlock(&bufferLock);
+		return "not forced";
+	}
+	forced[i] = forced[--forced_count];
+	pthread_mutex_unlock(&bufferLock);
+
+	printf("Forcing: %s released\n", name);
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Writes the forced values in the buffers. Called by the scan and task
+// threads with the mutex bufferLock held, before and after the logic
+//-----------------------------------------------------------------------------
+void applyForcing()
+{
+	for (int i = 0; i < forced_count; i++)
+		writeForced(&forced[i]);
+}
@@ -62,8 +62,23 @@ void glueVars()
 	bool_output[0][0] = __QX0_0;
 }
 
+//Returns the number of buffer pointers that are no longer bound to their
+//located variable
+int validateGlueVars()
+{
+	int unbound = 0;
+
+	if (bool_input[0][0] != __IX0_0) unbound++;
+	if (bool_output[0][0] != __QX0_0) unbound++;
+
+	return unbound;
+}
+
 void updateTime()
 {
+#ifdef IEC_TIME_NS
+	__CURRENT_TIME += common_ticktime__;
+#else
 	__CURRENT_TIME.tv_nsec += common_ticktime__;
 
 	if (__CURRENT_TIME.tv_nsec >= 1000000000)
@@ -71,4 +86,5 @@ void updateTime()
 		__CURRENT_TIME.tv_nsec -= 1000000000;
 		__CURRENT_TIME.tv_sec += 1;
 	}
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,267 @@
+//-----------------------------------------------------------------------------
+// Copyright 2019 Novasom Industries
+//
+// Based on the software by Thiago Alves
+// This file is part of the OpenPLC Software Stack.
+//
+// OpenPLC is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenPLC is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenPLC.  If not, see <http://www.gnu.org/licenses/>.
+//------
+//
+// The "gpio" I/O driver, using the sysfs GPIO lines. The value file of each
+// line is opened once at startup and then read or written with pread/pwrite
+// at offset 0, so a scan costs one syscall per line and no libc allocation.
+// If a line is not available (no /sys/class/gpio, as on a development PC)
+// a plain file in the simulator directory takes its place: write "0" or "1"
+// in it to drive an input, read it to see an output.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "ladder.h"
+
+#define GPIO_SYSFS				"/sys/class/gpio"
+#define DEFAULT_GPIO_SIM_DIR	"/tmp/novaplc_gpio"
+#define DEFAULT_GPIO_INIT_THREADS	4
+#define MAX_GPIO_INIT_THREADS	16
+
+//-----------------------------------------------------------------------------
+// Opens the value file of a GPIO line that has already been exported, or the
+// simulator file standing in for it. Returns the file descriptor, or -1
+//-----------------------------------------------------------------------------
+int gpioOpen(int pin, bool output)
+{
+	char path[256];
+
+	snprintf(path, sizeof(path), GPIO_SYSFS "/gpio%d/value", pin);
+	int fd = open(path, output ? O_RDWR : O_RDONLY);
+	if (fd >= 0)
+		return fd;
+
+	const char *dir = configString("gpio.simulator_dir", DEFAULT_GPIO_SIM_DIR);
+	mkdir(dir, 0755);
+	snprintf(path, sizeof(path), "%s/gpio%d", dir, pin);
+	fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+	{
+		printf("GPIO: could not open line %d\n", pin);
+		return -1;
+	}
+
+	//a new simulated line starts low
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size == 0)
+		pwrite(fd, "0\n", 2, 0);
+
+	printf("WARNING: GPIO %d not available, simulated by %s\n", pin, path);
+	return fd;
+}
+
+//-----------------------------------------------------------------------------
+// Reads the value of a line opened by gpioOpen()
+//-----------------------------------------------------------------------------
+IEC_BOOL gpioRead(int fd)
+{
+	char value;
+
+	if (fd < 0 || pread(fd, &value, 1, 0) != 1)
+		return 0;
+
+	return value & 0x01;
+}
+
+//-----------------------------------------------------------------------------
+// Sets the value of a line opened by gpioOpen()
+//-----------------------------------------------------------------------------
+void gpioWrite(int fd, IEC_BOOL value)
+{
+	if (fd < 0)
+		return;
+
+	pwrite(fd, value ? "1" : "0", 1, 0);
+}
+
+//value files of the lines of the pin map, opened once by gpioInit()
+static int gpio_in_fd[MAX_IO_PINS];
+static int gpio_out_fd[MAX_IO_PINS];
+static int gpio_outputs = 0;
+static struct io_map *gpio_map = NULL;
+
+//lines set up by one of the threads of gpioInit()
+struct gpio_setup
+{
+	struct io_map *map;
+	int first;
+	int step;
+};
+
+//-----------------------------------------------------------------------------
+// Helper function - Writes a value to a sysfs attribute
+//-----------------------------------------------------------------------------
+static bool sysfsWrite(const char *path, const char *value)
+{
+	int fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return false;
+
+	int length = strlen(value);
+	bool ok = write(fd, value, length) == length;
+	close(fd);
+
+	return ok;
+}
+
+//-----------------------------------------------------------------------------
+// Exports a line, unless it already is, sets its direction and opens it
+//-----------------------------------------------------------------------------
+static int gpioSetup(int pin, bool output)
+{
+	char path[64];
+	char value[16];
+
+	snprintf(path, sizeof(path), GPIO_SYSFS "/gpio%d", pin);
+	if (access(path, F_OK) != 0)
+	{
+		snprintf(value, sizeof(value), "%d", pin);
+		sysfsWrite(GPIO_SYSFS "/export", value);
+	}
+
+	snprintf(path, sizeof(path), GPIO_SYSFS "/gpio%d/direction", pin);
+	sysfsWrite(path, output ? "out" : "in");
+
+	return gpioOpen(pin, output);
+}
+
+//-----------------------------------------------------------------------------
+// Thread setting up every step-th line of the pin map (inputs first, then
+// outputs), starting from first
+//-----------------------------------------------------------------------------
+static void *gpioSetupThread(void *arg)
+{
+	struct gpio_setup *setup = (struct gpio_setup *)arg;
+	struct io_map *map = setup->map;
+
+	for (int line = setup->first; line < map->inputs + map->outputs; line += setup->step)
+	{
+		if (line < map->inputs)
+			gpio_in_fd[line] = gpioSetup(map->input_pins[line], false);
+		else
+			gpio_out_fd[line - map->inputs] = gpioSetup(map->output_pins[line - map->inputs], true);
+	}
+
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Sets up the lines of the pin map. The sysfs writes are done directly, and
+// split among gpio.init_threads threads as each one waits on the kernel
+//-----------------------------------------------------------------------------
+static int gpioInit(struct io_map *map)
+{
+	struct gpio_setup setup[MAX_GPIO_INIT_THREADS];
+	pthread_t threads[MAX_GPIO_INIT_THREADS];
+	bool started[MAX_GPIO_INIT_THREADS];
+
+	int lines = map->inputs + map->outputs;
+	int count = configInt("gpio.init_threads", DEFAULT_GPIO_INIT_THREADS);
+	if (count > MAX_GPIO_INIT_THREADS) count = MAX_GPIO_INIT_THREADS;
+	if (count > lines) count = lines;
+	if (count < 1) count = 1;
+
+	for (int i = 0; i < count; i++)
+	{
+		setup[i].map = map;
+		setup[i].first = i;
+		setup[i].step = count;
+		//the first slice is done by this thread
+		started[i] = i > 0 && pthread_create(&threads[i], NULL, gpioSetupThread, &setup[i]) == 0;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		if (!started[i])
+			gpioSetupThread(&setup[i]);
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		if (started[i])
+			pthread_join(threads[i], NULL);
+	}
+	gpio_outputs = map->outputs;
+	gpio_map = map;
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Reads all the input lines
+//-----------------------------------------------------------------------------
+static void gpioReadInputs(IEC_BOOL *values, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		values[i] = gpioRead(gpio_in_fd[i]);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Writes the output lines flagged in changed
+//-----------------------------------------------------------------------------
+static void gpioWriteOutputs(const uint64_t *values, const uint64_t *changed, int count)
+{
+	for (int word = 0; word < IO_WORDS(count); word++)
+	{
+		for (uint64_t mask = changed[word]; mask != 0; mask &= mask - 1)
+		{
+			int bit = __builtin_ctzll(mask);
+			gpioWrite(gpio_out_fd[word * 64 + bit], (values[word] >> bit) & 1);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Drives every output line low
+//-----------------------------------------------------------------------------
+static void gpioEmergencyStop()
+{
+	for (int i = 0; i < gpio_outputs; i++)
+	{
+		gpioWrite(gpio_out_fd[i], 0);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Enables the edge events of an input line and opens it again for the edge
+// capture thread (poll events are tracked per open file). Simulated lines
+// have no edges
+//-----------------------------------------------------------------------------
+static int gpioEdgeFd(int input)
+{
+	char path[64];
+	int pin = gpio_map->input_pins[input];
+
+	snprintf(path, sizeof(path), GPIO_SYSFS "/gpio%d/edge", pin);
+	if (!sysfsWrite(path, "both"))
+		return -1;
+
+	snprintf(path, sizeof(path), GPIO_SYSFS "/gpio%d/value", pin);
+	return open(path, O_RDONLY);
+}
+
+struct io_driver gpio_driver = { "gpio", gpioInit, gpioReadInputs, gpioWriteOutputs, gpioEmergencyStop, NULL, gpioEdgeFd };
@@ -0,0 +1,215 @@
+//-----------------------------------------------------------------------------
+// Copyright 2019 Novasom Industries
+//
+// Based on the software by Thiago Alves
+// This file is part of the OpenPLC Software Stack.
+//
+// OpenPLC is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenPLC is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenPLC.  If not, see <http://www.gnu.org/licenses/>.
+//------
+//
+// This file is the hardware layer for the OpenPLC. It moves the values
+// between the located variables (%IX0.0..., %QX0.0...) and the I/O driver
+// selected with io.driver in novaplc.cfg. The drivers only see the values
+// of the lines of the pin map, and are handed only the outputs that changed:
+//   gpio -> sysfs GPIO lines (gpio.cpp)
+//   sim  -> in-memory input patterns, for benchmarks (io_sim.cpp)
+// The pin map comes from io.inputs and io.outputs, the defaults below are
+// the lines wired on each board.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "ladder.h"
+
+/* port->pin definition
+gpio<port>_<offset><bit>
+ where
+	if offset == a -> index = 0
+	if offset == b -> index = 8
+	if offset == c -> index = 16
+	if offset == d -> index = 24
+ so
+	gpio = 32 * port + index + bit
+
+example1 : gpio3_a5 -> 32*3+0+5  -> 101
+example2 : gpio2_c7 -> 32*2+24+7 ->  95
+*/
+#if defined(NOVASOM_M7)
+#define DEFAULT_INPUT_PINS		"96"	//GPIO3_A0
+#define DEFAULT_OUTPUT_PINS		"97"	//GPIO3_A1
+#elif defined(NOVASOM_P)
+#define DEFAULT_INPUT_PINS		"142"
+#define DEFAULT_OUTPUT_PINS		"144"
+#else
+#warning "No board defined, the pin map must be set in novaplc.cfg"
+#define DEFAULT_INPUT_PINS		""
+#define DEFAULT_OUTPUT_PINS		""
+#endif
+
+#define DEFAULT_IO_DRIVER		"gpio"
+
+static struct io_driver *io_drivers[] = { &gpio_driver, &sim_driver, NULL };
+
+static struct io_driver *driver = &sim_driver;
+static struct io_map pin_map;
+
+//last output image handed to the driver. Until the first write every line
+//is considered changed
+static uint64_t output_shadow[IO_WORDS(MAX_IO_PINS)];
+static bool output_shadow_valid = false;
+static unsigned long long output_updates = 0;
+static unsigned long long output_writes = 0;
+
+//the output phase of the scan and emergency_stop() from the watchdog don't
+//write the lines at the same time
+static pthread_mutex_t outputLock = PTHREAD_MUTEX_INITIALIZER;
+
+//-----------------------------------------------------------------------------
+// This function is called by the main OpenPLC routine when it is initializing.
+// It selects the driver and hands it the pin map. If the driver can't be
+// used the simulator takes its place, so the program still runs
+//-----------------------------------------------------------------------------
+void initializeHardware()
+{
+	const char *name = configString("io.driver", DEFAULT_IO_DRIVER);
+
+	pin_map.inputs = parseIntList(configString("io.inputs", DEFAULT_INPUT_PINS), pin_map.input_pins, MAX_IO_PINS);
+	pin_map.outputs = parseIntList(configString("io.outputs", DEFAULT_OUTPUT_PINS), pin_map.output_pins, MAX_IO_PINS);
+
+	driver = NULL;
+	for (int i = 0; io_drivers[i] != NULL; i++)
+	{
+		if (!strcmp(io_drivers[i]->name, name))
+			driver = io_drivers[i];
+	}
+
+	if (driver == NULL)
+	{
+		printf("WARNING: Unknown I/O driver '%s', using the simulator\n", name);
+		driver = &sim_driver;
+	}
+
+	if (driver->init(&pin_map) < 0)
+	{
+		printf("WARNING: I/O driver '%s' could not be started, using the simulator\n", driver->name);
+		driver = &sim_driver;
+		driver->init(&pin_map);
+	}
+
+	printf("I/O: driver %s, %d inputs, %d outputs\n", driver->name, pin_map.inputs, pin_map.outputs);
+	startEdgeCapture(driver, &pin_map);
+}
+
+//-----------------------------------------------------------------------------
+// This function is called by the OpenPLC in a loop. Here the internal buffers
+// must be updated to reflect the actual state of the input pins. The lines
+// are read first, the mutex bufferLock is only held for the copy
+//-----------------------------------------------------------------------------
+void updateBuffersIn()
+{
+	IEC_BOOL values[MAX_IO_PINS];
+
+	driver->read_inputs(values, pin_map.inputs);
+	applyEdgeEvents(values); //edges captured since the last scan
+
+	pthread_mutex_lock(&bufferLock); //lock mutex
+	for (int i = 0; i < pin_map.inputs; i++)
+	{
+		if (bool_input[i/8][i%8] != NULL)
+			*bool_input[i/8][i%8] = values[i];
+	}
+	pthread_mutex_unlock(&bufferLock); //unlock mutex
+}
+
+//-----------------------------------------------------------------------------
+// This function is called by the OpenPLC in a loop. Here the internal buffers
+// must be updated to reflect the actual state of the output pins. The output
+// image is packed 64 lines per word and compared with the one written last
+// time, so the driver only touches the lines that changed (usually none).
+// The lines are written once the mutex bufferLock is released, with the
+// mutex outputLock held
+//-----------------------------------------------------------------------------
+void updateBuffersOut()
+{
+	uint64_t values[IO_WORDS(MAX_IO_PINS)];
+	uint64_t changed[IO_WORDS(MAX_IO_PINS)];
+	int words = IO_WORDS(pin_map.outputs);
+
+	memset(values, 0, words * sizeof(uint64_t));
+	pthread_mutex_lock(&bufferLock); //lock mutex
+	for (int i = 0; i < pin_map.outputs; i++)
+	{
+		if (bool_output[i/8][i%8] != NULL && *bool_output[i/8][i%8])
+			values[i / 64] |= 1ULL << (i % 64);
+	}
+	pthread_mutex_unlock(&bufferLock); //unlock mutex
+
+	pthread_mutex_lock(&outputLock);
+	uint64_t dirty = 0;
+	for (int i = 0; i < words; i++)
+	{
+		changed[i] = output_shadow_valid ? values[i] ^ output_shadow[i] : ~0ULL;
+		dirty |= changed[i];
+		output_shadow[i] = values[i];
+	}
+
+	//the first write sets every line, but only those of the pin map
+	if (!output_shadow_valid && pin_map.outputs % 64 != 0)
+		changed[words - 1] = (1ULL << (pin_map.outputs % 64)) - 1;
+	output_shadow_valid = true;
+
+	output_updates++;
+	if (dirty != 0)
+	{
+		output_writes++;
+		driver->write_outputs(values, changed, pin_map.outputs);
+
+		//the watchdog may have asked for safe outputs after the scan checked
+		//them, they are driven low again over the lines just written
+		if (__atomic_load_n(&outputs_safe, __ATOMIC_ACQUIRE))
+		{
+			driver->emergency_stop();
+			memset(output_shadow, 0, sizeof(output_shadow));
+		}
+	}
+	pthread_mutex_unlock(&outputLock);
+}
+
+//-----------------------------------------------------------------------------
+// Drives every output low. Called on the STOP command and by the watchdog.
+// All the lines are written, whatever the last image was. Waits for an
+// output phase in progress to end
+//-----------------------------------------------------------------------------
+void emergency_stop()
+{
+	pthread_mutex_lock(&outputLock);
+	driver->emergency_stop();
+	memset(output_shadow, 0, sizeof(output_shadow));
+	pthread_mutex_unlock(&outputLock);
+}
+
+//-----------------------------------------------------------------------------
+// Prints how many output updates reached the driver, then the statistics of
+// the driver, if it keeps any
+//-----------------------------------------------------------------------------
+void printIoStats()
+{
+	printf("I/O: %llu of %llu output updates written\n", output_writes, output_updates);
+
+	if (driver->print_stats != NULL)
+		driver->print_stats();
+	printEdgeStats();
+}
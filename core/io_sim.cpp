@@ -0,0 +1,181 @@
+//-----------------------------------------------------------------------------
+// Copyright 2019 Novasom Industries
+//
+// Based on the software by Thiago Alves
+// This file is part of the OpenPLC Software Stack.
+//
+// OpenPLC is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenPLC is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenPLC.  If not, see <http://www.gnu.org/licenses/>.
+//------
+//
+// The "sim" I/O driver. No hardware is touched: the inputs follow a pattern
+// computed from the monotonic clock, changing sim.rate_hz times per second
+// (rates in the MHz range are fine, the pattern is evaluated only when the
+// scan samples it), and the outputs are kept in memory.
+//   counter -> input N is bit N of the tick count (input 0 toggles fastest)
+//   random  -> every tick gives a new pseudo-random value to all the inputs
+// The driver measures how many scans per second are done and the latency
+// from an input change to the output change that follows it, so the cost of
+// the I/O scan and of the program can be benchmarked on any machine.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "ladder.h"
+
+#define DEFAULT_SIM_RATE_HZ		1000
+
+static int sim_outputs = 0;
+static bool sim_random = false;
+static unsigned long long sim_rate_hz = DEFAULT_SIM_RATE_HZ;
+
+static IEC_BOOL sim_input_values[MAX_IO_PINS];
+static uint64_t sim_output_values[IO_WORDS(MAX_IO_PINS)];
+
+//time at which the inputs last sampled became valid, until an output changes
+static unsigned long long pending_edge_ns = 0;
+static bool edge_pending = false;
+
+//statistics, read without locking by printIoStats()
+static unsigned long long scans = 0;
+static unsigned long long input_changes = 0;
+static unsigned long long output_changes = 0;
+static unsigned long long latency_count = 0;
+static unsigned long long latency_total_ns = 0;
+static unsigned long long latency_min_ns = 0;
+static unsigned long long latency_max_ns = 0;
+static unsigned long long stats_start_ns = 0;
+
+//-----------------------------------------------------------------------------
+// Helper function - Monotonic time in nanoseconds
+//-----------------------------------------------------------------------------
+static inline unsigned long long nowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - 64 pseudo-random bits for a tick (splitmix64)
+//-----------------------------------------------------------------------------
+static inline unsigned long long mixBits(unsigned long long x)
+{
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+//-----------------------------------------------------------------------------
+// Reads the pattern parameters. The simulator never fails to start
+//-----------------------------------------------------------------------------
+static int simInit(struct io_map *map)
+{
+	const char *pattern = configString("sim.pattern", "counter");
+	int rate = configInt("sim.rate_hz", DEFAULT_SIM_RATE_HZ);
+
+	sim_outputs = map->outputs;
+	sim_random = !strcmp(pattern, "random");
+	sim_rate_hz = rate > 0 ? rate : DEFAULT_SIM_RATE_HZ;
+
+	if (!sim_random && strcmp(pattern, "counter"))
+		printf("WARNING: Unknown simulator pattern '%s', using counter\n", pattern);
+
+	memset(sim_input_values, 0, sizeof(sim_input_values));
+	memset(sim_output_values, 0, sizeof(sim_output_values));
+
+	printf("I/O: simulated %s inputs at %llu Hz\n", sim_random ? "random" : "counter", sim_rate_hz);
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Samples the pattern at the current time
+//-----------------------------------------------------------------------------
+static void simReadInputs(IEC_BOOL *values, int count)
+{
+	unsigned long long now = nowNs();
+	unsigned long long tick = (unsigned long long)((__uint128_t)now * sim_rate_hz / 1000000000ULL);
+	bool changed = false;
+
+	for (int i = 0; i < count; i++)
+	{
+		IEC_BOOL value;
+		if (sim_random)
+			value = (mixBits(tick * 4 + i / 64) >> (i % 64)) & 1;
+		else
+			value = i < 64 ? (tick >> i) & 1 : 0;
+
+		changed |= value != sim_input_values[i];
+		sim_input_values[i] = value;
+		values[i] = value;
+	}
+
+	if (scans++ == 0)
+		stats_start_ns = now;
+	if (changed)
+	{
+		//the values read became valid at the start of the tick
+		input_changes++;
+		if (!edge_pending)
+		{
+			pending_edge_ns = (unsigned long long)((__uint128_t)tick * 1000000000ULL / sim_rate_hz);
+			edge_pending = true;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Keeps the outputs and measures the latency of the first output change
+// after an input change. Only called when an output has changed
+//-----------------------------------------------------------------------------
+static void simWriteOutputs(const uint64_t *values, const uint64_t *changed, int count)
+{
+	memcpy(sim_output_values, values, IO_WORDS(count) * sizeof(uint64_t));
+	output_changes++;
+
+	if (edge_pending)
+	{
+		unsigned long long latency = nowNs() - pending_edge_ns;
+		if (latency_count == 0 || latency < latency_min_ns) latency_min_ns = latency;
+		if (latency > latency_max_ns) latency_max_ns = latency;
+		latency_total_ns += latency;
+		latency_count++;
+		edge_pending = false;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Drives every simulated output low
+//-----------------------------------------------------------------------------
+static void simEmergencyStop()
+{
+	memset(sim_output_values, 0, IO_WORDS(sim_outputs) * sizeof(uint64_t));
+}
+
+//-----------------------------------------------------------------------------
+// Prints the throughput and the input to output latency
+//-----------------------------------------------------------------------------
+static void simPrintStats()
+{
+	unsigned long long elapsed_ns = scans ? nowNs() - stats_start_ns : 0;
+
+	printf("I/O sim: %llu scans (%llu/s), %llu input changes, %llu output changes\n",
+		scans, elapsed_ns ? scans * 1000000000ULL / elapsed_ns : 0, input_changes, output_changes);
+	printf("  latency input->output avg %8llu ns  min %8llu ns  max %8llu ns  (%llu samples)\n",
+		latency_count ? latency_total_ns / latency_count : 0, latency_min_ns, latency_max_ns, latency_count);
+}
+
+struct io_driver sim_driver = { "sim", simInit, simReadInputs, simWriteOutputs, simEmergencyStop, simPrintStats, NULL };
@@ -26,6 +26,8 @@
 #include <pthread.h>
 #include <stdint.h>
 
+#include "scan_hist.h"
+
 //Internal buffers for I/O and memory. These buffers are defined in the
 //auto-generated glueVars.cpp file
 #define BUFFER_SIZE		1024
@@ -73,9 +75,128 @@ extern IEC_LINT *lint_memory[BUFFER_SIZE];
 //lock for the buffer
 extern pthread_mutex_t bufferLock;
 
+//Modbus address space
+#define MAX_DISCRETE_INPUT 		800
+#define MAX_COILS 				800
+#define MAX_HOLD_REGS 			8192
+#define MAX_INP_REGS			1024
+
+#define MIN_16B_RANGE			1024
+#define MAX_16B_RANGE			2047
+#define MIN_32B_RANGE			2048
+#define MAX_32B_RANGE			4095
+#define MIN_64B_RANGE			4096
+#define MAX_64B_RANGE			8191
+
+//Process image areas
+#define IMAGE_DISCRETE_INPUTS	0
+#define IMAGE_COILS				1
+#define IMAGE_INPUT_REGS		2
+#define IMAGE_HOLDING_REGS		3
+
 //Common task timer
 extern unsigned long long common_ticktime__;
 
+//Scan cycle statistics
+#define SCAN_STATS_SHM			"/novaplc_stats"
+#define SCAN_STATS_MAGIC		0x53434e31
+
+#define SCAN_PHASE_INPUT		0
+#define SCAN_PHASE_LOGIC		1
+#define SCAN_PHASE_OUTPUT		2
+#define SCAN_HIST_CYCLE			3
+#define SCAN_HIST_WAKEUP		4
+#define SCAN_HIST_COUNT			5
+
+struct scan_histogram
+{
+	uint64_t count;
+	uint64_t total;
+	uint64_t max;
+	uint64_t bucket[SCAN_HIST_BUCKETS];
+};
+
+struct scan_stats
+{
+	uint32_t magic;
+	uint64_t period_ns;
+	uint64_t cycles;
+	uint64_t overruns;
+	uint64_t max_overrun_ns;
+	struct scan_histogram hist[SCAN_HIST_COUNT];
+};
+
+extern struct scan_stats *scan_stats;
+
+//States set through the control socket (control.cpp)
+#define PLC_STATE_PAUSED		0
+#define PLC_STATE_RUNNING		1
+#define PLC_STATE_STOPPED		2
+
+extern int plc_state;
+extern unsigned long scan_tick;
+
+//I/O drivers. The driver is selected at runtime (io.driver) and gets the
+//pin map read from novaplc.cfg
+#define MAX_IO_PINS				256
+#define IO_WORDS(n)				(((n) + 63) / 64) //outputs are packed 64 per word
+
+struct io_map
+{
+	int inputs;
+	int input_pins[MAX_IO_PINS];
+	int outputs;
+	int output_pins[MAX_IO_PINS];
+};
+
+struct io_driver
+{
+	const char *name;
+	int (*init)(struct io_map *map); //returns -1 if the driver can't be used
+	void (*read_inputs)(IEC_BOOL *values, int count);
+	void (*write_outputs)(const uint64_t *values, const uint64_t *changed, int count); //only the changed lines
+	void (*emergency_stop)(); //drives every output low
+	void (*print_stats)(); //optional, may be NULL
+	int (*edge_fd)(int input); //optional, fd polled for the edges of an input, or -1
+};
+
+extern struct io_driver gpio_driver;
+extern struct io_driver sim_driver;
+
+//Crash-safe store for retained data: two snapshot slots mapped in memory
+//and a journal of the changes (persistent_storage.cpp)
+struct retain_store
+{
+	int length; //bytes of data retained
+	unsigned char *data; //data as last stored
+	unsigned char *records; //journal records being built
+	unsigned char *map; //the two snapshot slots
+	size_t slot_size;
+	int active; //slot of the newest snapshot
+	uint32_t generation; //of the newest snapshot
+	int journal_fd;
+	long journal_bytes;
+	long compact_bytes;
+};
+
+//Thread classes, each with its own CPUs, policy and priority (thread_config.cpp)
+#define THREAD_CLASS_SCAN		0 //scan cycle and IEC tasks
+#define THREAD_CLASS_IO			1 //edge capture
+#define THREAD_CLASS_NETWORK	2 //Modbus/TCP, Modbus RTU, control socket
+#define THREAD_CLASS_PERSIST	3 //retained data
+#define THREAD_CLASS_LOGGING	4 //statistics
+#define THREAD_CLASS_WATCHDOG	5 //scan supervisor
+#define THREAD_CLASS_COUNT		6
+
+//Actions of the scan watchdog (watchdog.cpp)
+#define WATCHDOG_NONE			0
+#define WATCHDOG_LOG			1
+#define WATCHDOG_SKIP			2 //skip the next cycle
+#define WATCHDOG_SAFE			3 //outputs low, program paused
+#define WATCHDOG_RESTART		4
+
+extern int outputs_safe;
+
 //----------------------------------------------------------------------
 //FUNCTION PROTOTYPES
 //----------------------------------------------------------------------
@@ -83,9 +204,14 @@ extern unsigned long long common_ticktime__;
 //MatIEC Compiler
 void config_run__(unsigned long tick);
 void config_init__(void);
+//RETAIN variables, generated with the -O b option
+void config_retain__(void (*op)(void *varptr, int varsize, void **buffer, int *maxsize), void **buffer, int *maxsize);
+void config_backup__(void **buffer, int *maxsize);
+void config_restore__(void **buffer, int *maxsize);
 
 //glueVars.cpp
 void glueVars();
+int validateGlueVars();
 void updateTime();
 
 //hardware_layer.cpp
@@ -93,11 +219,31 @@ void initializeHardware();
 //void updateBuffers();
 void updateBuffersIn();
 void updateBuffersOut();
+void emergency_stop();
+void printIoStats();
+
+//edge_capture.cpp
+void startEdgeCapture(struct io_driver *driver, struct io_map *map);
+void applyEdgeEvents(IEC_BOOL *values);
+bool waitScanTrigger(struct timespec *deadline);
+void interruptScanDone();
+void printEdgeStats();
+
+//gpio.cpp
+int gpioOpen(int pin, bool output);
+IEC_BOOL gpioRead(int fd);
+void gpioWrite(int fd, IEC_BOOL value);
 
 //main.cpp
 void sleep_thread(int milliseconds);
 void *modbusThread();
-void sleep_until(struct timespec *ts, int delay);
+void sleep_until(struct timespec *ts, unsigned long long delay);
+void next_deadline(struct timespec *ts, unsigned long long delay);
+
+//control.cpp
+int startControlServer();
+bool takeScanStep();
+void scanStepDone(unsigned long step_tick);
 
 //server.cpp
 void startServer(int port);
@@ -106,9 +252,75 @@ void startServer(int port);
 int processModbusMessage(unsigned char *buffer, int bufferSize);
 void mapUnusedIO();
 
+//modbus_rtu.cpp
+uint16_t modbusCrc16(const unsigned char *data, int length);
+void *modbusRtuThread(void *arg);
+
+//process_image.cpp
+void initProcessImage();
+void publishProcessImage();
+void applyImageWrites();
+int readProcessImage(int area, int start, int count, void *dst);
+int readImageBits(int area, int start, int count, unsigned char *dst);
+int readImageRegisters(int area, int start, int count, unsigned char *dst);
+int queueImageWrite(int area, int start, int count, const IEC_UINT *values);
+int queueImageBits(int start, int count, const unsigned char *bits);
+int queueImageMask(int address, IEC_UINT and_mask, IEC_UINT or_mask);
+
 //dnp3.cpp
 void dnp3StartServer(int port);
 
+//scheduler.cpp
+extern int tasks_running;
+int startTaskScheduler();
+void printTaskStats();
+
+//scan_timing.cpp
+void initScanTiming(unsigned long long period_ns);
+void scanCycleBegin(struct timespec *deadline);
+void scanPhaseEnd(int phase);
+int64_t scanCycleEnd(struct timespec *deadline, unsigned long long period_ns);
+uint64_t scanHistPercentile(struct scan_histogram *hist, double fraction);
+void printScanStats();
+void *scanStatsThread(void *arg);
+void initStartupTiming();
+void startupPhaseEnd(const char *name);
+void printStartupReport();
+
+//runtime_config.cpp
+int loadRuntimeConfig(const char *path);
+const char *configString(const char *key, const char *def);
+int configInt(const char *key, int def);
+int parseIntList(const char *list, int *values, int max);
+
+//timer_wheel.cpp
+void advanceTimerWheel();
+
+//thread_config.cpp
+void loadThreadConfig();
+int setupThread(pthread_t thread, int thread_class, const char *name, int priority);
+void prefaultStack();
+int lockMemory();
+void printThreadReport();
+
+//watchdog.cpp
+void startWatchdog(char **argv, unsigned long long period);
+int watchdogOverrun(int64_t late_ns);
+void watchdogKick(struct timespec *deadline);
+void watchdogSafeState();
+void watchdogRestart();
+
 //persistent_storage.cpp
+int retainOpen(struct retain_store *store, const char *path, int length);
+void retainUpdate(struct retain_store *store, const void *data);
 void *persistentStorage(void *args);
 int readPersistentStorage();
+#ifdef IEC_NO_FORCING
+void __mark_retained(void *varptr);
+int __is_retained(void *varptr);
+#endif
+
+//forcing.cpp
+const char *forceVariable(const char *name, const char *value);
+const char *unforceVariable(const char *name);
+void applyForcing();
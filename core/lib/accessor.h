@@ -3,6 +3,18 @@
 
 #define __INITIAL_VALUE(...) __VA_ARGS__
 
+// with IEC_NO_FORCING (see iec_types_all.h) the variables have no flags: the
+// accessors below are plain loads and stores, and the runtime forces the
+// located variables in its own buffers
+#ifdef IEC_NO_FORCING
+#define __DECLARE_IS_GLOBAL_FORCED(name)
+#else
+#define __DECLARE_IS_GLOBAL_FORCED(name)\
+	IEC_BYTE __IS_GLOBAL_##name##_FORCED(void) {\
+		return (*GLOBAL__##name).flags & __IEC_FORCE_FLAG;\
+	}
+#endif
+
 // variable declaration macros
 #define __DECLARE_VAR(type, name)\
 	__IEC_##type##_t name;
@@ -12,9 +24,7 @@
 	void __INIT_GLOBAL_##name(type value) {\
 		(*GLOBAL__##name).value = value;\
 	}\
-	IEC_BYTE __IS_GLOBAL_##name##_FORCED(void) {\
-		return (*GLOBAL__##name).flags & __IEC_FORCE_FLAG;\
-	}\
+	__DECLARE_IS_GLOBAL_FORCED(name)\
 	type* __GET_GLOBAL_##name(void) {\
 		return &((*GLOBAL__##name).value);\
 	}
@@ -33,9 +43,7 @@
 	void __INIT_GLOBAL_##name(type value) {\
 		*((*GLOBAL__##name).value) = value;\
 	}\
-	IEC_BYTE __IS_GLOBAL_##name##_FORCED(void) {\
-		return (*GLOBAL__##name).flags & __IEC_FORCE_FLAG;\
-	}\
+	__DECLARE_IS_GLOBAL_FORCED(name)\
 	type* __GET_GLOBAL_##name(void) {\
 		return (*GLOBAL__##name).value;\
 	}
@@ -50,8 +58,16 @@
 
 
 // variable initialization macros
+#ifdef IEC_NO_FORCING
+// the addresses of the RETAIN variables are kept by the runtime
+void __mark_retained(void *varptr);
+int __is_retained(void *varptr);
+#define __INIT_RETAIN(name, retained)\
+    if (retained) __mark_retained(&(name.value));
+#else
 #define __INIT_RETAIN(name, retained)\
     name.flags |= retained?__IEC_RETAIN_FLAG:0;
+#endif
 #define __INIT_VAR(name, initial, retained)\
 	name.value = initial;\
 	__INIT_RETAIN(name, retained)
@@ -86,21 +102,33 @@
 // variable getting macros
 #define __GET_VAR(name, ...)\
 	name.value __VA_ARGS__
-#define __GET_EXTERNAL(name, ...)\
-	((name.flags & __IEC_FORCE_FLAG) ? name.fvalue __VA_ARGS__ : (*(name.value)) __VA_ARGS__)
 #define __GET_EXTERNAL_FB(name, ...)\
 	__GET_VAR(((*name) __VA_ARGS__))
-#define __GET_LOCATED(name, ...)\
-	((name.flags & __IEC_FORCE_FLAG) ? name.fvalue __VA_ARGS__ : (*(name.value)) __VA_ARGS__)
 
 #define __GET_VAR_BY_REF(name, ...)\
-	((name.flags & __IEC_FORCE_FLAG) ? &(name.fvalue __VA_ARGS__) : &(name.value __VA_ARGS__))
-#define __GET_EXTERNAL_BY_REF(name, ...)\
-	((name.flags & __IEC_FORCE_FLAG) ? &(name.fvalue __VA_ARGS__) : &((*(name.value)) __VA_ARGS__))
+	(&(name.value __VA_ARGS__))
 #define __GET_EXTERNAL_FB_BY_REF(name, ...)\
 	__GET_EXTERNAL_BY_REF(((*name) __VA_ARGS__))
+
+#ifdef IEC_NO_FORCING
+#define __GET_EXTERNAL(name, ...)\
+	((*(name.value)) __VA_ARGS__)
+#define __GET_LOCATED(name, ...)\
+	((*(name.value)) __VA_ARGS__)
+#define __GET_EXTERNAL_BY_REF(name, ...)\
+	(&((*(name.value)) __VA_ARGS__))
+#define __GET_LOCATED_BY_REF(name, ...)\
+	(&((*(name.value)) __VA_ARGS__))
+#else
+#define __GET_EXTERNAL(name, ...)\
+	((name.flags & __IEC_FORCE_FLAG) ? name.fvalue __VA_ARGS__ : (*(name.value)) __VA_ARGS__)
+#define __GET_LOCATED(name, ...)\
+	((name.flags & __IEC_FORCE_FLAG) ? name.fvalue __VA_ARGS__ : (*(name.value)) __VA_ARGS__)
+#define __GET_EXTERNAL_BY_REF(name, ...)\
+	((name.flags & __IEC_FORCE_FLAG) ? &(name.fvalue __VA_ARGS__) : &((*(name.value)) __VA_ARGS__))
 #define __GET_LOCATED_BY_REF(name, ...)\
 	((name.flags & __IEC_FORCE_FLAG) ? &(name.fvalue __VA_ARGS__) : &((*(name.value)) __VA_ARGS__))
+#endif
 
 #define __GET_VAR_REF(name, ...)\
 	(&(name.value __VA_ARGS__))
@@ -122,15 +150,62 @@
 
 
 // variable setting macros
+#define __SET_EXTERNAL_FB(prefix, name, suffix, new_value)\
+	__SET_VAR((*(prefix name)), suffix, new_value)
+
+#ifdef IEC_NO_FORCING
+#define __SET_VAR(prefix, name, suffix, new_value)\
+	prefix name.value suffix = new_value
+#define __SET_EXTERNAL(prefix, name, suffix, new_value)\
+	(*(prefix name.value)) suffix = new_value
+#define __SET_LOCATED(prefix, name, suffix, new_value)\
+	*(prefix name.value) suffix = new_value
+
+// variable setting macros for the functions writing their STRING result through
+// a pointer passed first, e.g. LEFT__STRING__STRING__INT_BY_REF(&str, EN, ENO, &in, 3)
+#define __SET_VAR_BY_REF(prefix, name, suffix, fname, ...)\
+	fname(&(prefix name.value suffix), __VA_ARGS__)
+#define __SET_EXTERNAL_BY_REF(prefix, name, suffix, fname, ...)\
+	fname(&((*(prefix name.value)) suffix), __VA_ARGS__)
+#define __SET_LOCATED_BY_REF(prefix, name, suffix, fname, ...)\
+	fname(&((*(prefix name.value)) suffix), __VA_ARGS__)
+#else
 #define __SET_VAR(prefix, name, suffix, new_value)\
 	if (!(prefix name.flags & __IEC_FORCE_FLAG)) prefix name.value suffix = new_value
 #define __SET_EXTERNAL(prefix, name, suffix, new_value)\
 	{extern IEC_BYTE __IS_GLOBAL_##name##_FORCED();\
     if (!(prefix name.flags & __IEC_FORCE_FLAG || __IS_GLOBAL_##name##_FORCED()))\
 		(*(prefix name.value)) suffix = new_value;}
-#define __SET_EXTERNAL_FB(prefix, name, suffix, new_value)\
-	__SET_VAR((*(prefix name)), suffix, new_value)
 #define __SET_LOCATED(prefix, name, suffix, new_value)\
 	if (!(prefix name.flags & __IEC_FORCE_FLAG)) *(prefix name.value) suffix = new_value
 
+// variable setting macros for the functions writing their STRING result through
+// a pointer passed first, e.g. LEFT__STRING__STRING__INT_BY_REF(&str, EN, ENO, &in, 3)
+#define __SET_VAR_BY_REF(prefix, name, suffix, fname, ...)\
+	if (!(prefix name.flags & __IEC_FORCE_FLAG)) fname(&(prefix name.value suffix), __VA_ARGS__)
+#define __SET_EXTERNAL_BY_REF(prefix, name, suffix, fname, ...)\
+	{extern IEC_BYTE __IS_GLOBAL_##name##_FORCED();\
+    if (!(prefix name.flags & __IEC_FORCE_FLAG || __IS_GLOBAL_##name##_FORCED()))\
+		fname(&((*(prefix name.value)) suffix), __VA_ARGS__);}
+#define __SET_LOCATED_BY_REF(prefix, name, suffix, fname, ...)\
+	if (!(prefix name.flags & __IEC_FORCE_FLAG)) fname(&((*(prefix name.value)) suffix), __VA_ARGS__)
+#endif
+
+// retained variables backup/restore macros, used inside the FBNAME_retain__()
+// functions where op, buffer and maxsize are the parameters
+typedef void (*__IEC_RETAIN_OP)(void *varptr, int varsize, void **buffer, int *maxsize);
+#define __RETAIN_FB(type, name)\
+	type##_retain__(&(name), op, buffer, maxsize);
+#ifdef IEC_NO_FORCING
+#define __RETAIN_VAR(name)\
+	if (__is_retained(&(name.value))) op(&(name.value), sizeof(name.value), buffer, maxsize);
+#define __RETAIN_LOCATED(name)\
+	if (__is_retained(&(name.value))) op(name.value, sizeof(*(name.value)), buffer, maxsize);
+#else
+#define __RETAIN_VAR(name)\
+	if (name.flags & __IEC_RETAIN_FLAG) op(&(name.value), sizeof(name.value), buffer, maxsize);
+#define __RETAIN_LOCATED(name)\
+	if (name.flags & __IEC_RETAIN_FLAG) op(name.value, sizeof(*(name.value)), buffer, maxsize);
+#endif
+
 #endif //__ACCESSOR_H
@@ -104,6 +104,76 @@
   else if (ENO != NULL)\
     *ENO = __BOOL_LITERAL(TRUE);
 
+/* For the functions returning a STRING through res (see table 29 below) */
+#define TEST_EN_BY_REF\
+  if (!EN) {\
+    if (ENO != NULL)\
+      *ENO = __BOOL_LITERAL(FALSE);\
+    res->len = 0;\
+    return;\
+  }\
+  else if (ENO != NULL)\
+    *ENO = __BOOL_LITERAL(TRUE);
+
+#define TEST_EN_COND_BY_REF(COND)\
+  if (!EN || (COND)) {\
+    if (ENO != NULL)\
+      *ENO = __BOOL_LITERAL(FALSE);\
+    res->len = 0;\
+    return;\
+  }\
+  else if (ENO != NULL)\
+    *ENO = __BOOL_LITERAL(TRUE);
+
+/**********************************/
+/*  FIXED ARITY EXTENSIBLE FUNCS  */
+/**********************************/
+
+/* NOTE: The extensible standard functions (ADD, MUL, AND, OR, XOR, MAX, MIN, MUX,
+ *       GT, GE, EQ, LE, LT and CONCAT) have several implementations:
+ *        - MAX_INLINE_PARAM_COUNT fixed arity versions, for when the function is
+ *          called with 1 to MAX_INLINE_PARAM_COUNT inputs, named after the function
+ *          with the number of inputs appended (e.g. ADD__INT__INT3(EN, ENO, a, b, c),
+ *          LE_TIME2(EN, ENO, a, b)). They reduce to a plain C expression.
+ *        - the varargs version, which takes the number of inputs before them
+ *          (e.g. ADD__INT__INT(EN, ENO, 9, a, b, ...)), for every other case.
+ *
+ *       iec2c chooses the version to call when generating the C code.
+ *       The fixed arity versions are declared by __inline_expand(), which expands
+ *       FIXED(fname, TYPENAME, ARG, n) for every number of inputs n. The FIXED macros
+ *       declare the inputs op1..opn with __INLINE_PARAMS_n(), and run
+ *       STEP(i, TYPENAME, ARG) on the inputs op2..opn with __INLINE_STEPS_n().
+ */
+#define MAX_INLINE_PARAM_COUNT 8
+
+#define __INLINE_PARAMS_1(TYPENAME) TYPENAME op1
+#define __INLINE_PARAMS_2(TYPENAME) __INLINE_PARAMS_1(TYPENAME), TYPENAME op2
+#define __INLINE_PARAMS_3(TYPENAME) __INLINE_PARAMS_2(TYPENAME), TYPENAME op3
+#define __INLINE_PARAMS_4(TYPENAME) __INLINE_PARAMS_3(TYPENAME), TYPENAME op4
+#define __INLINE_PARAMS_5(TYPENAME) __INLINE_PARAMS_4(TYPENAME), TYPENAME op5
+#define __INLINE_PARAMS_6(TYPENAME) __INLINE_PARAMS_5(TYPENAME), TYPENAME op6
+#define __INLINE_PARAMS_7(TYPENAME) __INLINE_PARAMS_6(TYPENAME), TYPENAME op7
+#define __INLINE_PARAMS_8(TYPENAME) __INLINE_PARAMS_7(TYPENAME), TYPENAME op8
+
+#define __INLINE_STEPS_1(STEP, TYPENAME, ARG)
+#define __INLINE_STEPS_2(STEP, TYPENAME, ARG) __INLINE_STEPS_1(STEP, TYPENAME, ARG) STEP(2, TYPENAME, ARG)
+#define __INLINE_STEPS_3(STEP, TYPENAME, ARG) __INLINE_STEPS_2(STEP, TYPENAME, ARG) STEP(3, TYPENAME, ARG)
+#define __INLINE_STEPS_4(STEP, TYPENAME, ARG) __INLINE_STEPS_3(STEP, TYPENAME, ARG) STEP(4, TYPENAME, ARG)
+#define __INLINE_STEPS_5(STEP, TYPENAME, ARG) __INLINE_STEPS_4(STEP, TYPENAME, ARG) STEP(5, TYPENAME, ARG)
+#define __INLINE_STEPS_6(STEP, TYPENAME, ARG) __INLINE_STEPS_5(STEP, TYPENAME, ARG) STEP(6, TYPENAME, ARG)
+#define __INLINE_STEPS_7(STEP, TYPENAME, ARG) __INLINE_STEPS_6(STEP, TYPENAME, ARG) STEP(7, TYPENAME, ARG)
+#define __INLINE_STEPS_8(STEP, TYPENAME, ARG) __INLINE_STEPS_7(STEP, TYPENAME, ARG) STEP(8, TYPENAME, ARG)
+
+#define __inline_expand(FIXED, fname, TYPENAME, ARG)\
+FIXED(fname, TYPENAME, ARG, 1)\
+FIXED(fname, TYPENAME, ARG, 2)\
+FIXED(fname, TYPENAME, ARG, 3)\
+FIXED(fname, TYPENAME, ARG, 4)\
+FIXED(fname, TYPENAME, ARG, 5)\
+FIXED(fname, TYPENAME, ARG, 6)\
+FIXED(fname, TYPENAME, ARG, 7)\
+FIXED(fname, TYPENAME, ARG, 8)
+
   
   
 /*****************************************/  
@@ -131,7 +201,7 @@ __ANY_NBIT(__convert_num_to_bool)
 #define __convert_time_to_bool(TYPENAME) \
 static inline BOOL TYPENAME##_TO_BOOL(EN_ENO_PARAMS, TYPENAME op){\
   TEST_EN(BOOL)\
-  return op.tv_sec == 0 && op.tv_nsec == 0 ? 0 : 1;\
+  return __time_sec(op) == 0 && __time_nsec(op) == 0 ? 0 : 1;\
 }
 __convert_time_to_bool(TIME)
 __ANY_DATE(__convert_time_to_bool)
@@ -238,32 +308,42 @@ __convert_type(TOD, TOD, __move_TOD)
 __convert_type(TIME, TIME, __move_TIME)
 
 
+/* The conversions to STRING also have a _BY_REF version writing the result
+ * through res (e.g. INT_TO_STRING_BY_REF(&str, EN, ENO, 42)), see table 29 below.
+ */
+#define __convert_to_string(from_TYPENAME, oper) \
+__convert_type(from_TYPENAME, STRING, __##oper)\
+static inline void from_TYPENAME##_TO_STRING_BY_REF(STRING *res, EN_ENO_PARAMS, from_TYPENAME op){\
+  TEST_EN_BY_REF\
+  __p##oper(res, op);\
+}
+
 /******** [ANY_BIT]_TO_STRING   ************/ 
-__convert_type(BOOL, STRING, __bool_to_string)
-#define __iec_(from_TYPENAME) __convert_type(from_TYPENAME, STRING, __bit_to_string)
+__convert_to_string(BOOL, bool_to_string)
+#define __iec_(from_TYPENAME) __convert_to_string(from_TYPENAME, bit_to_string)
 __ANY_NBIT(__iec_)
 #undef __iec_
 
 /******** [ANY_INT]_TO_STRING   ************/ 
-#define __iec_(from_TYPENAME) __convert_type(from_TYPENAME, STRING, __sint_to_string)
+#define __iec_(from_TYPENAME) __convert_to_string(from_TYPENAME, sint_to_string)
 __ANY_SINT(__iec_)
 #undef __iec_
-#define __iec_(from_TYPENAME) __convert_type(from_TYPENAME, STRING, __uint_to_string)
+#define __iec_(from_TYPENAME) __convert_to_string(from_TYPENAME, uint_to_string)
 __ANY_UINT(__iec_)
 #undef __iec_
 
 /******** [ANY_REAL]_TO_STRING   ************/ 
-#define __iec_(from_TYPENAME) __convert_type(from_TYPENAME, STRING, __real_to_string)
+#define __iec_(from_TYPENAME) __convert_to_string(from_TYPENAME, real_to_string)
 __ANY_REAL(__iec_)
 #undef __iec_
 
 /******** [ANY_DATE]_TO_STRING   ************/ 
-__convert_type(DATE, STRING, __date_to_string)
-__convert_type(DT,   STRING, __dt_to_string)
-__convert_type(TOD,  STRING, __tod_to_string)
+__convert_to_string(DATE, date_to_string)
+__convert_to_string(DT,   dt_to_string)
+__convert_to_string(TOD,  tod_to_string)
 
 /******** TIME_TO_STRING   ************/ 
-__convert_type(TIME, STRING, __time_to_string)
+__convert_to_string(TIME, time_to_string)
 
 
 /******** STRING_TO_[ANY_BIT]   ************/ 
@@ -479,6 +559,14 @@ __ANY_REAL(__atan)
 /***   Table 24 - Standard arithmetic functions    ***/
 /*****************************************************/
 
+#define __arith_step(n, TYPENAME, OP) op1 = op1 OP op##n;
+#define __arith_fixed(fname, TYPENAME, OP, n)\
+static inline TYPENAME fname##n(EN_ENO_PARAMS, __INLINE_PARAMS_##n(TYPENAME)){\
+  TEST_EN(TYPENAME)\
+  __INLINE_STEPS_##n(__arith_step, TYPENAME, OP)\
+  return op1;\
+}
+
 #define __arith_expand(fname,TYPENAME, OP)\
 static inline TYPENAME fname(EN_ENO_PARAMS, UINT param_count, TYPENAME op1, ...){\
   va_list ap;\
@@ -493,7 +581,8 @@ static inline TYPENAME fname(EN_ENO_PARAMS, UINT param_count, TYPENAME op1, ...)
   \
   va_end (ap);                  /* Clean up.  */\
   return op1;\
-}
+}\
+__inline_expand(__arith_fixed, fname, TYPENAME, OP)
 
 #define __arith_static(fname,TYPENAME, OP)\
 /* explicitly typed function */\
@@ -742,6 +831,14 @@ __ANY_NBIT(__iec_)
   /**************/
   /*     XOR    */
   /**************/
+#define __xorbool_step(n, TYPENAME, unused) op1 = (op1 && !op##n) || (!op1 && op##n);
+#define __xorbool_fixed(fname, TYPENAME, unused, n) \
+static inline BOOL fname##n(EN_ENO_PARAMS, __INLINE_PARAMS_##n(BOOL)){ \
+  TEST_EN(BOOL) \
+  __INLINE_STEPS_##n(__xorbool_step, BOOL, ) \
+  return op1; \
+}
+
 #define __xorbool_expand(fname) \
 static inline BOOL fname(EN_ENO_PARAMS, UINT param_count, BOOL op1, ...){ \
   va_list ap; \
@@ -757,7 +854,8 @@ static inline BOOL fname(EN_ENO_PARAMS, UINT param_count, BOOL op1, ...){ \
 \
   va_end (ap);                  /* Clean up.  */ \
   return op1; \
-}
+} \
+__inline_expand(__xorbool_fixed, fname, BOOL, )
 
 __xorbool_expand(XOR_BOOL) /* The explicitly typed standard functions */
 __xorbool_expand(XOR__BOOL__BOOL) /* Overloaded function */
@@ -845,6 +943,14 @@ __ANY(__iec_)
     /*     MAX    */
     /**************/
 
+#define __extrem_step(n, TYPENAME, COND) {TYPENAME tmp = op##n; op1 = COND ? tmp : op1;}
+#define __extrem_fixed(fname, TYPENAME, COND, n) \
+static inline TYPENAME fname##n(EN_ENO_PARAMS, __INLINE_PARAMS_##n(TYPENAME)){\
+  TEST_EN(TYPENAME)\
+  __INLINE_STEPS_##n(__extrem_step, TYPENAME, COND)\
+  return op1;\
+}
+
 #define __extrem_(fname,TYPENAME, COND) \
 static inline TYPENAME fname(EN_ENO_PARAMS, UINT param_count, TYPENAME op1, ...){\
   va_list ap;\
@@ -860,7 +966,8 @@ static inline TYPENAME fname(EN_ENO_PARAMS, UINT param_count, TYPENAME op1, ...)
   \
   va_end (ap);                  /* Clean up.  */\
   return op1;\
-}
+}\
+__inline_expand(__extrem_fixed, fname, TYPENAME, COND)
 
 /* Max for numerical data types */	
 #define __iec_(TYPENAME) \
@@ -970,13 +1077,25 @@ static inline STRING LIMIT__STRING__STRING__STRING__STRING(EN_ENO_PARAMS, STRING
  * unlike remaining functions, that start off at 1.
  */    
 /* The explicitly typed standard functions */
+/* K is compared unsigned so that a negative K is out of range for both versions,
+ * without comparing the unsigned K types against 0 */
+#define __mux_out_of_range(K, count) ((ULINT)(K) >= (ULINT)(count))
+#define __mux_step(n, TYPENAME, unused) if (K == n - 1) return op##n;
+#define __mux_fixed(fname, in2_TYPENAME, in1_TYPENAME, n)\
+static inline in2_TYPENAME fname##n(EN_ENO_PARAMS, in1_TYPENAME K, __INLINE_PARAMS_##n(in2_TYPENAME)){\
+  TEST_EN_COND(in2_TYPENAME, __mux_out_of_range(K, n))\
+  if (K == 0) return op1;\
+  __INLINE_STEPS_##n(__mux_step, in2_TYPENAME, )\
+  return __INIT_##in2_TYPENAME;\
+}
+
 #define __in1_anyint_(in2_TYPENAME)   __ANY_INT_1(__iec_,in2_TYPENAME)
 #define __iec_(in1_TYPENAME,in2_TYPENAME) \
 static inline in2_TYPENAME MUX__##in2_TYPENAME##__##in1_TYPENAME##__##in2_TYPENAME(EN_ENO_PARAMS, in1_TYPENAME K, UINT param_count, ...){\
   va_list ap;\
   UINT i;\
   in2_TYPENAME tmp;\
-  TEST_EN_COND(in2_TYPENAME, K >= param_count)\
+  TEST_EN_COND(in2_TYPENAME, __mux_out_of_range(K, param_count))\
   tmp = __INIT_##in2_TYPENAME;\
   \
   va_start (ap, param_count);         /* Initialize the argument list.  */\
@@ -993,7 +1112,8 @@ static inline in2_TYPENAME MUX__##in2_TYPENAME##__##in1_TYPENAME##__##in2_TYPENA
   \
   va_end (ap);                  /* Clean up.  */\
   return tmp;\
-}
+}\
+__inline_expand(__mux_fixed, MUX__##in2_TYPENAME##__##in1_TYPENAME##__##in2_TYPENAME, in2_TYPENAME, in1_TYPENAME)
 
 __ANY(__in1_anyint_)
 #undef __iec_
@@ -1004,6 +1124,14 @@ __ANY(__in1_anyint_)
 /***   Standard comparison functions    ***/
 /******************************************/
 
+#define __compare_step(n, TYPENAME, COND) {TYPENAME tmp = op##n; if(!(COND)) return 0; op1 = tmp;}
+#define __compare_fixed(fname, TYPENAME, COND, n) \
+static inline BOOL fname##n(EN_ENO_PARAMS, __INLINE_PARAMS_##n(TYPENAME)){\
+  TEST_EN(BOOL)\
+  __INLINE_STEPS_##n(__compare_step, TYPENAME, COND)\
+  return 1;\
+}
+
 #define __compare_(fname,TYPENAME, COND) \
 static inline BOOL fname(EN_ENO_PARAMS, UINT param_count, TYPENAME op1, ...){\
   va_list ap;\
@@ -1027,7 +1155,8 @@ static inline BOOL fname(EN_ENO_PARAMS, UINT param_count, TYPENAME op1, ...){\
   \
   va_end (ap);                  /* Clean up.  */\
   return 1;\
-}
+}\
+__inline_expand(__compare_fixed, fname, TYPENAME, COND)
 
 #define __compare_num(fname, TYPENAME, TEST) __compare_(fname, TYPENAME, op1 TEST tmp )
 #define __compare_time(fname, TYPENAME, TEST) __compare_(fname, TYPENAME, __time_cmp(op1, tmp) TEST 0)
@@ -1214,6 +1343,24 @@ __ne_string(NE__BOOL__STRING__STRING, STRING) /* Overloaded function */
 /* We do not delcare explcitly typed versions of the functions in table 29.
  * See note above regarding explicitly typed functions for more details.
  */
+
+/* NOTE: LEFT, RIGHT, MID, the fixed arity CONCAT, INSERT, DELETE, REPLACE and the
+ *       conversions to STRING also have a _BY_REF version, which takes the STRING
+ *       inputs by reference and writes the result through res, passed first
+ *       (e.g. LEFT__STRING__STRING__INT_BY_REF(&str, EN, ENO, &in, 3)).
+ *       They only copy the bytes in use, and the body after res->len is left as
+ *       it was. res may be one of the inputs (str := LEFT(str, 3)).
+ *
+ *       iec2c calls them when the result is assigned to a variable, through the
+ *       __SET_VAR_BY_REF() accessors. The by value LEFT, RIGHT, MID, INSERT, DELETE
+ *       and REPLACE wrap them.
+ */
+
+/* Copies the bytes in use of IN to res, IN may overlap res */
+static inline void __pstring_copy(STRING *res, const STRING *IN) {
+    memmove(&res->body, &IN->body, IN->len);
+    res->len = IN->len;
+}
  
 
 
@@ -1240,14 +1387,16 @@ __ANY_INT(__iec_)
     /****************/
 
 #define __left(TYPENAME) \
+static inline void LEFT__STRING__STRING__##TYPENAME##_BY_REF(STRING *res, EN_ENO_PARAMS, const STRING *IN, TYPENAME L){\
+  TEST_EN_COND_BY_REF(L < 0)\
+  L = L < (TYPENAME)IN->len ? L : (TYPENAME)IN->len;\
+  memmove(&res->body, &IN->body, (size_t)L);\
+  res->len = (__strlen_t)L;\
+}\
 static inline STRING LEFT__STRING__STRING__##TYPENAME(EN_ENO_PARAMS, STRING IN, TYPENAME L){\
-    STRING res;\
-    TEST_EN_COND(STRING, L < 0)\
-    res = __INIT_STRING;\
-    L = L < (TYPENAME)IN.len ? L : (TYPENAME)IN.len;\
-    memcpy(&res.body, &IN.body, (size_t)L);\
-    res.len = (__strlen_t)L;\
-    return res;\
+  STRING res;\
+  LEFT__STRING__STRING__##TYPENAME##_BY_REF(&res, EN_ENO, &IN, L);\
+  return res;\
 }
 __ANY_INT(__left)
 
@@ -1257,13 +1406,15 @@ __ANY_INT(__left)
     /*****************/
 
 #define __right(TYPENAME) \
+static inline void RIGHT__STRING__STRING__##TYPENAME##_BY_REF(STRING *res, EN_ENO_PARAMS, const STRING *IN, TYPENAME L){\
+  TEST_EN_COND_BY_REF(L < 0)\
+  L = L < (TYPENAME)IN->len ? L : (TYPENAME)IN->len;\
+  memmove(&res->body, &IN->body[(TYPENAME)IN->len - L], (size_t)L);\
+  res->len = (__strlen_t)L;\
+}\
 static inline STRING RIGHT__STRING__STRING__##TYPENAME(EN_ENO_PARAMS, STRING IN, TYPENAME L){\
   STRING res;\
-  TEST_EN_COND(STRING, L < 0)\
-  res = __INIT_STRING;\
-  L = L < (TYPENAME)IN.len ? L : (TYPENAME)IN.len;\
-  memcpy(&res.body, &IN.body[(TYPENAME)IN.len - L], (size_t)L);\
-  res.len = (__strlen_t)L;\
+  RIGHT__STRING__STRING__##TYPENAME##_BY_REF(&res, EN_ENO, &IN, L);\
   return res;\
 }
 __ANY_INT(__right)
@@ -1274,16 +1425,19 @@ __ANY_INT(__right)
     /***************/
 
 #define __mid(TYPENAME) \
-static inline STRING MID__STRING__STRING__##TYPENAME##__##TYPENAME(EN_ENO_PARAMS, STRING IN, TYPENAME L, TYPENAME P){\
-  STRING res;\
-  TEST_EN_COND(STRING, L < 0 || P < 0)\
-  res = __INIT_STRING;\
-  if(P <= (TYPENAME)IN.len){\
+static inline void MID__STRING__STRING__##TYPENAME##__##TYPENAME##_BY_REF(STRING *res, EN_ENO_PARAMS, const STRING *IN, TYPENAME L, TYPENAME P){\
+  TEST_EN_COND_BY_REF(L < 0 || P < 0)\
+  if(P <= (TYPENAME)IN->len){\
 	P -= 1; /* now can be used as [index]*/\
-	L = L + P <= (TYPENAME)IN.len ? L : (TYPENAME)IN.len - P;\
-	memcpy(&res.body, &IN.body[P] , (size_t)L);\
-	res.len = (__strlen_t)L;\
+	L = L + P <= (TYPENAME)IN->len ? L : (TYPENAME)IN->len - P;\
+	memmove(&res->body, &IN->body[P] , (size_t)L);\
+	res->len = (__strlen_t)L;\
   }\
+  else res->len = 0;\
+}\
+static inline STRING MID__STRING__STRING__##TYPENAME##__##TYPENAME(EN_ENO_PARAMS, STRING IN, TYPENAME L, TYPENAME P){\
+  STRING res;\
+  MID__STRING__STRING__##TYPENAME##__##TYPENAME##_BY_REF(&res, EN_ENO, &IN, L, P);\
   return res;\
 }
 __ANY_INT(__mid)
@@ -1300,7 +1454,6 @@ static inline STRING CONCAT(EN_ENO_PARAMS, UINT param_count, ...){
   __strlen_t charcount;
   TEST_EN(STRING)
   charcount = 0;
-  res = __INIT_STRING;
 
   va_start (ap, param_count);         /* Initialize the argument list.  */
 
@@ -1319,34 +1472,71 @@ static inline STRING CONCAT(EN_ENO_PARAMS, UINT param_count, ...){
   return res;
 }
 
+#define __concat_step(n, TYPENAME, unused) {\
+  __strlen_t charrem = STR_MAX_LEN - op1.len;\
+  __strlen_t to_write = op##n.len > charrem ? charrem : op##n.len;\
+  memcpy(&op1.body[op1.len], &op##n.body, to_write);\
+  op1.len += to_write;\
+}
+#define __concat_fixed(fname, TYPENAME, unused, n)\
+static inline STRING fname##n(EN_ENO_PARAMS, __INLINE_PARAMS_##n(STRING)){\
+  TEST_EN(STRING)\
+  __INLINE_STEPS_##n(__concat_step, STRING, )\
+  return op1;\
+}
+__inline_expand(__concat_fixed, CONCAT, STRING, )
+
+/* The result is built in tmp when res is one of op2..opn, as op1 goes first */
+#define __concat_alias(n, TYPENAME, unused) || op##n == res
+#define __concat_step_by_ref(n, TYPENAME, unused) {\
+  __strlen_t charrem = STR_MAX_LEN - dest->len;\
+  __strlen_t to_write = op##n->len > charrem ? charrem : op##n->len;\
+  memcpy(&dest->body[dest->len], &op##n->body, to_write);\
+  dest->len += to_write;\
+}
+#define __concat_fixed_by_ref(fname, TYPENAME, unused, n)\
+static inline void fname##n##_BY_REF(STRING *res, EN_ENO_PARAMS, __INLINE_PARAMS_##n(const STRING *)){\
+  STRING tmp, *dest = res;\
+  TEST_EN_BY_REF\
+  if (0 __INLINE_STEPS_##n(__concat_alias, STRING, )) dest = &tmp;\
+  __pstring_copy(dest, op1);\
+  __INLINE_STEPS_##n(__concat_step_by_ref, STRING, )\
+  if (dest != res) __pstring_copy(res, dest);\
+}
+__inline_expand(__concat_fixed_by_ref, CONCAT, STRING, )
+
     /******************/
     /*     INSERT     */
     /******************/
 
-static inline STRING __insert(STRING IN1, STRING IN2, __strlen_t P){
-    STRING res;
+static inline void __pinsert(STRING *res, const STRING *IN1, const STRING *IN2, __strlen_t P){
+    STRING tmp, *dest = res == IN1 || res == IN2 ? &tmp : res;
     __strlen_t to_copy;
-    res = __INIT_STRING;
 
-    to_copy = P > IN1.len ? IN1.len : P;
-    memcpy(&res.body, &IN1.body , to_copy);
-    P = res.len = to_copy;
+    to_copy = P > IN1->len ? IN1->len : P;
+    memcpy(&dest->body, &IN1->body , to_copy);
+    P = dest->len = to_copy;
 
-    to_copy = IN2.len + res.len > STR_MAX_LEN ? STR_MAX_LEN - res.len : IN2.len;
-    memcpy(&res.body[res.len], &IN2.body , to_copy);
-    res.len += to_copy;
+    to_copy = IN2->len + dest->len > STR_MAX_LEN ? STR_MAX_LEN - dest->len : IN2->len;
+    memcpy(&dest->body[dest->len], &IN2->body , to_copy);
+    dest->len += to_copy;
 
-    to_copy = IN1.len - P < STR_MAX_LEN - res.len ? IN1.len - P : STR_MAX_LEN - res.len ;
-    memcpy(&res.body[res.len], &IN1.body[P] , to_copy);
-    res.len += to_copy;
+    to_copy = IN1->len - P < STR_MAX_LEN - dest->len ? IN1->len - P : STR_MAX_LEN - dest->len ;
+    memcpy(&dest->body[dest->len], &IN1->body[P] , to_copy);
+    dest->len += to_copy;
 
-    return res;
+    if (dest != res) __pstring_copy(res, dest);
 }
 
 #define __iec_(TYPENAME) \
+static inline void INSERT__STRING__STRING__STRING__##TYPENAME##_BY_REF(STRING *res, EN_ENO_PARAMS, const STRING *str1, const STRING *str2, TYPENAME P){\
+  TEST_EN_COND_BY_REF(P < 0)\
+  __pinsert(res,str1,str2,(__strlen_t)P);\
+}\
 static inline STRING INSERT__STRING__STRING__STRING__##TYPENAME(EN_ENO_PARAMS, STRING str1, STRING str2, TYPENAME P){\
-  TEST_EN_COND(STRING, P < 0)\
-  return (STRING)__insert(str1,str2,(__strlen_t)P);\
+  STRING res;\
+  INSERT__STRING__STRING__STRING__##TYPENAME##_BY_REF(&res, EN_ENO, &str1, &str2, P);\
+  return res;\
 }
 __ANY_INT(__iec_)
 #undef __iec_
@@ -1356,28 +1546,32 @@ __ANY_INT(__iec_)
     /*     DELETE     */
     /******************/
 
-static inline STRING __delete(STRING IN, __strlen_t L, __strlen_t P){
-    STRING res;
-    __strlen_t to_copy;
-    res = __INIT_STRING;
+/* IN may be res, the bytes kept only move towards the start */
+static inline void __pdelete(STRING *res, const STRING *IN, __strlen_t L, __strlen_t P){
+    __strlen_t to_copy, len;
 
-    to_copy = P > IN.len ? IN.len : P-1;
-    memcpy(&res.body, &IN.body , to_copy);
-    P = res.len = to_copy;
+    to_copy = P > IN->len ? IN->len : P-1;
+    memmove(&res->body, &IN->body , to_copy);
+    P = len = to_copy;
 
-    if( IN.len > P + L ){
-        to_copy = IN.len - P - L;
-        memcpy(&res.body[res.len], &IN.body[P + L], to_copy);
-        res.len += to_copy;
+    if( IN->len > P + L ){
+        to_copy = IN->len - P - L;
+        memmove(&res->body[len], &IN->body[P + L], to_copy);
+        len += to_copy;
     }
 
-    return res;
+    res->len = len;
 }
 
 #define __iec_(TYPENAME) \
+static inline void DELETE__STRING__STRING__##TYPENAME##__##TYPENAME##_BY_REF(STRING *res, EN_ENO_PARAMS, const STRING *str, TYPENAME L, TYPENAME P){\
+  TEST_EN_COND_BY_REF(L < 0 || P < 0)\
+  __pdelete(res,str,(__strlen_t)L,(__strlen_t)P);\
+}\
 static inline STRING DELETE__STRING__STRING__##TYPENAME##__##TYPENAME(EN_ENO_PARAMS, STRING str, TYPENAME L, TYPENAME P){\
-  TEST_EN_COND(STRING, L < 0 || P < 0)\
-  return (STRING)__delete(str,(__strlen_t)L,(__strlen_t)P);\
+  STRING res;\
+  DELETE__STRING__STRING__##TYPENAME##__##TYPENAME##_BY_REF(&res, EN_ENO, &str, L, P);\
+  return res;\
 }
 __ANY_INT(__iec_)
 #undef __iec_
@@ -1387,38 +1581,42 @@ __ANY_INT(__iec_)
     /*     REPLACE     */
     /*******************/
 
-static inline STRING __replace(STRING IN1, STRING IN2, __strlen_t L, __strlen_t P){
-    STRING res;
+static inline void __preplace(STRING *res, const STRING *IN1, const STRING *IN2, __strlen_t L, __strlen_t P){
+    STRING tmp, *dest = res == IN1 || res == IN2 ? &tmp : res;
     __strlen_t to_copy;
-    res = __INIT_STRING;
 
-    to_copy = P > IN1.len ? IN1.len : P-1;
-    memcpy(&res.body, &IN1.body , to_copy);
-    P = res.len = to_copy;
+    to_copy = P > IN1->len ? IN1->len : P-1;
+    memcpy(&dest->body, &IN1->body , to_copy);
+    P = dest->len = to_copy;
 
-    to_copy = IN2.len < L ? IN2.len : L;
+    to_copy = IN2->len < L ? IN2->len : L;
 
-    if( to_copy + res.len > STR_MAX_LEN )
-       to_copy = STR_MAX_LEN - res.len;
+    if( to_copy + dest->len > STR_MAX_LEN )
+       to_copy = STR_MAX_LEN - dest->len;
 
-    memcpy(&res.body[res.len], &IN2.body , to_copy);
-    res.len += to_copy;
+    memcpy(&dest->body[dest->len], &IN2->body , to_copy);
+    dest->len += to_copy;
 
     P += L;
-    if( res.len <  STR_MAX_LEN && P < IN1.len)
+    if( dest->len <  STR_MAX_LEN && P < IN1->len)
     {
-        to_copy = IN1.len - P;
-        memcpy(&res.body[res.len], &IN1.body[P] , to_copy);
-        res.len += to_copy;
+        to_copy = IN1->len - P < STR_MAX_LEN - dest->len ? IN1->len - P : STR_MAX_LEN - dest->len;
+        memcpy(&dest->body[dest->len], &IN1->body[P] , to_copy);
+        dest->len += to_copy;
     }
 
-    return res;
+    if (dest != res) __pstring_copy(res, dest);
 }
 
 #define __iec_(TYPENAME) \
+static inline void REPLACE__STRING__STRING__STRING__##TYPENAME##__##TYPENAME##_BY_REF(STRING *res, EN_ENO_PARAMS, const STRING *str1, const STRING *str2, TYPENAME L, TYPENAME P){\
+  TEST_EN_COND_BY_REF(L < 0 || P < 0)\
+  __preplace(res,str1,str2,(__strlen_t)L,(__strlen_t)P);\
+}\
 static inline STRING REPLACE__STRING__STRING__STRING__##TYPENAME##__##TYPENAME(EN_ENO_PARAMS, STRING str1, STRING str2, TYPENAME L, TYPENAME P){\
-  TEST_EN_COND(STRING, L < 0 || P < 0)\
-  return (STRING)__replace(str1,str2,(__strlen_t)L,(__strlen_t)P);\
+  STRING res;\
+  REPLACE__STRING__STRING__STRING__##TYPENAME##__##TYPENAME##_BY_REF(&res, EN_ENO, &str1, &str2, L, P);\
+  return res;\
 }
 __ANY_INT(__iec_)
 #undef __iec_
@@ -57,6 +57,12 @@
 extern TIME __CURRENT_TIME;
 extern BOOL __DEBUG;
 
+#ifdef IEC_TIMER_WHEEL
+/* Timing wheel of the runtime backing TP, TON and TOF (see iec_std_FB.h) */
+void __timer_wheel_start(IEC_TIMER *timer, TIME PT);
+void __timer_wheel_stop(IEC_TIMER *timer);
+#endif
+
 /* TODO
 typedef struct {
     __strlen_t len;
@@ -105,6 +111,15 @@ typedef struct {
 #define __TOD_LITERAL(value) __literal(TOD,value)
 #define __DT_LITERAL(value) __literal(DT,value)
 #define __STRING_LITERAL(count,value) (STRING){count,value}
+/* Address of a STRING literal, for the _BY_REF functions taking their STRING
+ * inputs by reference. A compound literal is an lvalue in C but not in C++.
+ */
+#ifdef __cplusplus
+static inline const STRING *__string_ref(const STRING &value) {return &value;}
+#define __STRING_REF(value) __string_ref(value)
+#else
+#define __STRING_REF(value) (&(value))
+#endif
 #define __BYTE_LITERAL(value) __literal(BYTE,value)
 #define __WORD_LITERAL(value) __literal(WORD,value)
 #define __DWORD_LITERAL(value) __literal(DWORD,value,__32b_sufix)
@@ -166,6 +181,7 @@ static inline void __iec_error(void) {
 /* Time normalization function */
 /*******************************/
 
+#ifndef IEC_TIME_NS
 static inline void __normalize_timespec (IEC_TIMESPEC *ts) {
   if( ts->tv_nsec < -1000000000 || (( ts->tv_sec > 0 ) && ( ts->tv_nsec < 0 ))){
     ts->tv_sec--;
@@ -176,6 +192,7 @@ static inline void __normalize_timespec (IEC_TIMESPEC *ts) {
     ts->tv_nsec -= 1000000000;
   }
 }
+#endif
 
 /**********************************************/
 /* Time conversion to/from timespec functions */
@@ -223,6 +240,12 @@ static inline IEC_TIMESPEC __time_to_timespec(int sign, double mseconds, double
  *       They are therefore commented out. This however means that any change to the definition of IEC_TIMESPEC may require this
  *       macro to be updated too!
  */
+#ifdef IEC_TIME_NS
+/* NOTE: a single count of nanoseconds is rounded to the nearest nanosecond instead */
+#define __time_to_timespec(sign,mseconds,seconds,minutes,hours,days) \
+          ((IEC_TIMESPEC)(((sign>=0)?1:-1)*(int64_t)(\
+              ((((long double)days*24 + (long double)hours)*60 + (long double)minutes)*60 + (long double)seconds + (long double)mseconds/1e3)*1e9 + 0.5)))
+#else
 #define __time_to_timespec(sign,mseconds,seconds,minutes,hours,days) \
           ((IEC_TIMESPEC){\
               /*tv_sec  =*/ ((long int)   (((sign>=0)?1:-1)*((((long double)days*24 + (long double)hours)*60 + (long double)minutes)*60 + (long double)seconds + (long double)mseconds/1e3))), \
@@ -231,6 +254,7 @@ static inline IEC_TIMESPEC __time_to_timespec(int sign, double mseconds, double
                             ((long int)   (((sign>=0)?1:-1)*((((long double)days*24 + (long double)hours)*60 + (long double)minutes)*60 + (long double)seconds + (long double)mseconds/1e3)))   \
                             )*1e9))\
         })
+#endif
 
 
 
@@ -248,6 +272,11 @@ static inline IEC_TIMESPEC __tod_to_timespec(double seconds, double minutes, dou
   return ts;
 }
 */
+#ifdef IEC_TIME_NS
+#define __tod_to_timespec(seconds,minutes,hours) \
+          ((IEC_TIMESPEC)(int64_t)(\
+              ((((long double)hours)*60 + (long double)minutes)*60 + (long double)seconds)*1e9 + 0.5))
+#else
 #define __tod_to_timespec(seconds,minutes,hours) \
           ((IEC_TIMESPEC){\
               /*tv_sec  =*/ ((long int)   ((((long double)hours)*60 + (long double)minutes)*60 + (long double)seconds)), \
@@ -256,6 +285,7 @@ static inline IEC_TIMESPEC __tod_to_timespec(double seconds, double minutes, dou
                             ((long int)   ((((long double)hours)*60 + (long double)minutes)*60 + (long double)seconds))   \
                             )*1e9))\
         })
+#endif
 
 
 #define EPOCH_YEAR 1970
@@ -317,7 +347,6 @@ static inline tm convert_seconds_to_date_and_time(long int seconds) {
 }
 
 static inline IEC_TIMESPEC __date_to_timespec(int day, int month, int year) {
-  IEC_TIMESPEC ts;
   int a4, b4, a100, b100, a400, b400;
   int yday;
   int intervening_leap_days;
@@ -338,25 +367,36 @@ static inline IEC_TIMESPEC __date_to_timespec(int day, int month, int year) {
   b400 = b100 >> 2;
   intervening_leap_days = (a4 - b4) - (a100 - b100) + (a400 - b400);
   
-  ts.tv_sec = ((year - EPOCH_YEAR) * 365 + intervening_leap_days + yday - 1) * 24 * 60 * 60;
-  ts.tv_nsec = 0;
-
-  return ts;
+  return __time_from_parts(IEC_TIMESPEC, ((year - EPOCH_YEAR) * 365 + intervening_leap_days + yday - 1) * 24 * 60 * 60, 0);
 }
 
 static inline IEC_TIMESPEC __dt_to_timespec(double seconds, double minutes, double hours, int day, int month, int year) {
   IEC_TIMESPEC ts_date = __date_to_timespec(day, month, year);
   IEC_TIMESPEC ts = __tod_to_timespec(seconds, minutes, hours);
 
-  ts.tv_sec += ts_date.tv_sec;
-
-  return ts;
+  return __time_from_parts(IEC_TIMESPEC, __time_sec(ts) + __time_sec(ts_date), __time_nsec(ts));
 }
 
 /*******************/
 /* Time operations */
 /*******************/
 
+#ifdef IEC_TIME_NS
+#define __time_cmp(t1, t2) (((t1) > (t2)) - ((t1) < (t2)))
+
+static inline TIME __time_add(TIME IN1, TIME IN2){
+  return IN1 + IN2;
+}
+static inline TIME __time_sub(TIME IN1, TIME IN2){
+  return IN1 - IN2;
+}
+static inline TIME __time_mul(TIME IN1, LREAL IN2){
+  return (TIME)((LREAL)IN1 * IN2);
+}
+static inline TIME __time_div(TIME IN1, LREAL IN2){
+  return (TIME)((LREAL)IN1 / IN2);
+}
+#else
 #define __time_cmp(t1, t2) (t2.tv_sec == t1.tv_sec ? t1.tv_nsec - t2.tv_nsec : t1.tv_sec - t2.tv_sec)
 
 static inline TIME __time_add(TIME IN1, TIME IN2){
@@ -388,6 +428,7 @@ static inline TIME __time_div(TIME IN1, LREAL IN2){
   __normalize_timespec(&res);
   return res;
 }
+#endif
 
 
 /***************/
@@ -412,38 +453,37 @@ static inline ULINT __real_to_uint(LREAL IN) {return (ULINT)__preal_to_uint(IN);
     /***************/
     /*  TO_STRING  */
     /***************/
-static inline STRING __bool_to_string(BOOL IN) {
-    if(IN) return (STRING){4, "TRUE"};
-    return (STRING){5,"FALSE"};
+/* The __p..._to_string() versions write the STRING through res and only touch
+ * the bytes they use, the body after res->len is left as it was.
+ */
+static inline void __pbool_to_string(STRING *res, BOOL IN) {
+    if(IN) {res->len = 4; memcpy(&res->body, "TRUE", 4);}
+    else   {res->len = 5; memcpy(&res->body, "FALSE", 5);}
 }
-static inline STRING __bit_to_string(LWORD IN) {
-    STRING res;
-    res = __INIT_STRING;
-    res.len = snprintf((char*)res.body, STR_MAX_LEN, "16#%llx",(long long unsigned int)IN);
-    if(res.len > STR_MAX_LEN) res.len = STR_MAX_LEN;
-    return res;
+static inline void __pbit_to_string(STRING *res, LWORD IN) {
+    res->len = snprintf((char*)res->body, STR_MAX_LEN, "16#%llx",(long long unsigned int)IN);
+    if(res->len > STR_MAX_LEN) res->len = STR_MAX_LEN;
 }
-static inline STRING __real_to_string(LREAL IN) {
-    STRING res;
-    res = __INIT_STRING;
-    res.len = snprintf((char*)res.body, STR_MAX_LEN, "%.10g", IN);
-    if(res.len > STR_MAX_LEN) res.len = STR_MAX_LEN;
-    return res;
+static inline void __preal_to_string(STRING *res, LREAL IN) {
+    res->len = snprintf((char*)res->body, STR_MAX_LEN, "%.10g", IN);
+    if(res->len > STR_MAX_LEN) res->len = STR_MAX_LEN;
 }
-static inline STRING __sint_to_string(LINT IN) {
-    STRING res;
-    res = __INIT_STRING;
-    res.len = snprintf((char*)res.body, STR_MAX_LEN, "%lld", (long long int)IN);
-    if(res.len > STR_MAX_LEN) res.len = STR_MAX_LEN;
-    return res;
+static inline void __psint_to_string(STRING *res, LINT IN) {
+    res->len = snprintf((char*)res->body, STR_MAX_LEN, "%lld", (long long int)IN);
+    if(res->len > STR_MAX_LEN) res->len = STR_MAX_LEN;
 }
-static inline STRING __uint_to_string(ULINT IN) {
-    STRING res;
-    res = __INIT_STRING;
-    res.len = snprintf((char*)res.body, STR_MAX_LEN, "%llu", (long long unsigned int)IN);
-    if(res.len > STR_MAX_LEN) res.len = STR_MAX_LEN;
-    return res;
+static inline void __puint_to_string(STRING *res, ULINT IN) {
+    res->len = snprintf((char*)res->body, STR_MAX_LEN, "%llu", (long long unsigned int)IN);
+    if(res->len > STR_MAX_LEN) res->len = STR_MAX_LEN;
 }
+static inline STRING __bool_to_string(BOOL IN) {
+    if(IN) return (STRING){4, "TRUE"};
+    return (STRING){5,"FALSE"};
+}
+static inline STRING __bit_to_string(LWORD IN) {STRING res; __pbit_to_string(&res, IN); return res;}
+static inline STRING __real_to_string(LREAL IN) {STRING res; __preal_to_string(&res, IN); return res;}
+static inline STRING __sint_to_string(LINT IN) {STRING res; __psint_to_string(&res, IN); return res;}
+static inline STRING __uint_to_string(ULINT IN) {STRING res; __puint_to_string(&res, IN); return res;}
     /***************/
     /* FROM_STRING */
     /***************/
@@ -459,7 +499,7 @@ static inline LINT __pstring_to_sint(STRING* IN) {
     __strlen_t l;
     unsigned int shift = 0;
 
-    if(IN->body[0]=='2' && IN->body[1]=='#'){
+    if(IN->len >= 2 && IN->body[0]=='2' && IN->body[1]=='#'){
         /* 2#0101_1010_1011_1111 */
         for(l = IN->len - 1; l >= 2 && shift < 64; l--)
         {
@@ -469,7 +509,7 @@ static inline LINT __pstring_to_sint(STRING* IN) {
                 shift += 1;
             }
         }
-    }else if(IN->body[0]=='8' && IN->body[1]=='#'){
+    }else if(IN->len >= 2 && IN->body[0]=='8' && IN->body[1]=='#'){
         /* 8#1234_5665_4321 */
         for(l = IN->len - 1; l >= 2 && shift < 64; l--)
         {
@@ -479,7 +519,7 @@ static inline LINT __pstring_to_sint(STRING* IN) {
                 shift += 3;
             }
         }
-    }else if(IN->body[0]=='1' && IN->body[1]=='6' && IN->body[2]=='#'){
+    }else if(IN->len >= 3 && IN->body[0]=='1' && IN->body[1]=='6' && IN->body[2]=='#'){
         /* 16#1234_5678_9abc_DEFG */
         for(l = IN->len - 1; l >= 3 && shift < 64; l--)
         {
@@ -515,6 +555,14 @@ static inline LINT __pstring_to_sint(STRING* IN) {
     return res;
 }
 
+/* atof() on the bytes in use, the body after IN->len is not cleared */
+static inline LREAL __pstring_atof(STRING* IN) {
+    char buf[STR_MAX_LEN + 1];
+    memcpy(buf, &IN->body, IN->len);
+    buf[IN->len] = '\0';
+    return atof(buf);
+}
+
 static inline LINT  __string_to_sint(STRING IN) {return (LINT)__pstring_to_sint(&IN);}
 static inline LWORD __string_to_bit (STRING IN) {return (LWORD)__pstring_to_sint(&IN);}
 static inline ULINT __string_to_uint(STRING IN) {return (ULINT)__pstring_to_sint(&IN);}
@@ -524,7 +572,7 @@ static inline LREAL __string_to_real(STRING IN) {
     /* search the dot */
     while(--l > 0 && IN.body[l] != '.');
     if(l != 0){
-        return atof((const char *)&IN.body);
+        return __pstring_atof(&IN);
     }else{
         return (LREAL)__pstring_to_sint(&IN);
     }
@@ -533,8 +581,8 @@ static inline LREAL __string_to_real(STRING IN) {
     /***************/
     /*   TO_TIME   */
     /***************/
-static inline TIME    __int_to_time(LINT IN)  {return (TIME){IN, 0};}
-static inline TIME   __real_to_time(LREAL IN) {return (TIME){IN, (IN - (LINT)IN) * 1000000000};}
+static inline TIME    __int_to_time(LINT IN)  {return __time_from_parts(TIME, IN, 0);}
+static inline TIME   __real_to_time(LREAL IN) {return __time_from_parts(TIME, IN, (IN - (LINT)IN) * 1000000000);}
 static inline TIME __string_to_time(STRING IN){
     __strlen_t l;
     /* TODO :
@@ -562,10 +610,10 @@ static inline TIME __string_to_time(STRING IN){
     l = IN.len;
     while(--l > 0 && IN.body[l] != '.');
     if(l != 0){
-        LREAL IN_val = atof((const char *)&IN.body);
-        return  (TIME){(long)IN_val, (long)(IN_val - (LINT)IN_val)*1000000000};
+        LREAL IN_val = __pstring_atof(&IN);
+        return  __time_from_parts(TIME, (long)IN_val, (long)(IN_val - (LINT)IN_val)*1000000000);
     }else{
-        return  (TIME){(long)__pstring_to_sint(&IN), 0};
+        return  __time_from_parts(TIME, (long)__pstring_to_sint(&IN), 0);
     }
 }
 
@@ -573,83 +621,75 @@ static inline TIME __string_to_time(STRING IN){
     /*  FROM_TIME  */
     /***************/
 static inline LREAL __time_to_real(TIME IN){
-    return (LREAL)IN.tv_sec + ((LREAL)IN.tv_nsec/1000000000);
+    return (LREAL)__time_sec(IN) + ((LREAL)__time_nsec(IN)/1000000000);
 }
-static inline LINT __time_to_int(TIME IN) {return IN.tv_sec;}
-static inline STRING __time_to_string(TIME IN){
-    STRING res;
+static inline LINT __time_to_int(TIME IN) {return __time_sec(IN);}
+static inline void __ptime_to_string(STRING *res, TIME IN){
     div_t days;
     /*t#5d14h12m18s3.5ms*/
-    res = __INIT_STRING;
-    days = div((int &)IN.tv_sec, SECONDS_PER_DAY);
-    if(!days.rem && IN.tv_nsec == 0){
-        res.len = snprintf((char*)&res.body, STR_MAX_LEN, "T#%dd", days.quot);
+    days = div((int)__time_sec(IN), SECONDS_PER_DAY);
+    if(!days.rem && __time_nsec(IN) == 0){
+        res->len = snprintf((char*)&res->body, STR_MAX_LEN, "T#%dd", days.quot);
     }else{
         div_t hours = div(days.rem, SECONDS_PER_HOUR);
-        if(!hours.rem && IN.tv_nsec == 0){
-            res.len = snprintf((char*)&res.body, STR_MAX_LEN, "T#%dd%dh", days.quot, hours.quot);
+        if(!hours.rem && __time_nsec(IN) == 0){
+            res->len = snprintf((char*)&res->body, STR_MAX_LEN, "T#%dd%dh", days.quot, hours.quot);
         }else{
             div_t minuts = div(hours.rem, SECONDS_PER_MINUTE);
-            if(!minuts.rem && IN.tv_nsec == 0){
-                res.len = snprintf((char*)&res.body, STR_MAX_LEN, "T#%dd%dh%dm", days.quot, hours.quot, minuts.quot);
+            if(!minuts.rem && __time_nsec(IN) == 0){
+                res->len = snprintf((char*)&res->body, STR_MAX_LEN, "T#%dd%dh%dm", days.quot, hours.quot, minuts.quot);
             }else{
-                if(IN.tv_nsec == 0){
-                    res.len = snprintf((char*)&res.body, STR_MAX_LEN, "T#%dd%dh%dm%ds", days.quot, hours.quot, minuts.quot, minuts.rem);
+                if(__time_nsec(IN) == 0){
+                    res->len = snprintf((char*)&res->body, STR_MAX_LEN, "T#%dd%dh%dm%ds", days.quot, hours.quot, minuts.quot, minuts.rem);
                 }else{
-                    res.len = snprintf((char*)&res.body, STR_MAX_LEN, "T#%dd%dh%dm%ds%gms", days.quot, hours.quot, minuts.quot, minuts.rem, (LREAL)IN.tv_nsec / 1000000);
+                    res->len = snprintf((char*)&res->body, STR_MAX_LEN, "T#%dd%dh%dm%ds%gms", days.quot, hours.quot, minuts.quot, minuts.rem, (LREAL)__time_nsec(IN) / 1000000);
                 }
             }
         }
     }
-    if(res.len > STR_MAX_LEN) res.len = STR_MAX_LEN;
-    return res;
+    if(res->len > STR_MAX_LEN) res->len = STR_MAX_LEN;
 }
-static inline STRING __date_to_string(DATE IN){
-    STRING res;
+static inline void __pdate_to_string(STRING *res, DATE IN){
     tm broken_down_time;
     /* D#1984-06-25 */
-    broken_down_time = convert_seconds_to_date_and_time(IN.tv_sec);
-    res = __INIT_STRING;
-    res.len = snprintf((char*)&res.body, STR_MAX_LEN, "D#%d-%2.2d-%2.2d",
+    broken_down_time = convert_seconds_to_date_and_time(__time_sec(IN));
+    res->len = snprintf((char*)&res->body, STR_MAX_LEN, "D#%d-%2.2d-%2.2d",
              broken_down_time.tm_year,
              broken_down_time.tm_mon,
              broken_down_time.tm_day);
-    if(res.len > STR_MAX_LEN) res.len = STR_MAX_LEN;
-    return res;
+    if(res->len > STR_MAX_LEN) res->len = STR_MAX_LEN;
 }
-static inline STRING __tod_to_string(TOD IN){
-    STRING res;
+static inline void __ptod_to_string(STRING *res, TOD IN){
     tm broken_down_time;
     time_t seconds;
     /* TOD#15:36:55.36 */
-    seconds = IN.tv_sec;
+    seconds = __time_sec(IN);
     if (seconds >= SECONDS_PER_DAY){
 		__iec_error();
-		return (STRING){9,"TOD#ERROR"};
+		res->len = 9;
+		memcpy(&res->body, "TOD#ERROR", 9);
+		return;
 	}
     broken_down_time = convert_seconds_to_date_and_time(seconds);
-    res = __INIT_STRING;
-    if(IN.tv_nsec == 0){
-        res.len = snprintf((char*)&res.body, STR_MAX_LEN, "TOD#%2.2d:%2.2d:%2.2d",
+    if(__time_nsec(IN) == 0){
+        res->len = snprintf((char*)&res->body, STR_MAX_LEN, "TOD#%2.2d:%2.2d:%2.2d",
                  broken_down_time.tm_hour,
                  broken_down_time.tm_min,
                  broken_down_time.tm_sec);
     }else{
-        res.len = snprintf((char*)&res.body, STR_MAX_LEN, "TOD#%2.2d:%2.2d:%09.6f",
+        res->len = snprintf((char*)&res->body, STR_MAX_LEN, "TOD#%2.2d:%2.2d:%09.6f",
                  broken_down_time.tm_hour,
                  broken_down_time.tm_min,
-                 (LREAL)broken_down_time.tm_sec + (LREAL)IN.tv_nsec / 1e9);
+                 (LREAL)broken_down_time.tm_sec + (LREAL)__time_nsec(IN) / 1e9);
     }
-    if(res.len > STR_MAX_LEN) res.len = STR_MAX_LEN;
-    return res;
+    if(res->len > STR_MAX_LEN) res->len = STR_MAX_LEN;
 }
-static inline STRING __dt_to_string(DT IN){
-    STRING res;
+static inline void __pdt_to_string(STRING *res, DT IN){
     tm broken_down_time;
     /* DT#1984-06-25-15:36:55.36 */
-    broken_down_time = convert_seconds_to_date_and_time(IN.tv_sec);
-    if(IN.tv_nsec == 0){
-        res.len = snprintf((char*)&res.body, STR_MAX_LEN, "DT#%d-%2.2d-%2.2d-%2.2d:%2.2d:%2.2d",
+    broken_down_time = convert_seconds_to_date_and_time(__time_sec(IN));
+    if(__time_nsec(IN) == 0){
+        res->len = snprintf((char*)&res->body, STR_MAX_LEN, "DT#%d-%2.2d-%2.2d-%2.2d:%2.2d:%2.2d",
                  broken_down_time.tm_year,
                  broken_down_time.tm_mon,
                  broken_down_time.tm_day,
@@ -657,31 +697,35 @@ static inline STRING __dt_to_string(DT IN){
                  broken_down_time.tm_min,
                  broken_down_time.tm_sec);
     }else{
-        res.len = snprintf((char*)&res.body, STR_MAX_LEN, "DT#%d-%2.2d-%2.2d-%2.2d:%2.2d:%09.6f",
+        res->len = snprintf((char*)&res->body, STR_MAX_LEN, "DT#%d-%2.2d-%2.2d-%2.2d:%2.2d:%09.6f",
                  broken_down_time.tm_year,
                  broken_down_time.tm_mon,
                  broken_down_time.tm_day,
                  broken_down_time.tm_hour,
                  broken_down_time.tm_min,
-                 (LREAL)broken_down_time.tm_sec + ((LREAL)IN.tv_nsec / 1e9));
+                 (LREAL)broken_down_time.tm_sec + ((LREAL)__time_nsec(IN) / 1e9));
     }
-    if(res.len > STR_MAX_LEN) res.len = STR_MAX_LEN;
-    return res;
+    if(res->len > STR_MAX_LEN) res->len = STR_MAX_LEN;
 }
 
+static inline STRING __time_to_string(TIME IN) {STRING res; __ptime_to_string(&res, IN); return res;}
+static inline STRING __date_to_string(DATE IN) {STRING res; __pdate_to_string(&res, IN); return res;}
+static inline STRING __tod_to_string(TOD IN) {STRING res; __ptod_to_string(&res, IN); return res;}
+static inline STRING __dt_to_string(DT IN) {STRING res; __pdt_to_string(&res, IN); return res;}
+
     /**********************************************/
     /*  [ANY_DATE | TIME] _TO_ [ANY_DATE | TIME]  */
     /**********************************************/
 
 static inline TOD __date_and_time_to_time_of_day(DT IN) {
-	return (TOD){
-		IN.tv_sec % SECONDS_PER_DAY + (IN.tv_sec < 0 ? SECONDS_PER_DAY : 0),
-		IN.tv_nsec};
+	return __time_from_parts(TOD,
+		__time_sec(IN) % SECONDS_PER_DAY + (__time_sec(IN) < 0 ? SECONDS_PER_DAY : 0),
+		__time_nsec(IN));
 }
 static inline DATE __date_and_time_to_date(DT IN){
-	return (DATE){
-		IN.tv_sec - IN.tv_sec % SECONDS_PER_DAY - (IN.tv_sec < 0 ? SECONDS_PER_DAY : 0),
-		0};
+	return __time_from_parts(DATE,
+		__time_sec(IN) - __time_sec(IN) % SECONDS_PER_DAY - (__time_sec(IN) < 0 ? SECONDS_PER_DAY : 0),
+		0);
 }
 
     /*****************/
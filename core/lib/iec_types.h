@@ -34,10 +34,37 @@ typedef double   IEC_LREAL;
  *          __time_to_timespec() and __tod_to_timespec() will need to be changed accordingly.
  *          (these macros may be found in iec_std_lib.h)
  */
+/* NOTE: When IEC_TIME_NS is defined (it must then be defined for the generated code
+ *       and for the runtime alike), TIME, DATE, TOD and DT are instead a single
+ *       count of nanoseconds (since the epoch for DATE and DT, since midnight
+ *       for TOD), so the time operations in iec_std_lib.h are plain integer
+ *       operations. The code that does not depend on the representation uses
+ *       __time_sec(), __time_nsec() and __time_from_parts() (see below).
+ */
+#ifdef IEC_TIME_NS
+typedef int64_t IEC_TIMESPEC;
+#define __INIT_TIMESPEC(TYPENAME) ((TYPENAME)0)
+#else
 typedef struct {
     long int tv_sec;            /* Seconds.  */
     long int tv_nsec;           /* Nanoseconds.  */
 } /* __attribute__((packed)) */ IEC_TIMESPEC;  /* packed is gcc specific! */
+#define __INIT_TIMESPEC(TYPENAME) (TYPENAME){0,0}
+#endif
+
+/* Seconds and nanoseconds parts of a TIME (or DATE, TOD, DT), and the value
+ * built from its parts, whatever the representation (see IEC_TIME_NS above).
+ * Both parts of a negative time are negative.
+ */
+#ifdef IEC_TIME_NS
+#define __time_sec(t)  ((t) / 1000000000LL)
+#define __time_nsec(t) ((t) % 1000000000LL)
+#define __time_from_parts(TYPENAME, sec, nsec) ((TYPENAME)((int64_t)(sec) * 1000000000LL + (int64_t)(nsec)))
+#else
+#define __time_sec(t)  ((t).tv_sec)
+#define __time_nsec(t) ((t).tv_nsec)
+#define __time_from_parts(TYPENAME, sec, nsec) ((TYPENAME){(long int)(sec), (long int)(nsec)})
+#endif
 
 typedef IEC_TIMESPEC IEC_TIME;
 typedef IEC_TIMESPEC IEC_DATE;
@@ -62,7 +89,7 @@ typedef IEC_TIMESPEC IEC_TOD;
 #define __INIT_UINT 0
 #define __INIT_UDINT 0
 #define __INIT_ULINT 0
-#define __INIT_TIME (TIME){0,0}
+#define __INIT_TIME __INIT_TIMESPEC(TIME)
 #define __INIT_BOOL 0
 #define __INIT_BYTE 0
 #define __INIT_WORD 0
@@ -70,9 +97,9 @@ typedef IEC_TIMESPEC IEC_TOD;
 #define __INIT_LWORD 0
 #define __INIT_STRING (STRING){0,""}
 //#define __INIT_WSTRING
-#define __INIT_DATE (DATE){0,0}
-#define __INIT_TOD (TOD){0,0}
-#define __INIT_DT (DT){0,0}
+#define __INIT_DATE __INIT_TIMESPEC(DATE)
+#define __INIT_TOD __INIT_TIMESPEC(TOD)
+#define __INIT_DT __INIT_TIMESPEC(DT)
 
 typedef STR_LEN_TYPE __strlen_t;
 typedef struct {
@@ -80,4 +107,32 @@ typedef struct {
     uint8_t body[STR_MAX_LEN];
 } /* __attribute__((packed)) */ IEC_STRING;  /* packed is gcc specific! */
 
+/* Task descriptor generated by iec2c for every TASK of a resource.
+ * interval is in ns (0 means every common tick), priority follows IEC 61131-3
+ * (0 is the highest priority, -1 is used for the programs without a task).
+ */
+typedef struct {
+    const char *name;
+    void (*run)(unsigned long tick);
+    unsigned long long interval;
+    int priority;
+} IEC_TASK;
+
+/* Node of a TP, TON or TOF instance in the timing wheel of the runtime, used when
+ * it is built with IEC_TIMER_WHEEL (see iec_std_FB.h). expires is in common ticks,
+ * pt is the PT the timer was armed with.
+ * The node belongs to the runtime while the timer is pending.
+ */
+#define __TIMER_IDLE      0
+#define __TIMER_PENDING   1
+#define __TIMER_EXPIRED   2
+
+typedef struct __IEC_TIMER {
+    struct __IEC_TIMER *next;
+    struct __IEC_TIMER **pprev;
+    unsigned long long expires;
+    IEC_TIME pt;
+    int state;
+} IEC_TIMER;
+
 #endif /*IEC_TYPES_H*/
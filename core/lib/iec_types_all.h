@@ -72,18 +72,29 @@
 #define __IEC_RETAIN_FLAG 0x04
 #define __IEC_OUTPUT_FLAG 0x08
 
+/* With IEC_NO_FORCING the variables hold their value only: the flags and the
+ * forced value are left out of the layout, and the accessors of accessor.h
+ * are plain loads and stores */
+#ifdef IEC_NO_FORCING
+#define __IEC_FLAGS
+#define __IEC_FVALUE(type)
+#else
+#define __IEC_FLAGS IEC_BYTE flags;
+#define __IEC_FVALUE(type) type fvalue;
+#endif
+
 #define __DECLARE_IEC_TYPE(type)\
 typedef IEC_##type type;\
 \
 typedef struct {\
   IEC_##type value;\
-  IEC_BYTE flags;\
+  __IEC_FLAGS\
 } __IEC_##type##_t;\
 \
 typedef struct {\
   IEC_##type *value;\
-  IEC_BYTE flags;\
-  IEC_##type fvalue;\
+  __IEC_FLAGS\
+  __IEC_FVALUE(IEC_##type)\
 } __IEC_##type##_p;
 
 
@@ -96,13 +107,13 @@ typedef __IEC_##base##_p __IEC_##type##_p;
 #define __DECLARE_COMPLEX_STRUCT(type)\
 typedef struct {\
   type value;\
-  IEC_BYTE flags;\
+  __IEC_FLAGS\
 } __IEC_##type##_t;\
 \
 typedef struct {\
   type *value;\
-  IEC_BYTE flags;\
-  type fvalue;\
+  __IEC_FLAGS\
+  __IEC_FVALUE(type)\
 } __IEC_##type##_p;
 
 #define __DECLARE_ENUMERATED_TYPE(type, ...)\
@@ -42,17 +42,14 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
-#define MAX_BUF 1024
-
 #define OPLC_CYCLE          50000000
 
 extern int opterr;
-extern	void emergency_stop();
 
 //extern int common_ticktime__;
 IEC_BOOL __DEBUG;
 
-static int tick = 0;
+unsigned long scan_tick = 0; //read by the control socket
 
 int modbus_port = 502;
 int dnp3_port = 20000;
@@ -71,14 +68,20 @@ void sleep_thread(int milliseconds)
     nanosleep(&ts, NULL);
 }
 
-void sleep_until(struct timespec *ts, int delay)
+void next_deadline(struct timespec *ts, unsigned long long delay)
 {
-    ts->tv_nsec += delay;
+    ts->tv_sec += delay / 1000000000ULL;
+    ts->tv_nsec += delay % 1000000000ULL;
     if(ts->tv_nsec >= 1000*1000*1000)
     {
         ts->tv_nsec -= 1000*1000*1000;
         ts->tv_sec++;
     }
+}
+
+void sleep_until(struct timespec *ts, unsigned long long delay)
+{
+    next_deadline(ts, delay);
     clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, ts,  NULL);
 }
 
@@ -92,6 +95,34 @@ void *dnp3Thread(void *arg)
     dnp3StartServer(dnp3_port);
 }
 
+//-----------------------------------------------------------------------------
+// Runs the input, logic and output phases once. Only the periodic scan
+// records the duration of the phases
+//-----------------------------------------------------------------------------
+static void runScan(unsigned long run_tick, bool run_logic, bool timed)
+{
+	updateBuffersIn(); //read input image
+	if (timed) scanPhaseEnd(SCAN_PHASE_INPUT);
+
+	pthread_mutex_lock(&bufferLock); //lock mutex
+	applyImageWrites(); //apply the writes queued by the network
+	applyForcing(); //the forced variables win over the inputs and the network
+	//with the task scheduler the logic runs on the task threads
+	if (run_logic)
+		config_run__(run_tick); // execute plc program logic
+	applyForcing(); //and over the program
+	pthread_mutex_unlock(&bufferLock); //unlock mutex
+	if (timed) scanPhaseEnd(SCAN_PHASE_LOGIC);
+
+	//the outputs stay low after the watchdog has stopped them
+	if (!__atomic_load_n(&outputs_safe, __ATOMIC_ACQUIRE))
+		updateBuffersOut(); //write output image
+	pthread_mutex_lock(&bufferLock);
+	publishProcessImage(); //make the new values visible to the network
+	pthread_mutex_unlock(&bufferLock);
+	if (timed) scanPhaseEnd(SCAN_PHASE_OUTPUT);
+}
+
 double measureTime(struct timespec *timer_start)
 {
     struct timespec timer_end;
@@ -106,11 +137,19 @@ double measureTime(struct timespec *timer_start)
 }
 
 void print_usage() {
-    printf("Usage: ./novaplc -m modbus_port -d dnp3_port\n");
+    printf("Usage: ./novaplc -m modbus_port -d dnp3_port -s stats_interval -t -g -c config_file\n");
     printf("./novaplc will run with modbus on port 502 and ");
     printf("dnp3 on port 20000\n");
     printf("Selecting only modbus or only dnp3 will only run that ");
     printf("protocol\n");
+    printf("-s prints the scan cycle timing statistics every ");
+    printf("stats_interval seconds\n");
+    printf("-t runs every IEC task on its own thread with the ");
+    printf("task interval and priority\n");
+    printf("-g checks on every scan that the located variables are ");
+    printf("still bound to the buffers\n");
+    printf("-c reads the runtime settings from config_file ");
+    printf("(default novaplc.cfg)\n");
 }
 
 int main(int argc,char **argv)
@@ -118,19 +157,19 @@ int main(int argc,char **argv)
 
 bool modbus_flag = false;
 bool dnp3_flag = false;
-int fd;
-char plcfifo[32];
-char buf[MAX_BUF];
 int opt;
-int	runstop=0 , readlen=0;
-    sprintf(plcfifo,"/tmp/plcfifo");
+int stats_interval = 0;
+bool multitask_flag = false;
+bool validate_flag = false;
+const char *config_file = "novaplc.cfg";
+    initStartupTiming();
     opterr = 0;
 
     //======================================================
     //                 READ COMMAND LINE ARGS
     //======================================================
 
-    while ((opt = getopt (argc, argv, "m:d:")) != -1) {
+    while ((opt = getopt (argc, argv, "m:d:s:tgc:")) != -1) {
       switch (opt) {
         case 'm':
             modbus_flag = true;
@@ -140,6 +179,18 @@ int	runstop=0 , readlen=0;
             dnp3_flag = true;
             dnp3_port = atoi(optarg);
             break;
+        case 's':
+            stats_interval = atoi(optarg);
+            break;
+        case 't':
+            multitask_flag = true;
+            break;
+        case 'g':
+            validate_flag = true;
+            break;
+        case 'c':
+            config_file = optarg;
+            break;
         case '?':
             if (isprint (optopt))
                 fprintf (stderr, "Unknown option `-%c'.\n", optopt);
@@ -156,17 +207,26 @@ int	runstop=0 , readlen=0;
     setvbuf(stdout, NULL, _IONBF, 0);
     setvbuf(stderr, NULL, _IONBF, 0);
     printf("novaplc Software running...\n");
+    loadRuntimeConfig(config_file);
+    loadThreadConfig();
+    startupPhaseEnd("config");
 
     //======================================================
     //                 PLC INITIALIZATION
     //======================================================
     config_init__();
-    glueVars();
+    glueVars(); //bind the buffers to the located variables once
+    startupPhaseEnd("plc init");
 
     //======================================================
     //               MUTEX INITIALIZATION
     //======================================================
-    if (pthread_mutex_init(&bufferLock, NULL) != 0)
+    // priority inheritance keeps a low priority task holding the lock
+    // from blocking the higher priority ones
+    pthread_mutexattr_t lock_attr;
+    pthread_mutexattr_init(&lock_attr);
+    pthread_mutexattr_setprotocol(&lock_attr, PTHREAD_PRIO_INHERIT);
+    if (pthread_mutex_init(&bufferLock, &lock_attr) != 0)
     {
         printf("Mutex init failed\n");
         exit(1);
@@ -178,10 +238,24 @@ int	runstop=0 , readlen=0;
     initializeHardware();
     updateBuffersIn();
     updateBuffersOut();
+    startupPhaseEnd("hardware");
+
+    //======================================================
+    //             PROCESS IMAGE INITIALIZATION
+    //======================================================
+    mapUnusedIO();
+    initProcessImage();
+    startupPhaseEnd("process image");
+
     pthread_t modbus_thread;
     pthread_t dnp3_thread;
-    if(modbus_flag ) 
-        pthread_create(&modbus_thread, NULL, modbusThread, NULL);
+    if(modbus_flag && pthread_create(&modbus_thread, NULL, modbusThread, NULL) == 0)
+        setupThread(modbus_thread, THREAD_CLASS_NETWORK, "modbus", -1);
+
+    //the Modbus RTU slave runs when a serial port is configured
+    pthread_t rtu_thread;
+    if (configString("rtu.device", "")[0] != '\0' && pthread_create(&rtu_thread, NULL, modbusRtuThread, NULL) == 0)
+        setupThread(rtu_thread, THREAD_CLASS_NETWORK, "modbus rtu", -1);
 
     /*
     if(modbus_flag || (!modbus_flag && !dnp3_flag)) {
@@ -194,79 +268,153 @@ int	runstop=0 , readlen=0;
     //======================================================
     //          PERSISTENT STORAGE INITIALIZATION
     //======================================================
-    //readPersistentStorage();
-    //pthread_t persistentThread;
-    //pthread_create(&persistentThread, NULL, persistentStorage, NULL);
+    //the holding registers and the RETAIN variables are retained when a
+    //store is configured. They are restored here, before the first scan
+    pthread_t persistentThread;
+    if (configString("retain.file", "")[0] != '\0')
+    {
+        readPersistentStorage();
+        if (pthread_create(&persistentThread, NULL, persistentStorage, NULL) == 0)
+            setupThread(persistentThread, THREAD_CLASS_PERSIST, "retain", -1);
+    }
+
+    //======================================================
+    //          SCAN CYCLE STATISTICS INITIALIZATION
+    //======================================================
+    initScanTiming(common_ticktime__);
+    pthread_t stats_thread;
+    if (stats_interval > 0 && pthread_create(&stats_thread, NULL, scanStatsThread, &stats_interval) == 0)
+        setupThread(stats_thread, THREAD_CLASS_LOGGING, "stats", -1);
+    startupPhaseEnd("threads");
 
 #ifdef __linux__
     //======================================================
     //              REAL-TIME INITIALIZATION
     //======================================================
-    // Set our thread to real time priority
-    struct sched_param sp;
-    sp.sched_priority = 30;
+    // Set our thread to the CPUs and real time priority of the scan class
     printf("Setting main thread priority to RT\n");
-    if(pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp))
-    {
-        printf("WARNING: Failed to set main thread to real-time priority\n");
-    }
+    setupThread(pthread_self(), THREAD_CLASS_SCAN, "scan", -1);
 
-    // Lock memory to ensure no swapping is done.
+    // Lock memory to ensure no swapping is done. The stack and the heap
+    // are touched first so the scan doesn't fault them in later
     printf("Locking main thread memory\n");
-    if(mlockall(MCL_FUTURE|MCL_CURRENT))
+    lockMemory();
+    startupPhaseEnd("real-time");
+#endif
+
+    //======================================================
+    //              TASK SCHEDULER INITIALIZATION
+    //======================================================
+    if (multitask_flag && startTaskScheduler() == 0)
     {
-        printf("WARNING: Failed to lock memory\n");
+        printf("WARNING: No task could be started, running config_run__() on the common tick\n");
+        multitask_flag = false;
     }
-#endif
 
 	//gets the starting point for the clock
 	printf("Getting current time\n");
 	struct timespec timer_start;
 	clock_gettime(CLOCK_MONOTONIC, &timer_start);
 
-	mkfifo(plcfifo, 0666);
-    	fd = open(plcfifo, O_RDONLY | O_NONBLOCK | O_CREAT);
+	startControlServer();
+	startWatchdog(argv, common_ticktime__);
+	watchdogKick(&timer_start);
+	startupPhaseEnd("scheduler, control");
+
+	//after a restart by the watchdog the program runs right away
+	if (getenv("NOVAPLC_RESTARTS") != NULL)
+	{
+		printf("Watchdog: restart %s, running\n", getenv("NOVAPLC_RESTARTS"));
+		plc_state = PLC_STATE_RUNNING;
+	}
+	printStartupReport();
+	printThreadReport();
 
 	//======================================================
 	//                    MAIN LOOP
+	//  The state is changed through the control socket:
 	//                    START : start when stopped or paused
-	//                    PAUSE : pause then resume if START 
-	//                    STOP : stop, exit
+	//                    PAUSE : pause then resume if START
+	//                    STEP  : run single scans while paused
+	//                    STOP  : stop, exit
 	//======================================================
 	for(;;)
 	{
-		bzero(buf,MAX_BUF);
-    		readlen = read(fd, buf, MAX_BUF);
-		if ( readlen > 0 )
-			printf("Received %d: %s\n",readlen, buf);
-
-		if ( strcmp(buf,"START") == 0 )
-			runstop=1;
-		if ( strcmp(buf,"PAUSE") == 0 )
-			runstop=0;
-		if ( strcmp(buf,"STOP") == 0 )
+		int state = __atomic_load_n(&plc_state, __ATOMIC_ACQUIRE);
+		if ( state == PLC_STATE_STOPPED )
 		{
 			emergency_stop();
-    			close(fd);
 			exit(0);
 		}
-		if ( runstop == 1 )
+		__atomic_store_n(&tasks_running, state == PLC_STATE_RUNNING, __ATOMIC_RELEASE);
+
+		if ( state == PLC_STATE_RUNNING )
 		{
-			//make sure the buffer pointers are correct and
-			//attached to the user variables
-			glueVars();
-		
-			updateBuffersIn(); //read input image
-
-			pthread_mutex_lock(&bufferLock); //lock mutex
-			config_run__(tick++); // execute plc program logic
-			pthread_mutex_unlock(&bufferLock); //unlock mutex
-
-			updateBuffersOut(); //write output image
-		
+			//the buffers are bound once at init. In validation mode
+			//check that nothing has changed them since
+			if (validate_flag)
+			{
+				int unbound = validateGlueVars();
+				if (unbound > 0)
+				{
+					printf("WARNING: %d located variables were unbound, binding them again\n", unbound);
+					glueVars();
+				}
+			}
+
+			scanCycleBegin(&timer_start);
+			runScan(scan_tick, !multitask_flag, true);
+			__atomic_store_n(&scan_tick, scan_tick + 1, __ATOMIC_RELAXED);
+			pthread_mutex_lock(&bufferLock); //the clock is read by the tasks and saved with the RETAIN variables
 			updateTime();
+			pthread_mutex_unlock(&bufferLock);
+#ifdef IEC_TIMER_WHEEL
+			advanceTimerWheel();
+#endif
+			int action = watchdogOverrun(scanCycleEnd(&timer_start, common_ticktime__));
+			if (action == WATCHDOG_SKIP)
+				next_deadline(&timer_start, common_ticktime__);
+			else if (action == WATCHDOG_SAFE)
+				watchdogSafeState();
+			else if (action == WATCHDOG_RESTART)
+				watchdogRestart();
+		}
+		else if ( takeScanStep() )
+		{
+			//a single step runs every task on this thread, the task
+			//threads are held while paused
+			runScan(scan_tick, true, false);
+			__atomic_store_n(&scan_tick, scan_tick + 1, __ATOMIC_RELAXED);
+			pthread_mutex_lock(&bufferLock);
+			updateTime();
+			pthread_mutex_unlock(&bufferLock);
+#ifdef IEC_TIMER_WHEEL
+			advanceTimerWheel();
+#endif
+			scanStepDone(scan_tick - 1);
+		}
+		else
+		{
+			//keep serving writes and reads from the network while paused
+			pthread_mutex_lock(&bufferLock);
+			applyImageWrites();
+			publishProcessImage();
+			pthread_mutex_unlock(&bufferLock);
+		}
+
+		//an edge on an interrupt input wakes the scan thread before the
+		//deadline for an extra scan. It runs the tasks of the last cycle
+		//again and doesn't move the next deadline
+		next_deadline(&timer_start, common_ticktime__);
+		watchdogKick(&timer_start);
+		while (waitScanTrigger(&timer_start))
+		{
+			//PAUSE, STOP or the watchdog may have stopped the program since
+			//the top of the cycle, the loop above handles the new state
+			if ( __atomic_load_n(&plc_state, __ATOMIC_ACQUIRE) != PLC_STATE_RUNNING )
+				break;
+			runScan(scan_tick > 0 ? scan_tick - 1 : 0, !multitask_flag, false);
+			interruptScanDone();
 		}
-		sleep_until(&timer_start, common_ticktime__);
 	}
 }
-
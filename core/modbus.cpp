@@ -25,23 +25,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <pthread.h>
 
 #include "ladder.h"
 
-#define MAX_DISCRETE_INPUT 		800
-#define MAX_COILS 				800
-#define MAX_HOLD_REGS 			8192
-#define MAX_INP_REGS			1024
-
-#define MIN_16B_RANGE			1024
-#define MAX_16B_RANGE			2047
-#define MIN_32B_RANGE			2048
-#define MAX_32B_RANGE			4095
-#define MIN_64B_RANGE			4096
-#define MAX_64B_RANGE			8191
-
 #define MB_FC_NONE							0
 #define MB_FC_READ_COILS					1
 #define MB_FC_READ_INPUTS					2
@@ -51,6 +40,9 @@
 #define MB_FC_WRITE_REGISTER				6
 #define MB_FC_WRITE_MULTIPLE_COILS			15
 #define MB_FC_WRITE_MULTIPLE_REGISTERS		16
+#define MB_FC_MASK_WRITE_REGISTER			22
+#define MB_FC_READ_WRITE_MULTIPLE_REGISTERS	23
+#define MB_FC_ENCAPSULATED_INTERFACE		43
 #define MB_FC_ERROR							255
 
 #define ERR_NONE							0
@@ -60,6 +52,34 @@
 #define ERR_SLAVE_DEVICE_FAILURE			4
 #define ERR_SLAVE_DEVICE_BUSY				6
 
+//Read Device Identification (FC 43 / MEI type 14)
+#define MEI_READ_DEVICE_ID					14
+#define DEVICE_ID_BASIC						1
+#define DEVICE_ID_REGULAR					2
+#define DEVICE_ID_EXTENDED					3
+#define DEVICE_ID_SPECIFIC					4
+#define DEVICE_ID_CONFORMITY				0x82 //regular, stream and individual access
+
+#ifdef NOVASOM_M7
+#define DEVICE_MODEL_NAME					"NOVAsomM7"
+#elif defined NOVASOM_P
+#define DEVICE_MODEL_NAME					"NOVAsomP"
+#else
+#define DEVICE_MODEL_NAME					"NOVAsom"
+#endif
+
+static const char *device_id_objects[] =
+{
+	"Novasom Industries",				//VendorName
+	"NOVAplc",							//ProductCode
+	"1.0",								//MajorMinorRevision
+	"http://www.novasomindustries.com",	//VendorUrl
+	"NOVAplc Runtime",					//ProductName
+	DEVICE_MODEL_NAME,					//ModelName
+};
+#define DEVICE_ID_OBJECTS					6
+#define DEVICE_ID_BASIC_OBJECTS				3
+
 
 #define bitRead(value, bit) (((value) >> (bit)) & 0x01)
 #define bitSet(value, bit) ((value) |= (1UL << (bit)))
@@ -74,7 +94,8 @@ IEC_BOOL mb_coils[MAX_COILS];
 IEC_UINT mb_input_regs[MAX_INP_REGS];
 IEC_UINT mb_holding_regs[MAX_HOLD_REGS];
 
-int MessageLength;
+//length of the response being built, one per server thread
+static __thread int MessageLength;
 
 
 
@@ -118,7 +139,7 @@ void mapUnusedIO()
 			if (int_output[i] == NULL) int_output[i] = &mb_holding_regs[i];
 
 		if (i >= MIN_16B_RANGE && i <= MAX_16B_RANGE)
-			if (int_memory[i - MIN_16B_RANGE] == NULL) int_memory[i] = &mb_holding_regs[i];
+			if (int_memory[i - MIN_16B_RANGE] == NULL) int_memory[i - MIN_16B_RANGE] = &mb_holding_regs[i];
 	}
 
 	pthread_mutex_unlock(&bufferLock);
@@ -142,7 +163,6 @@ void ModbusError(unsigned char *buffer, int mb_error)
 void ReadCoils(unsigned char *buffer, int bufferSize)
 {
 	int Start, ByteDataLength, CoilDataLength;
-	int mb_error = ERR_NONE;
 
 	//this request must have at least 12 bytes. If it doesn't, it's a corrupted message
 	if (bufferSize < 12)
@@ -163,44 +183,19 @@ void ReadCoils(unsigned char *buffer, int bufferSize)
 		return;
 	}
 
+	//the coils are copied already packed, straight into the response
+	if (readImageBits(IMAGE_COILS, Start, CoilDataLength, &buffer[9]) < 0)
+	{
+		ModbusError(buffer, ERR_ILLEGAL_DATA_ADDRESS);
+		return;
+	}
+
 	//preparing response
 	buffer[4] = highByte(ByteDataLength + 3);
 	buffer[5] = lowByte(ByteDataLength + 3); //Number of bytes after this one
 	buffer[8] = ByteDataLength;     //Number of bytes of data
 
-	pthread_mutex_lock(&bufferLock);
-	for(int i = 0; i < ByteDataLength ; i++)
-	{
-		for(int j = 0; j < 8; j++)
-		{
-			int position = Start + i * 8 + j;
-			if (position < MAX_COILS)
-			{
-				if (bool_output[position/8][position%8] != NULL)
-				{
-					bitWrite(buffer[9 + i], j, *bool_output[position/8][position%8]);
-				}
-				else
-				{
-					bitWrite(buffer[9 + i], j, 0);
-				}
-			}
-			else //invalid address
-			{
-				mb_error = ERR_ILLEGAL_DATA_ADDRESS;
-			}
-		}
-	}
-	pthread_mutex_unlock(&bufferLock);
-
-	if (mb_error != ERR_NONE)
-	{
-		ModbusError(buffer, mb_error);
-	}
-	else
-	{
-		MessageLength = ByteDataLength + 9;
-	}
+	MessageLength = ByteDataLength + 9;
 }
 
 //-----------------------------------------------------------------------------
@@ -209,7 +204,6 @@ void ReadCoils(unsigned char *buffer, int bufferSize)
 void ReadDiscreteInputs(unsigned char *buffer, int bufferSize)
 {
 	int Start, ByteDataLength, InputDataLength;
-	int mb_error = ERR_NONE;
 
 	//this request must have at least 12 bytes. If it doesn't, it's a corrupted message
 	if (bufferSize < 12)
@@ -230,53 +224,27 @@ void ReadDiscreteInputs(unsigned char *buffer, int bufferSize)
 		return;
 	}
 
+	//the inputs are copied already packed, straight into the response
+	if (readImageBits(IMAGE_DISCRETE_INPUTS, Start, InputDataLength, &buffer[9]) < 0)
+	{
+		ModbusError(buffer, ERR_ILLEGAL_DATA_ADDRESS);
+		return;
+	}
+
 	//Preparing response
 	buffer[4] = highByte(ByteDataLength + 3);
 	buffer[5] = lowByte(ByteDataLength + 3); //Number of bytes after this one
 	buffer[8] = ByteDataLength;     //Number of bytes of data
 
-	pthread_mutex_lock(&bufferLock);
-	for(int i = 0; i < ByteDataLength ; i++)
-	{
-		for(int j = 0; j < 8; j++)
-		{
-			int position = Start + i * 8 + j;
-			if (position < MAX_DISCRETE_INPUT)
-			{
-				if (bool_input[position/8][position%8] != NULL)
-				{
-					bitWrite(buffer[9 + i], j, *bool_input[position/8][position%8]);
-				}
-				else
-				{
-					bitWrite(buffer[9 + i], j, 0);
-				}
-			}
-			else //invalid address
-			{
-				mb_error = ERR_ILLEGAL_DATA_ADDRESS;
-			}
-		}
-	}
-	pthread_mutex_unlock(&bufferLock);
-
-	if (mb_error != ERR_NONE)
-	{
-		ModbusError(buffer, mb_error);
-	}
-	else
-	{
-		MessageLength = ByteDataLength + 9;
-	}
+	MessageLength = ByteDataLength + 9;
 }
 
 //-----------------------------------------------------------------------------
-// Implementation of Modbus/TCP Read Holding Registers
+// Copies registers from the process image to the response buffer
 //-----------------------------------------------------------------------------
-void ReadHoldingRegisters(unsigned char *buffer, int bufferSize)
+static void ReadRegisters(unsigned char *buffer, int bufferSize, int area)
 {
 	int Start, WordDataLength, ByteDataLength;
-	int mb_error = ERR_NONE;
 
 	//this request must have at least 12 bytes. If it doesn't, it's a corrupted message
 	if (bufferSize < 12)
@@ -296,110 +264,68 @@ void ReadHoldingRegisters(unsigned char *buffer, int bufferSize)
 		return;
 	}
 
+	//the image is already big endian, straight into the response
+	if (readImageRegisters(area, Start, WordDataLength, &buffer[9]) < 0)
+	{
+		ModbusError(buffer, ERR_ILLEGAL_DATA_ADDRESS);
+		return;
+	}
+
 	//preparing response
 	buffer[4] = highByte(ByteDataLength + 3);
 	buffer[5] = lowByte(ByteDataLength + 3); //Number of bytes after this one
 	buffer[8] = ByteDataLength;     //Number of bytes of data
 
-	pthread_mutex_lock(&bufferLock);
-	for(int i = 0; i < WordDataLength; i++)
+	MessageLength = ByteDataLength + 9;
+}
+
+//-----------------------------------------------------------------------------
+// Implementation of Modbus/TCP Read Holding Registers
+//-----------------------------------------------------------------------------
+void ReadHoldingRegisters(unsigned char *buffer, int bufferSize)
+{
+	ReadRegisters(buffer, bufferSize, IMAGE_HOLDING_REGS);
+}
+
+//-----------------------------------------------------------------------------
+// Implementation of Modbus/TCP Read Input Registers
+//-----------------------------------------------------------------------------
+void ReadInputRegisters(unsigned char *buffer, int bufferSize)
+{
+	ReadRegisters(buffer, bufferSize, IMAGE_INPUT_REGS);
+}
+
+//-----------------------------------------------------------------------------
+// Converts the result of a write queued to the process image to a Modbus
+// error code
+//-----------------------------------------------------------------------------
+static int WriteError(int ret)
+{
+	if (ret == -1) return ERR_ILLEGAL_DATA_ADDRESS;
+	if (ret == -2) return ERR_SLAVE_DEVICE_BUSY;
+
+	return ERR_NONE;
+}
+
+//-----------------------------------------------------------------------------
+// Implementation of Modbus/TCP Write Coil
+//-----------------------------------------------------------------------------
+void WriteCoil(unsigned char *buffer, int bufferSize)
+{
+	int Start;
+	int mb_error = ERR_NONE;
+
+	//this request must have at least 12 bytes. If it doesn't, it's a corrupted message
+	if (bufferSize < 12)
 	{
-		int position = Start + i;
-		if (position <= MIN_16B_RANGE)
-		{
-			if (int_output[position] != NULL)
-			{
-				buffer[ 9 + i * 2] = highByte(*int_output[position]);
-				buffer[10 + i * 2] = lowByte(*int_output[position]);
-			}
-			else
-			{
-				buffer[ 9 + i * 2] = 0;
-				buffer[10 + i * 2] = 0;
-			}
-		}
-		//accessing memory
-		//16-bit registers
-		else if (position >= MIN_16B_RANGE && position <= MAX_16B_RANGE)
-		{
-			if (int_memory[position - MIN_16B_RANGE] != NULL)
-			{
-				buffer[ 9 + i * 2] = highByte(*int_memory[position - MIN_16B_RANGE]);
-				buffer[10 + i * 2] = lowByte(*int_memory[position - MIN_16B_RANGE]);
-			}
-			else
-			{
-				buffer[ 9 + i * 2] = 0;
-				buffer[10 + i * 2] = 0;
-			}
-		}
-		//32-bit registers
-		else if (position >= MIN_32B_RANGE && position <= MAX_32B_RANGE)
-		{
-			if (dint_memory[(position - MIN_32B_RANGE)/2] != NULL)
-			{
-				if ((position - MIN_32B_RANGE) % 2 == 0) //first word
-				{
-					uint16_t tempValue = (uint16_t)(*dint_memory[(position - MIN_32B_RANGE)/2] >> 16);
-					buffer[ 9 + i * 2] = highByte(tempValue);
-					buffer[10 + i * 2] = lowByte(tempValue);
-				}
-				else //second word
-				{
-					uint16_t tempValue = (uint16_t)(*dint_memory[(position - MIN_32B_RANGE)/2] & 0xffff);
-					buffer[ 9 + i * 2] = highByte(tempValue);
-					buffer[10 + i * 2] = lowByte(tempValue);
-				}
-			}
-			else
-			{
-				buffer[ 9 + i * 2] = mb_holding_regs[position];
-				buffer[10 + i * 2] = mb_holding_regs[position];
-			}
-		}
-		//64-bit registers
-		else if (position >= MIN_64B_RANGE && position <= MAX_64B_RANGE)
-		{
-			if (lint_memory[(position - MIN_64B_RANGE)/4] != NULL)
-			{
-				if ((position - MIN_64B_RANGE) % 4 == 0) //first word
-				{
-					uint16_t tempValue = (uint16_t)(*lint_memory[(position - MIN_64B_RANGE)/4] >> 48);
-					buffer[ 9 + i * 2] = highByte(tempValue);
-					buffer[10 + i * 2] = lowByte(tempValue);
-				}
-				else if ((position - MIN_64B_RANGE) % 4 == 1)//second word
-				{
-					uint16_t tempValue = (uint16_t)((*lint_memory[(position - MIN_64B_RANGE)/4] >> 32) & 0xffff);
-					buffer[ 9 + i * 2] = highByte(tempValue);
-					buffer[10 + i * 2] = lowByte(tempValue);
-				}
-				else if ((position - MIN_64B_RANGE) % 4 == 2)//third word
-				{
-					uint16_t tempValue = (uint16_t)((*lint_memory[(position - MIN_64B_RANGE)/4] >> 16) & 0xffff);
-					buffer[ 9 + i * 2] = highByte(tempValue);
-					buffer[10 + i * 2] = lowByte(tempValue);
-				}
-				else if ((position - MIN_64B_RANGE) % 4 == 3)//fourth word
-				{
-					uint16_t tempValue = (uint16_t)(*lint_memory[(position - MIN_64B_RANGE)/4] & 0xffff);
-					buffer[ 9 + i * 2] = highByte(tempValue);
-					buffer[10 + i * 2] = lowByte(tempValue);
-				}
-			}
-			else
-			{
-				buffer[ 9 + i * 2] = mb_holding_regs[position];
-				buffer[10 + i * 2] = mb_holding_regs[position];
-			}
-		}
-		//invalid address
-		else
-		{
-			mb_error = ERR_ILLEGAL_DATA_ADDRESS;
-		}
+		ModbusError(buffer, ERR_ILLEGAL_DATA_VALUE);
+		return;
 	}
-	pthread_mutex_unlock(&bufferLock);
+
+	Start = word(buffer[8], buffer[9]);
+
+	IEC_UINT value = word(buffer[10], buffer[11]) > 0 ? 1 : 0;
+	mb_error = WriteError(queueImageWrite(IMAGE_COILS, Start, 1, &value));
 
 	if (mb_error != ERR_NONE)
 	{
@@ -407,16 +333,18 @@ void ReadHoldingRegisters(unsigned char *buffer, int bufferSize)
 	}
 	else
 	{
-		MessageLength = ByteDataLength + 9;
+		buffer[4] = 0;
+		buffer[5] = 6; //Number of bytes after this one.
+		MessageLength = 12;
 	}
 }
 
 //-----------------------------------------------------------------------------
-// Implementation of Modbus/TCP Read Input Registers
+// Implementation of Modbus/TCP Write Holding Register
 //-----------------------------------------------------------------------------
-void ReadInputRegisters(unsigned char *buffer, int bufferSize)
+void WriteRegister(unsigned char *buffer, int bufferSize)
 {
-	int Start, WordDataLength, ByteDataLength;
+	int Start;
 	int mb_error = ERR_NONE;
 
 	//this request must have at least 12 bytes. If it doesn't, it's a corrupted message
@@ -427,44 +355,9 @@ void ReadInputRegisters(unsigned char *buffer, int bufferSize)
 	}
 
 	Start = word(buffer[8],buffer[9]);
-	WordDataLength = word(buffer[10],buffer[11]);
-	ByteDataLength = WordDataLength * 2;
-
-	//asked for too many registers
-	if (ByteDataLength > 255)
-	{
-		ModbusError(buffer, ERR_ILLEGAL_DATA_ADDRESS);
-		return;
-	}
 
-	//preparing response
-	buffer[4] = highByte(ByteDataLength + 3);
-	buffer[5] = lowByte(ByteDataLength + 3); //Number of bytes after this one
-	buffer[8] = ByteDataLength;     //Number of bytes of data
-
-	pthread_mutex_lock(&bufferLock);
-	for(int i = 0; i < WordDataLength; i++)
-	{
-		int position = Start + i;
-		if (position < MAX_INP_REGS)
-		{
-			if (int_input[position] != NULL)
-			{
-				buffer[ 9 + i * 2] = highByte(*int_input[position]);
-				buffer[10 + i * 2] = lowByte(*int_input[position]);
-			}
-			else
-			{
-				buffer[ 9 + i * 2] = 0;
-				buffer[10 + i * 2] = 0;
-			}
-		}
-		else //invalid address
-		{
-			mb_error = ERR_ILLEGAL_DATA_ADDRESS;
-		}
-	}
-	pthread_mutex_unlock(&bufferLock);
+	IEC_UINT value = word(buffer[10], buffer[11]);
+	mb_error = WriteError(queueImageWrite(IMAGE_HOLDING_REGS, Start, 1, &value));
 
 	if (mb_error != ERR_NONE)
 	{
@@ -472,16 +365,18 @@ void ReadInputRegisters(unsigned char *buffer, int bufferSize)
 	}
 	else
 	{
-		MessageLength = ByteDataLength + 9;
+		buffer[4] = 0;
+		buffer[5] = 6; //Number of bytes after this one.
+		MessageLength = 12;
 	}
 }
 
 //-----------------------------------------------------------------------------
-// Implementation of Modbus/TCP Write Coil
+// Implementation of Modbus/TCP Write Multiple Coils
 //-----------------------------------------------------------------------------
-void WriteCoil(unsigned char *buffer, int bufferSize)
+void WriteMultipleCoils(unsigned char *buffer, int bufferSize)
 {
-	int Start;
+	int Start, ByteDataLength, CoilDataLength;
 	int mb_error = ERR_NONE;
 
 	//this request must have at least 12 bytes. If it doesn't, it's a corrupted message
@@ -491,32 +386,19 @@ void WriteCoil(unsigned char *buffer, int bufferSize)
 		return;
 	}
 
-	Start = word(buffer[8], buffer[9]);
+	Start = word(buffer[8],buffer[9]);
+	CoilDataLength = word(buffer[10],buffer[11]);
+	ByteDataLength = CoilDataLength / 8;
+	if(ByteDataLength * 8 < CoilDataLength) ByteDataLength++;
 
-	if (Start < MAX_COILS)
+	//this request must have all the bytes it wants to write. If it doesn't, it's a corrupted message
+	if ( (bufferSize < (13 + ByteDataLength)) || (buffer[12] != ByteDataLength) )
 	{
-		unsigned char value;
-		if (word(buffer[10], buffer[11]) > 0)
-		{
-			value = 1;
-		}
-		else
-		{
-			value = 0;
-		}
-
-		pthread_mutex_lock(&bufferLock);
-		if (bool_output[Start/8][Start%8] != NULL)
-		{
-			*bool_output[Start/8][Start%8] = value;
-		}
-		pthread_mutex_unlock(&bufferLock);
+		ModbusError(buffer, ERR_ILLEGAL_DATA_VALUE);
+		return;
 	}
 
-	else //invalid address
-	{
-		mb_error = ERR_ILLEGAL_DATA_ADDRESS;
-	}
+	mb_error = WriteError(queueImageBits(Start, CoilDataLength, &buffer[13]));
 
 	if (mb_error != ERR_NONE)
 	{
@@ -531,12 +413,13 @@ void WriteCoil(unsigned char *buffer, int bufferSize)
 }
 
 //-----------------------------------------------------------------------------
-// Implementation of Modbus/TCP Write Holding Register
+// Implementation of Modbus/TCP Write Multiple Registers
 //-----------------------------------------------------------------------------
-void WriteRegister(unsigned char *buffer, int bufferSize)
+void WriteMultipleRegisters(unsigned char *buffer, int bufferSize)
 {
-	int Start;
+	int Start, WordDataLength, ByteDataLength;
 	int mb_error = ERR_NONE;
+	IEC_UINT values[128];
 
 	//this request must have at least 12 bytes. If it doesn't, it's a corrupted message
 	if (bufferSize < 12)
@@ -546,86 +429,53 @@ void WriteRegister(unsigned char *buffer, int bufferSize)
 	}
 
 	Start = word(buffer[8],buffer[9]);
+	WordDataLength = word(buffer[10],buffer[11]);
+	ByteDataLength = WordDataLength * 2;
 
-	pthread_mutex_lock(&bufferLock);
-	//analog outputs
-	if (Start <= MIN_16B_RANGE)
+	//this request must have all the bytes it wants to write. If it doesn't, it's a corrupted message
+	if ( (bufferSize < (13 + ByteDataLength)) || (buffer[12] != ByteDataLength) )
 	{
-		if (int_output[Start] != NULL)
-		{
-			*int_output[Start] = word(buffer[10],buffer[11]);
-		}
+		ModbusError(buffer, ERR_ILLEGAL_DATA_VALUE);
+		return;
 	}
-	//accessing memory
-	//16-bit registers
-	else if (Start >= MIN_16B_RANGE && Start <= MAX_16B_RANGE)
+
+	for(int i = 0; i < WordDataLength; i++)
 	{
-		if (int_memory[Start - MIN_16B_RANGE] != NULL)
-		{
-			*int_memory[Start - MIN_16B_RANGE] = word(buffer[10],buffer[11]);
-		}
+		values[i] = word(buffer[13 + i * 2], buffer[14 + i * 2]);
 	}
-	//32-bit registers
-	else if (Start >= MIN_32B_RANGE && Start <= MAX_32B_RANGE)
+	mb_error = WriteError(queueImageWrite(IMAGE_HOLDING_REGS, Start, WordDataLength, values));
+
+	if (mb_error != ERR_NONE)
 	{
-		if (dint_memory[(Start - MIN_32B_RANGE)/2] != NULL)
-		{
-			uint32_t tempValue = (uint32_t)word(buffer[10],buffer[11]);
-
-			if ((Start - MIN_32B_RANGE) % 2 == 0) //first word
-			{
-				*dint_memory[(Start - MIN_32B_RANGE) / 2] = *dint_memory[(Start - MIN_32B_RANGE) / 2] & 0x0000ffff;
-				*dint_memory[(Start - MIN_32B_RANGE) / 2] = *dint_memory[(Start - MIN_32B_RANGE) / 2] | (tempValue << 16);
-			}
-			else //second word
-			{
-				*dint_memory[(Start - MIN_32B_RANGE) / 2] = *dint_memory[(Start - MIN_32B_RANGE) / 2] & 0xffff0000;
-				*dint_memory[(Start - MIN_32B_RANGE) / 2] = *dint_memory[(Start - MIN_32B_RANGE) / 2] | tempValue;
-			}
-		}
-		else
-		{
-			mb_holding_regs[Start] = word(buffer[10],buffer[11]);
-		}
+		ModbusError(buffer, mb_error);
 	}
-	//64-bit registers
-	else if (Start >= MIN_64B_RANGE && Start <= MAX_64B_RANGE)
+	else
 	{
-		if (lint_memory[(Start - MIN_64B_RANGE)/4] != NULL)
-		{
-			uint64_t tempValue = (uint64_t)word(buffer[10],buffer[11]);
-
-			if ((Start - MIN_64B_RANGE) % 4 == 0) //first word
-			{
-				*lint_memory[(Start - MIN_64B_RANGE) / 4] = *lint_memory[(Start - MIN_64B_RANGE) / 4] & 0x0000ffffffffffff;
-				*lint_memory[(Start - MIN_64B_RANGE) / 4] = *lint_memory[(Start - MIN_64B_RANGE) / 4] | (tempValue << 48);
-			}
-			else if ((Start - MIN_64B_RANGE) % 4 == 1) //second word
-			{
-				*lint_memory[(Start - MIN_64B_RANGE) / 4] = *lint_memory[(Start - MIN_64B_RANGE) / 4] & 0xffff0000ffffffff;
-				*lint_memory[(Start - MIN_64B_RANGE) / 4] = *lint_memory[(Start - MIN_64B_RANGE) / 4] | (tempValue << 32);
-			}
-			else if ((Start - MIN_64B_RANGE) % 4 == 2) //third word
-			{
-				*lint_memory[(Start - MIN_64B_RANGE) / 4] = *lint_memory[(Start - MIN_64B_RANGE) / 4] & 0xffffffff0000ffff;
-				*lint_memory[(Start - MIN_64B_RANGE) / 4] = *lint_memory[(Start - MIN_64B_RANGE) / 4] | (tempValue << 16);
-			}
-			else if ((Start - MIN_64B_RANGE) % 4 == 3) //fourth word
-			{
-				*lint_memory[(Start - MIN_64B_RANGE) / 4] = *lint_memory[(Start - MIN_64B_RANGE) / 4] & 0xffffffffffff0000;
-				*lint_memory[(Start - MIN_64B_RANGE) / 4] = *lint_memory[(Start - MIN_64B_RANGE) / 4] | tempValue;
-			}
-		}
-		else
-		{
-			mb_holding_regs[Start] = word(buffer[10],buffer[11]);
-		}
+		buffer[4] = 0;
+		buffer[5] = 6; //Number of bytes after this one.
+		MessageLength = 12;
 	}
-	else //invalid address
+}
+
+//-----------------------------------------------------------------------------
+// Implementation of Modbus/TCP Mask Write Register. The mask is applied by the
+// scan thread, so nothing can change the register between the read and the
+// write
+//-----------------------------------------------------------------------------
+void MaskWriteRegister(unsigned char *buffer, int bufferSize)
+{
+	int Start;
+	int mb_error = ERR_NONE;
+
+	//this request must have 14 bytes. If it doesn't, it's a corrupted message
+	if (bufferSize < 14)
 	{
-		mb_error = ERR_ILLEGAL_DATA_ADDRESS;
+		ModbusError(buffer, ERR_ILLEGAL_DATA_VALUE);
+		return;
 	}
-	pthread_mutex_unlock(&bufferLock);
+
+	Start = word(buffer[8], buffer[9]);
+	mb_error = WriteError(queueImageMask(Start, word(buffer[10], buffer[11]), word(buffer[12], buffer[13])));
 
 	if (mb_error != ERR_NONE)
 	{
@@ -633,187 +483,151 @@ void WriteRegister(unsigned char *buffer, int bufferSize)
 	}
 	else
 	{
+		//the response is the echo of the request
 		buffer[4] = 0;
-		buffer[5] = 6; //Number of bytes after this one.
-		MessageLength = 12;
+		buffer[5] = 8; //Number of bytes after this one.
+		MessageLength = 14;
 	}
 }
 
 //-----------------------------------------------------------------------------
-// Implementation of Modbus/TCP Write Multiple Coils
+// Implementation of Modbus/TCP Read/Write Multiple Registers. The write is
+// queued for the next scan and the read comes from the current snapshot with
+// the written values laid over it, so the client sees the result of its own
+// write as the spec requires and both happen against the same image
 //-----------------------------------------------------------------------------
-void WriteMultipleCoils(unsigned char *buffer, int bufferSize)
+void ReadWriteMultipleRegisters(unsigned char *buffer, int bufferSize)
 {
-	int Start, ByteDataLength, CoilDataLength;
+	int ReadStart, ReadLength, WriteStart, WriteLength, ByteDataLength;
 	int mb_error = ERR_NONE;
+	IEC_UINT values[128];
 
-	//this request must have at least 12 bytes. If it doesn't, it's a corrupted message
-	if (bufferSize < 12)
+	//this request must have at least 17 bytes. If it doesn't, it's a corrupted message
+	if (bufferSize < 17)
 	{
 		ModbusError(buffer, ERR_ILLEGAL_DATA_VALUE);
 		return;
 	}
 
-	Start = word(buffer[8],buffer[9]);
-	CoilDataLength = word(buffer[10],buffer[11]);
-	ByteDataLength = CoilDataLength / 8;
-	if(ByteDataLength * 8 < CoilDataLength) ByteDataLength++;
+	ReadStart = word(buffer[8], buffer[9]);
+	ReadLength = word(buffer[10], buffer[11]);
+	WriteStart = word(buffer[12], buffer[13]);
+	WriteLength = word(buffer[14], buffer[15]);
+	ByteDataLength = WriteLength * 2;
 
-	//this request must have all the bytes it wants to write. If it doesn't, it's a corrupted message
-	if ( (bufferSize < (13 + ByteDataLength)) || (buffer[12] != ByteDataLength) )
+	//quantities allowed by the spec, and all the bytes to write must be there
+	if (ReadLength < 1 || ReadLength > 125 || WriteLength < 1 || WriteLength > 121 ||
+		buffer[16] != ByteDataLength || bufferSize < (17 + ByteDataLength))
 	{
 		ModbusError(buffer, ERR_ILLEGAL_DATA_VALUE);
 		return;
 	}
 
-	//preparing response
-	buffer[4] = 0;
-	buffer[5] = 6; //Number of bytes after this one.
+	if (ReadStart + ReadLength > MAX_HOLD_REGS)
+	{
+		ModbusError(buffer, ERR_ILLEGAL_DATA_ADDRESS);
+		return;
+	}
 
-	pthread_mutex_lock(&bufferLock);
-	for(int i = 0; i < ByteDataLength ; i++)
+	//the response overwrites the request, keep the values to write
+	for(int i = 0; i < WriteLength; i++)
 	{
-		for(int j = 0; j < 8; j++)
-		{
-			int position = Start + i * 8 + j;
-			if (position < MAX_COILS)
-			{
-				if (bool_output[position/8][position%8] != NULL) *bool_output[position/8][position%8] = bitRead(buffer[13 + i], j);
-			}
-			else //invalid address
-			{
-				mb_error = ERR_ILLEGAL_DATA_ADDRESS;
-			}
-		}
+		values[i] = word(buffer[17 + i * 2], buffer[18 + i * 2]);
 	}
-	pthread_mutex_unlock(&bufferLock);
 
+	mb_error = WriteError(queueImageWrite(IMAGE_HOLDING_REGS, WriteStart, WriteLength, values));
 	if (mb_error != ERR_NONE)
 	{
 		ModbusError(buffer, mb_error);
+		return;
 	}
-	else
+
+	readImageRegisters(IMAGE_HOLDING_REGS, ReadStart, ReadLength, &buffer[9]);
+	for(int i = 0; i < WriteLength; i++)
 	{
-		MessageLength = 12;
+		int position = WriteStart + i - ReadStart;
+		if (position >= 0 && position < ReadLength)
+		{
+			buffer[ 9 + position * 2] = highByte(values[i]);
+			buffer[10 + position * 2] = lowByte(values[i]);
+		}
 	}
+
+	//preparing response
+	buffer[4] = highByte(ReadLength * 2 + 3);
+	buffer[5] = lowByte(ReadLength * 2 + 3); //Number of bytes after this one
+	buffer[8] = ReadLength * 2;     //Number of bytes of data
+
+	MessageLength = ReadLength * 2 + 9;
 }
 
 //-----------------------------------------------------------------------------
-// Implementation of Modbus/TCP Write Multiple Registers
+// Implementation of Modbus/TCP Read Device Identification (FC 43, MEI 14).
+// All the objects fit in one response, so there is never a "more follows"
 //-----------------------------------------------------------------------------
-void WriteMultipleRegisters(unsigned char *buffer, int bufferSize)
+void ReadDeviceIdentification(unsigned char *buffer, int bufferSize)
 {
-	int Start, WordDataLength, ByteDataLength;
-	int mb_error = ERR_NONE;
+	int ReadCode, ObjectId, LastObject, ObjectCount;
 
-	//this request must have at least 12 bytes. If it doesn't, it's a corrupted message
-	if (bufferSize < 12)
+	//this request must have 11 bytes. If it doesn't, it's a corrupted message
+	if (bufferSize < 11)
 	{
 		ModbusError(buffer, ERR_ILLEGAL_DATA_VALUE);
 		return;
 	}
 
-	Start = word(buffer[8],buffer[9]);
-	WordDataLength = word(buffer[10],buffer[11]);
-	ByteDataLength = WordDataLength * 2;
-
-	//this request must have all the bytes it wants to write. If it doesn't, it's a corrupted message
-	if ( (bufferSize < (13 + ByteDataLength)) || (buffer[12] != ByteDataLength) )
+	if (buffer[8] != MEI_READ_DEVICE_ID)
 	{
-		ModbusError(buffer, ERR_ILLEGAL_DATA_VALUE);
+		ModbusError(buffer, ERR_ILLEGAL_FUNCTION);
 		return;
 	}
 
-	//preparing response
-	buffer[4] = 0;
-	buffer[5] = 6; //Number of bytes after this one.
+	ReadCode = buffer[9];
+	ObjectId = buffer[10];
 
-	pthread_mutex_lock(&bufferLock);
-	for(int i = 0; i < WordDataLength; i++)
+	switch (ReadCode)
 	{
-		int position = Start + i;
-		//analog outputs
-		if (position <= MIN_16B_RANGE)
-		{
-			if (int_output[position] != NULL) *int_output[position] =  word(buffer[13 + i * 2], buffer[14 + i * 2]);
-		}
-		//accessing memory
-		//16-bit registers
-		else if (position >= MIN_16B_RANGE && position <= MAX_16B_RANGE)
-		{
-			if (int_memory[position - MIN_16B_RANGE] != NULL) *int_memory[position - MIN_16B_RANGE] = word(buffer[13 + i * 2], buffer[14 + i * 2]);
-		}
-		//32-bit registers
-		else if (position >= MIN_32B_RANGE && position <= MAX_32B_RANGE)
-		{
-			if (dint_memory[(Start - MIN_32B_RANGE)/2] != NULL)
-			{
-				uint32_t tempValue = (uint32_t)word(buffer[13 + i * 2], buffer[14 + i * 2]);
-
-				if ((position - MIN_32B_RANGE) % 2 == 0) //first word
-				{
-					*dint_memory[(position - MIN_32B_RANGE) / 2] = *dint_memory[(position - MIN_32B_RANGE) / 2] & 0x0000ffff;
-					*dint_memory[(position - MIN_32B_RANGE) / 2] = *dint_memory[(position - MIN_32B_RANGE) / 2] | (tempValue << 16);
-				}
-				else //second word
-				{
-					*dint_memory[(position - MIN_32B_RANGE) / 2] = *dint_memory[(position - MIN_32B_RANGE) / 2] & 0xffff0000;
-					*dint_memory[(position - MIN_32B_RANGE) / 2] = *dint_memory[(position - MIN_32B_RANGE) / 2] | tempValue;
-				}
-			}
-			else
-			{
-				mb_holding_regs[position] = word(buffer[13 + i * 2], buffer[14 + i * 2]);
-			}
-		}
-		//64-bit registers
-		else if (position >= MIN_64B_RANGE && position <= MAX_64B_RANGE)
-		{
-			if (lint_memory[(position - MIN_64B_RANGE)/4] != NULL)
-			{
-				uint64_t tempValue = (uint64_t)word(buffer[13 + i * 2], buffer[14 + i * 2]);
-
-				if ((position - MIN_64B_RANGE) % 4 == 0) //first word
-				{
-					*lint_memory[(position - MIN_64B_RANGE) / 4] = *lint_memory[(position - MIN_64B_RANGE) / 4] & 0x0000ffffffffffff;
-					*lint_memory[(position - MIN_64B_RANGE) / 4] = *lint_memory[(position - MIN_64B_RANGE) / 4] | (tempValue << 48);
-				}
-				else if ((Start - MIN_64B_RANGE) % 4 == 1) //second word
-				{
-					*lint_memory[(position - MIN_64B_RANGE) / 4] = *lint_memory[(position - MIN_64B_RANGE) / 4] & 0xffff0000ffffffff;
-					*lint_memory[(position - MIN_64B_RANGE) / 4] = *lint_memory[(position - MIN_64B_RANGE) / 4] | (tempValue << 32);
-				}
-				else if ((Start - MIN_64B_RANGE) % 4 == 2) //third word
-				{
-					*lint_memory[(position - MIN_64B_RANGE) / 4] = *lint_memory[(position - MIN_64B_RANGE) / 4] & 0xffffffff0000ffff;
-					*lint_memory[(position - MIN_64B_RANGE) / 4] = *lint_memory[(position - MIN_64B_RANGE) / 4] | (tempValue << 16);
-				}
-				else if ((Start - MIN_64B_RANGE) % 4 == 3) //fourth word
-				{
-					*lint_memory[(position - MIN_64B_RANGE) / 4] = *lint_memory[(position - MIN_64B_RANGE) / 4] & 0xffffffffffff0000;
-					*lint_memory[(position - MIN_64B_RANGE) / 4] = *lint_memory[(position - MIN_64B_RANGE) / 4] | tempValue;
-				}
-			}
-			else
-			{
-				mb_holding_regs[Start] = word(buffer[10],buffer[11]);
-			}
-		}
-		else //invalid address
-		{
-			mb_error = ERR_ILLEGAL_DATA_ADDRESS;
-		}
+		case DEVICE_ID_BASIC:		LastObject = DEVICE_ID_BASIC_OBJECTS - 1;	break;
+		case DEVICE_ID_REGULAR:
+		case DEVICE_ID_EXTENDED:	LastObject = DEVICE_ID_OBJECTS - 1;			break;
+		case DEVICE_ID_SPECIFIC:	LastObject = ObjectId;						break;
+		default:
+			ModbusError(buffer, ERR_ILLEGAL_DATA_VALUE);
+			return;
 	}
-	pthread_mutex_unlock(&bufferLock);
 
-	if (mb_error != ERR_NONE)
+	if (ObjectId >= DEVICE_ID_OBJECTS || ObjectId > LastObject)
 	{
-		ModbusError(buffer, mb_error);
+		//an unknown object is an error only when it is asked for directly,
+		//the stream access starts from the beginning instead
+		if (ReadCode == DEVICE_ID_SPECIFIC)
+		{
+			ModbusError(buffer, ERR_ILLEGAL_DATA_ADDRESS);
+			return;
+		}
+		ObjectId = 0;
 	}
-	else
+
+	int position = 14;
+	ObjectCount = 0;
+	for (int id = ObjectId; id <= LastObject; id++)
 	{
-		MessageLength = 12;
+		int length = strlen(device_id_objects[id]);
+		buffer[position++] = id;
+		buffer[position++] = length;
+		memcpy(&buffer[position], device_id_objects[id], length);
+		position += length;
+		ObjectCount++;
 	}
+
+	buffer[10] = DEVICE_ID_CONFORMITY;
+	buffer[11] = 0; //more follows
+	buffer[12] = 0; //next object id
+	buffer[13] = ObjectCount;
+
+	buffer[4] = highByte(position - 6);
+	buffer[5] = lowByte(position - 6); //Number of bytes after this one
+	MessageLength = position;
 }
 
 //-----------------------------------------------------------------------------
@@ -879,6 +693,24 @@ int processModbusMessage(unsigned char *buffer, int bufferSize)
 		WriteMultipleRegisters(buffer, bufferSize);
 	}
 
+	//****************** Mask Write Register ******************
+	else if(buffer[7] == MB_FC_MASK_WRITE_REGISTER)
+	{
+		MaskWriteRegister(buffer, bufferSize);
+	}
+
+	//*********** Read/Write Multiple Registers ***********
+	else if(buffer[7] == MB_FC_READ_WRITE_MULTIPLE_REGISTERS)
+	{
+		ReadWriteMultipleRegisters(buffer, bufferSize);
+	}
+
+	//************ Read Device Identification ************
+	else if(buffer[7] == MB_FC_ENCAPSULATED_INTERFACE)
+	{
+		ReadDeviceIdentification(buffer, bufferSize);
+	}
+
 	//****************** Function Code Error ******************
 	else
 	{
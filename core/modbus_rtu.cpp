@@ -0,0 +1,322 @@
+//-----------------------------------------------------------------------------
+// Copyright 2019 Novasom Industries
+//
+// Based on the software by Thiago Alves
+// This file is part of the OpenPLC Software Stack.
+//
+// OpenPLC is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenPLC is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenPLC.  If not, see <http://www.gnu.org/licenses/>.
+//------
+//
+// This is the Modbus RTU slave of the OpenPLC. It listens on a serial port
+// (or a pty), detects the end of each frame by the 3.5 character silence,
+// checks the CRC and hands the request to processModbusMessage(), the same
+// register logic used by the Modbus/TCP server. The frame is wrapped in a
+// dummy MBAP header for that, and unwrapped again for the response.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+
+#include "ladder.h"
+
+#define RTU_MAX_FRAME			256
+#define RTU_BUFFER_SIZE			264 //longest response built by modbus.cpp (9 + 255 bytes)
+#define RTU_BROADCAST			0
+
+//defaults, can be changed in novaplc.cfg
+#define DEFAULT_RTU_BAUD		19200
+#define DEFAULT_RTU_SLAVE_ID	1
+
+static uint16_t crc_table[8][256];
+
+//-----------------------------------------------------------------------------
+// Builds the lookup tables for the CRC16 (polynomial 0xA001, reflected).
+// crc_table[0] is the classic byte table, crc_table[k] advances a byte
+// through k more zero bytes so 8 bytes can be folded per step
+//-----------------------------------------------------------------------------
+static void initCrcTables()
+{
+	for (int i = 0; i < 256; i++)
+	{
+		uint16_t crc = i;
+		for (int j = 0; j < 8; j++)
+			crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+		crc_table[0][i] = crc;
+	}
+
+	for (int i = 0; i < 256; i++)
+	{
+		for (int k = 1; k < 8; k++)
+			crc_table[k][i] = (crc_table[k - 1][i] >> 8) ^ crc_table[0][crc_table[k - 1][i] & 0xff];
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Modbus CRC16 of the buffer, slicing by 8 bytes
+//-----------------------------------------------------------------------------
+uint16_t modbusCrc16(const unsigned char *data, int length)
+{
+	uint16_t crc = 0xFFFF;
+
+	while (length >= 8)
+	{
+		crc = crc_table[7][(data[0] ^ crc) & 0xff] ^ crc_table[6][(data[1] ^ (crc >> 8)) & 0xff] ^
+			crc_table[5][data[2]] ^ crc_table[4][data[3]] ^ crc_table[3][data[4]] ^
+			crc_table[2][data[5]] ^ crc_table[1][data[6]] ^ crc_table[0][data[7]];
+		data += 8;
+		length -= 8;
+	}
+
+	while (length-- > 0)
+	{
+		crc = (crc >> 8) ^ crc_table[0][(crc ^ *data++) & 0xff];
+	}
+
+	return crc;
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - termios constant for a baud rate
+//-----------------------------------------------------------------------------
+static speed_t baudConstant(int baud)
+{
+	switch (baud)
+	{
+		case 1200:		return B1200;
+		case 2400:		return B2400;
+		case 4800:		return B4800;
+		case 9600:		return B9600;
+		case 19200:		return B19200;
+		case 38400:		return B38400;
+		case 57600:		return B57600;
+		case 115200:	return B115200;
+		case 230400:	return B230400;
+	}
+
+	printf("WARNING: RTU: unsupported baud rate %d, using %d\n", baud, DEFAULT_RTU_BAUD);
+	return B19200;
+}
+
+//-----------------------------------------------------------------------------
+// Opens and configures the serial port. Returns the file descriptor, or -1
+//-----------------------------------------------------------------------------
+static int openSerialPort(const char *device, int baud, char parity, int data_bits, int stop_bits, bool rs485)
+{
+	struct termios tty;
+
+	int fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (fd < 0)
+	{
+		printf("RTU: could not open %s: %s\n", device, strerror(errno));
+		return -1;
+	}
+
+	if (tcgetattr(fd, &tty) != 0)
+	{
+		printf("RTU: %s is not a serial port\n", device);
+		close(fd);
+		return -1;
+	}
+
+	cfmakeraw(&tty);
+	cfsetispeed(&tty, baudConstant(baud));
+	cfsetospeed(&tty, baudConstant(baud));
+
+	tty.c_cflag |= CLOCAL | CREAD;
+	tty.c_cflag &= ~CSIZE;
+	switch (data_bits)
+	{
+		case 5:		tty.c_cflag |= CS5;	break;
+		case 6:		tty.c_cflag |= CS6;	break;
+		case 7:		tty.c_cflag |= CS7;	break;
+		default:	tty.c_cflag |= CS8;	break;
+	}
+
+	tty.c_cflag &= ~(PARENB | PARODD);
+	if (parity == 'E') tty.c_cflag |= PARENB;
+	if (parity == 'O') tty.c_cflag |= PARENB | PARODD;
+
+	if (stop_bits == 2) tty.c_cflag |= CSTOPB;
+	else tty.c_cflag &= ~CSTOPB;
+
+	tty.c_cc[VMIN] = 0;
+	tty.c_cc[VTIME] = 0;
+
+	if (tcsetattr(fd, TCSANOW, &tty) != 0)
+	{
+		printf("WARNING: RTU: could not configure %s\n", device);
+	}
+	tcflush(fd, TCIOFLUSH);
+
+	//let the UART driver switch the RS-485 transceiver around each reply
+	if (rs485)
+	{
+		struct serial_rs485 rs485conf;
+		memset(&rs485conf, 0, sizeof(rs485conf));
+		rs485conf.flags = SER_RS485_ENABLED | SER_RS485_RTS_ON_SEND;
+		if (ioctl(fd, TIOCSRS485, &rs485conf) < 0)
+			printf("WARNING: RTU: could not enable RS-485 mode on %s\n", device);
+	}
+
+	return fd;
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Difference in nanoseconds between two timestamps
+//-----------------------------------------------------------------------------
+static inline long long elapsedNs(struct timespec *end, struct timespec *start)
+{
+	return (long long)(end->tv_sec - start->tv_sec) * 1000000000LL + (end->tv_nsec - start->tv_nsec);
+}
+
+//-----------------------------------------------------------------------------
+// Answers a complete frame. The RTU frame (address, PDU) is placed after a
+// dummy MBAP header so processModbusMessage() can handle it
+//-----------------------------------------------------------------------------
+static void processRtuFrame(int fd, unsigned char *frame, int length, int slave_id)
+{
+	unsigned char buffer[6 + RTU_BUFFER_SIZE];
+
+	if (length < 4)
+		return;
+
+	if (modbusCrc16(frame, length - 2) != (frame[length - 2] | (frame[length - 1] << 8)))
+		return;
+
+	int address = frame[0];
+	if (address != slave_id && address != RTU_BROADCAST)
+		return;
+
+	memset(buffer, 0, 6);
+	buffer[4] = (length - 2) >> 8;
+	buffer[5] = (length - 2) & 0xff;
+	memcpy(&buffer[6], frame, length - 2);
+
+	int responseSize = processModbusMessage(buffer, length + 4) - 6;
+
+	//a broadcast is executed but never answered
+	if (address == RTU_BROADCAST || responseSize <= 0)
+		return;
+
+	unsigned char *response = &buffer[6];
+	uint16_t crc = modbusCrc16(response, responseSize);
+	response[responseSize++] = crc & 0xff;
+	response[responseSize++] = crc >> 8;
+
+	if (write(fd, response, responseSize) != responseSize)
+	{
+		printf("RTU: error writing the response\n");
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Thread running the Modbus RTU slave. Returns only if the port can't be
+// opened
+//-----------------------------------------------------------------------------
+void *modbusRtuThread(void *arg)
+{
+	const char *device = configString("rtu.device", "");
+	int baud = configInt("rtu.baud_rate", DEFAULT_RTU_BAUD);
+	const char *parity = configString("rtu.parity", "N");
+	int data_bits = configInt("rtu.data_bits", 8);
+	int stop_bits = configInt("rtu.stop_bits", 1);
+	int slave_id = configInt("rtu.slave_id", DEFAULT_RTU_SLAVE_ID);
+	bool rs485 = configInt("rtu.rs485", 0) != 0;
+
+	initCrcTables();
+
+	int fd = openSerialPort(device, baud, parity[0], data_bits, stop_bits, rs485);
+	if (fd < 0)
+		return NULL;
+
+	//a frame ends after 3.5 characters of silence (11 bits each). Above
+	//19200 baud the spec fixes it at 1.75 ms
+	long long silence_ns = baud > 19200 ? 1750000LL : 3500000000LL * 11 / baud;
+
+	printf("RTU: slave %d on %s at %d baud, %d%c%d\n", slave_id, device, baud, data_bits, parity[0], stop_bits);
+
+	unsigned char frame[RTU_MAX_FRAME];
+	int length = 0;
+	bool overflow = false;
+	struct timespec last_byte, now;
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+
+	while (1)
+	{
+		struct timespec timeout, *wait = NULL;
+
+		//while a frame is coming in, wait only until the silence is over
+		if (length > 0 || overflow)
+		{
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			long long left = silence_ns - elapsedNs(&now, &last_byte);
+			if (left < 0) left = 0;
+			timeout.tv_sec = left / 1000000000LL;
+			timeout.tv_nsec = left % 1000000000LL;
+			wait = &timeout;
+		}
+
+		int ret = ppoll(&pfd, 1, wait, NULL);
+		if (ret < 0)
+		{
+			if (errno == EINTR) continue;
+			printf("RTU: error waiting on %s\n", device);
+			sleep_thread(100);
+			continue;
+		}
+
+		if (ret == 0)
+		{
+			//silence: the frame is complete
+			if (!overflow)
+				processRtuFrame(fd, frame, length, slave_id);
+			length = 0;
+			overflow = false;
+			continue;
+		}
+
+		unsigned char chunk[RTU_MAX_FRAME];
+		int n = read(fd, chunk, sizeof(chunk));
+		if (n <= 0)
+		{
+			//the other end of a pty went away, wait for it to come back
+			if (n == 0 || (errno != EAGAIN && errno != EINTR))
+				sleep_thread(100);
+			continue;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &last_byte);
+
+		if (length + n > RTU_MAX_FRAME)
+		{
+			//too long to be a Modbus frame, drop it once the line is silent
+			overflow = true;
+			continue;
+		}
+		memcpy(&frame[length], chunk, n);
+		length += n;
+	}
+
+	return NULL;
+}
@@ -18,93 +18,575 @@
 //
 // This file is responsible for the persistent storage on the OpenPLC
 // Thiago Alves, Mar 2016
+//
+// The retained data is kept in a store made of two files:
+//   <file>          two snapshot slots, mapped in memory. Each slot holds a
+//                   full copy of the data with its generation and a CRC
+//   <file>.journal  records of the bytes changed since the last snapshot,
+//                   appended and synced, each with its own CRC
+// Only the changed bytes are written on every check. When the journal grows
+// past retain.compact_bytes the data is written to the older slot with the
+// next generation and the journal is emptied. At startup the newest valid
+// slot is loaded and the journal records of its generation are replayed up
+// to the first damaged one, so a power cut at any point loses at most the
+// last check.
+//
+// Two stores are kept: the holding registers in <file>, and the RETAIN
+// variables of the program in <file>.vars. The variables are taken with the
+// config_backup__() and config_restore__() functions generated by iec2c -O b,
+// which copy only the variables flagged RETAIN (FB instances included) one
+// after the other. The image starts with a signature of the sizes of those
+// variables, so the image of another program is not restored, followed by
+// __CURRENT_TIME: the timers keep absolute start times, so the clock of the
+// program is restored with them and a retained timer goes on from where it
+// was. A program built
+// with IEC_NO_FORCING has no flags in its variables, so the addresses of the
+// RETAIN ones are kept here, in a hash set filled by config_init__().
 //-----------------------------------------------------------------------------
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include <time.h>
 #include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
+#include "iec_types.h"
 #include "ladder.h"
 
+#define RETAIN_MAGIC				0x4E525431 //"NRT1"
+#define JOURNAL_MAGIC				0x4E524A31 //"NRJ1"
+#define RETAIN_PAGE					4096
+#define RETAIN_MERGE_GAP			16 //changes closer than this go in one record
+
+//defaults, can be changed in novaplc.cfg
+#define DEFAULT_RETAIN_INTERVAL		1000
+#define DEFAULT_RETAIN_COMPACT		65536
+
+struct retain_slot
+{
+	uint32_t magic;
+	uint32_t generation;
+	uint32_t length;
+	uint32_t crc; //of the three fields above and of the data
+};
+
+struct journal_record
+{
+	uint32_t magic;
+	uint32_t generation; //of the snapshot the record applies to
+	uint32_t offset;
+	uint32_t length;
+	//followed by the data and by the CRC of the header and of the data
+};
+
+static uint32_t crc32_table[256];
+
+//holding registers retained by persistentStorage()
+static struct retain_store register_store;
+
+//RETAIN variables of the program: signature and clock followed by the values
+#define VARS_HEADER_SIZE			(sizeof(uint32_t) + sizeof(IEC_TIME))
+
+extern IEC_TIME __CURRENT_TIME; //glueVars.cpp
+
+static struct retain_store variable_store;
+static unsigned char *variable_image = NULL;
+static int variable_size = 0;
+static uint32_t variable_layout = 0;
+
+#ifdef IEC_NO_FORCING
+//addresses of the RETAIN variables, open addressing with a power of 2 slots
+static void **retained_vars = NULL;
+static size_t retained_slots = 0;
+static size_t retained_count = 0;
+#endif
+
 //-----------------------------------------------------------------------------
-// Main function for the thread. Should create a buffer for the persistent
-// data, compare it with the actual data and write back to the persistent
-// file if the data has changed
+// Helper function - CRC32 (polynomial 0xEDB88320) of a buffer, continuing
+// from the crc of the previous part (0 for the first one)
 //-----------------------------------------------------------------------------
-void *persistentStorage(void *args)
+static uint32_t crc32Update(uint32_t crc, const void *buffer, size_t length)
 {
-	IEC_INT persistentBuffer[BUFFER_SIZE];
+	const unsigned char *data = (const unsigned char *)buffer;
 
-	pthread_mutex_lock(&bufferLock); //lock mutex
-	for (int i = 0; i < BUFFER_SIZE; i++)
+	if (crc32_table[1] == 0)
 	{
-		if (int_output[i] != NULL) persistentBuffer[i] = *int_output[i];
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t c = i;
+			for (int j = 0; j < 8; j++)
+				c = (c & 1) ? (c >> 1) ^ 0xEDB88320 : c >> 1;
+			crc32_table[i] = c;
+		}
 	}
-	pthread_mutex_unlock(&bufferLock); //unlock mutex
 
-	while (1)
+	crc = ~crc;
+	while (length-- > 0)
+	{
+		crc = (crc >> 8) ^ crc32_table[(crc ^ *data++) & 0xff];
+	}
+
+	return ~crc;
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Checks a snapshot slot. Returns true if it holds valid
+// data of the expected length
+//-----------------------------------------------------------------------------
+static bool slotValid(struct retain_slot *slot, int length)
+{
+	if (slot->magic != RETAIN_MAGIC || slot->length != (uint32_t)length)
+		return false;
+
+	uint32_t crc = crc32Update(0, slot, offsetof(struct retain_slot, crc));
+	return crc32Update(crc, slot + 1, length) == slot->crc;
+}
+
+//-----------------------------------------------------------------------------
+// Replays the journal records of the current generation. A damaged or torn
+// record ends the journal, which is cut there. Returns the number of records
+// applied
+//-----------------------------------------------------------------------------
+static int replayJournal(struct retain_store *store)
+{
+	struct stat st;
+	if (fstat(store->journal_fd, &st) != 0 || st.st_size == 0)
+		return 0;
+
+	unsigned char *journal = (unsigned char *)malloc(st.st_size);
+	if (journal == NULL || pread(store->journal_fd, journal, st.st_size, 0) != st.st_size)
+	{
+		free(journal);
+		return 0;
+	}
+
+	int records = 0;
+	long position = 0;
+	while (position + (long)(sizeof(struct journal_record) + sizeof(uint32_t)) <= st.st_size)
+	{
+		struct journal_record *record = (struct journal_record *)&journal[position];
+		long size = sizeof(struct journal_record) + record->length + sizeof(uint32_t);
+
+		if (record->magic != JOURNAL_MAGIC || record->generation != store->generation ||
+			record->offset > (uint32_t)store->length || record->length > (uint32_t)store->length - record->offset ||
+			position + size > st.st_size)
+			break;
+
+		uint32_t crc;
+		memcpy(&crc, &journal[position + size - sizeof(uint32_t)], sizeof(crc));
+		if (crc32Update(0, record, size - sizeof(uint32_t)) != crc)
+			break;
+
+		memcpy(&store->data[record->offset], record + 1, record->length);
+		position += size;
+		records++;
+	}
+	free(journal);
+
+	if (position < st.st_size)
 	{
-		//printf("checking data...\n");
-		bool bufferOutdated = false;
+		printf("Retain: dropping %ld bytes at the end of the journal\n", (long)st.st_size - position);
+		if (ftruncate(store->journal_fd, position) != 0)
+			printf("Retain: could not cut the journal\n");
+	}
+	store->journal_bytes = position;
+
+	return records;
+}
+
+//-----------------------------------------------------------------------------
+// Opens (or creates) a store for length bytes and recovers the data kept in
+// it into store->data. Returns 1 if data was recovered, 0 if the store is new
+// or holds nothing valid, -1 if the store can't be used
+//-----------------------------------------------------------------------------
+int retainOpen(struct retain_store *store, const char *path, int length)
+{
+	struct timespec start, end;
+	char journal_path[256];
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	memset(store, 0, sizeof(struct retain_store));
+	store->length = length;
+	store->slot_size = (sizeof(struct retain_slot) + length + RETAIN_PAGE - 1) / RETAIN_PAGE * RETAIN_PAGE;
+	store->compact_bytes = configInt("retain.compact_bytes", DEFAULT_RETAIN_COMPACT);
+	store->journal_fd = -1;
 
-		pthread_mutex_lock(&bufferLock); //lock mutex
-		for (int i = 0; i < BUFFER_SIZE; i++)
+	store->data = (unsigned char *)calloc(1, length);
+	store->records = (unsigned char *)malloc(4 * length + 64);
+	if (store->data == NULL || store->records == NULL)
+		return -1;
+
+	int fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+	{
+		printf("Retain: could not open %s\n", path);
+		return -1;
+	}
+
+	//a store of another size belongs to another program, start over
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size != (off_t)(2 * store->slot_size))
+	{
+		if (st.st_size != 0)
+			printf("WARNING: Retain: %s was made for another program, starting empty\n", path);
+		if (ftruncate(fd, 0) != 0 || ftruncate(fd, 2 * store->slot_size) != 0)
 		{
-			if (int_output[i] != NULL)
-			{
-				if (persistentBuffer[i] != *int_output[i])
-				{
-					persistentBuffer[i] = *int_output[i];
-					bufferOutdated = true;
-				}
-			}
+			printf("Retain: could not size %s\n", path);
+			close(fd);
+			return -1;
+		}
+	}
+
+	store->map = (unsigned char *)mmap(NULL, 2 * store->slot_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (store->map == MAP_FAILED)
+	{
+		printf("Retain: could not map %s\n", path);
+		store->map = NULL;
+		return -1;
+	}
+
+	//the newest valid snapshot is the starting point
+	store->active = -1;
+	for (int i = 0; i < 2; i++)
+	{
+		struct retain_slot *slot = (struct retain_slot *)&store->map[i * store->slot_size];
+		if (slotValid(slot, length) && (store->active < 0 || slot->generation > store->generation))
+		{
+			store->active = i;
+			store->generation = slot->generation;
 		}
-		pthread_mutex_unlock(&bufferLock); //unlock mutex
+	}
+
+	bool snapshot = store->active >= 0;
+	if (snapshot)
+		memcpy(store->data, &store->map[store->active * store->slot_size + sizeof(struct retain_slot)], length);
+	else
+		store->active = 1; //the first snapshot goes in slot 0
+
+	snprintf(journal_path, sizeof(journal_path), "%s.journal", path);
+	store->journal_fd = open(journal_path, O_RDWR | O_APPEND | O_CREAT, 0644);
+	if (store->journal_fd < 0)
+	{
+		printf("Retain: could not open %s\n", journal_path);
+		return -1;
+	}
+
+	int records = replayJournal(store);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("Retain: %s, generation %u + %d journal records, loaded in %ld us\n", path, store->generation, records,
+		(end.tv_sec - start.tv_sec) * 1000000L + (end.tv_nsec - start.tv_nsec) / 1000);
+
+	return snapshot || records > 0 ? 1 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Writes the data to the older snapshot slot with the next generation and
+// empties the journal. A crash before the end leaves the other slot and the
+// journal valid
+//-----------------------------------------------------------------------------
+static void retainCompact(struct retain_store *store)
+{
+	int next = 1 - store->active;
+	struct retain_slot *slot = (struct retain_slot *)&store->map[next * store->slot_size];
+
+	slot->magic = RETAIN_MAGIC;
+	slot->generation = store->generation + 1;
+	slot->length = store->length;
+	memcpy(slot + 1, store->data, store->length);
+	slot->crc = crc32Update(crc32Update(0, slot, offsetof(struct retain_slot, crc)), slot + 1, store->length);
+
+	if (msync(slot, store->slot_size, MS_SYNC) != 0)
+	{
+		printf("Retain: error writing the snapshot\n");
+		return;
+	}
+
+	store->active = next;
+	store->generation++;
+	if (ftruncate(store->journal_fd, 0) != 0 || fdatasync(store->journal_fd) != 0)
+		printf("Retain: error emptying the journal\n");
+	store->journal_bytes = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Journals the bytes of data that differ from the data stored. Changes
+// closer than RETAIN_MERGE_GAP bytes are written in a single record
+//-----------------------------------------------------------------------------
+void retainUpdate(struct retain_store *store, const void *buffer)
+{
+	const unsigned char *data = (const unsigned char *)buffer;
+	int size = 0;
+	int i = 0;
+
+	if (store->journal_fd < 0)
+		return;
+
+	while (i < store->length)
+	{
+		//skip the unchanged part 8 bytes at a time
+		while (i + 8 <= store->length && memcmp(&data[i], &store->data[i], 8) == 0) i += 8;
+		while (i < store->length && data[i] == store->data[i]) i++;
+		if (i >= store->length)
+			break;
 
-		if (bufferOutdated)
+		//the record ends after RETAIN_MERGE_GAP unchanged bytes
+		int first = i, last = i, same = 0;
+		while (i < store->length && same < RETAIN_MERGE_GAP)
 		{
-			//printf("writing data to disk...\n");
-			FILE *fd = fopen("persistent.file", "w"); //if file already exists, it will be overwritten
-			if (fd == NULL)
+			if (data[i] != store->data[i])
 			{
-				printf("Error creating persistent memory file!\n");
-				return 0;
+				last = i;
+				same = 0;
 			}
-
-			if (fwrite(persistentBuffer, sizeof(IEC_INT), BUFFER_SIZE, fd) < BUFFER_SIZE)
+			else
 			{
-				printf("Error writing to persistent memory file!\n");
-				return 0;
+				same++;
 			}
-			fclose(fd);
+			i++;
 		}
 
-		sleep_thread(1000);
+		struct journal_record record;
+		record.magic = JOURNAL_MAGIC;
+		record.generation = store->generation;
+		record.offset = first;
+		record.length = last - first + 1;
+
+		unsigned char *out = &store->records[size];
+		memcpy(out, &record, sizeof(record));
+		memcpy(out + sizeof(record), &data[first], record.length);
+		uint32_t crc = crc32Update(0, out, sizeof(record) + record.length);
+		memcpy(out + sizeof(record) + record.length, &crc, sizeof(crc));
+		size += sizeof(record) + record.length + sizeof(crc);
 	}
+
+	if (size == 0)
+		return;
+
+	if (write(store->journal_fd, store->records, size) != size || fdatasync(store->journal_fd) != 0)
+	{
+		//cut what was written so the next records are not lost behind it
+		printf("Retain: error writing the journal\n");
+		if (ftruncate(store->journal_fd, store->journal_bytes) != 0)
+			printf("Retain: could not cut the journal\n");
+		return;
+	}
+
+	memcpy(store->data, data, store->length);
+	store->journal_bytes += size;
+
+	if (store->journal_bytes >= store->compact_bytes)
+		retainCompact(store);
 }
 
-int readPersistentStorage()
+#ifdef IEC_NO_FORCING
+//-----------------------------------------------------------------------------
+// Helper function - Slot of an address in a set of RETAIN variables: the slot
+// holding it, or the free slot where it goes
+//-----------------------------------------------------------------------------
+static size_t retainedSlot(void **table, size_t slots, void *varptr)
 {
-	FILE *fd = fopen("persistent.file", "r");
-	if (fd == NULL)
+	size_t i = (size_t)(((uint64_t)(uintptr_t)varptr * 0x9E3779B97F4A7C15ULL) >> 32) & (slots - 1);
+
+	while (table[i] != NULL && table[i] != varptr)
+		i = (i + 1) & (slots - 1);
+
+	return i;
+}
+
+//-----------------------------------------------------------------------------
+// Marks a variable as RETAIN. Called by config_init__() through
+// __INIT_RETAIN() (lib/accessor.h) before the threads are started
+//-----------------------------------------------------------------------------
+void __mark_retained(void *varptr)
+{
+	//kept at most half full
+	if (2 * (retained_count + 1) > retained_slots)
+	{
+		size_t slots = retained_slots > 0 ? retained_slots * 2 : 64;
+		void **table = (void **)calloc(slots, sizeof(void *));
+		if (table == NULL)
+		{
+			printf("WARNING: Out of memory, a RETAIN variable will not be retained\n");
+			return;
+		}
+
+		for (size_t i = 0; i < retained_slots; i++)
+		{
+			if (retained_vars[i] != NULL)
+				table[retainedSlot(table, slots, retained_vars[i])] = retained_vars[i];
+		}
+		free(retained_vars);
+		retained_vars = table;
+		retained_slots = slots;
+	}
+
+	size_t i = retainedSlot(retained_vars, retained_slots, varptr);
+	if (retained_vars[i] == NULL)
 	{
-		printf("Error openning persistent memory file, or file doesn't exists!\n");
+		retained_vars[i] = varptr;
+		retained_count++;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Returns 1 if the variable has been marked as RETAIN
+//-----------------------------------------------------------------------------
+int __is_retained(void *varptr)
+{
+	if (retained_slots == 0)
 		return 0;
+
+	return retained_vars[retainedSlot(retained_vars, retained_slots, varptr)] != NULL;
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// Helper function - Retain operation handed to config_retain__() that only
+// adds the size of every RETAIN variable to the signature of the program
+//-----------------------------------------------------------------------------
+static void layoutOp(void *varptr, int varsize, void **buffer, int *maxsize)
+{
+	variable_layout = crc32Update(variable_layout, &varsize, sizeof(varsize));
+	*maxsize -= varsize;
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Copies the RETAIN variables to the image. Must be called
+// with the mutex bufferLock held, so no task is running
+//-----------------------------------------------------------------------------
+static void backupVariables()
+{
+	void *buffer = variable_image + VARS_HEADER_SIZE;
+	int maxsize = variable_size - VARS_HEADER_SIZE;
+
+	memcpy(variable_image, &variable_layout, sizeof(uint32_t));
+	memcpy(variable_image + sizeof(uint32_t), &__CURRENT_TIME, sizeof(IEC_TIME));
+	config_backup__(&buffer, &maxsize);
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Opens the store of the RETAIN variables and restores
+// them into the program. Called before the first scan
+//-----------------------------------------------------------------------------
+static void readRetainedVariables(const char *path)
+{
+	char vars_path[256];
+	int maxsize = 0;
+	int clock_size = sizeof(IEC_TIME);
+
+	//sizes the clock and every RETAIN variable once to build the signature
+	variable_layout = crc32Update(0, &clock_size, sizeof(clock_size));
+	config_retain__(layoutOp, NULL, &maxsize);
+	if (maxsize == 0)
+	{
+		printf("Retain: the program has no RETAIN variables\n");
+		return;
+	}
+
+	variable_size = VARS_HEADER_SIZE - maxsize;
+	variable_image = (unsigned char *)malloc(variable_size);
+	if (variable_image == NULL)
+	{
+		variable_size = 0;
+		return;
+	}
+
+	snprintf(vars_path, sizeof(vars_path), "%s.vars", path);
+	int restored = retainOpen(&variable_store, vars_path, variable_size);
+	if (restored < 0)
+	{
+		free(variable_image);
+		variable_image = NULL;
+		variable_size = 0;
+		return;
+	}
+
+	if (restored > 0 && memcmp(variable_store.data, &variable_layout, sizeof(uint32_t)) != 0)
+	{
+		printf("WARNING: The RETAIN variables in %s belong to another program, starting cold\n", vars_path);
+		restored = 0;
+	}
+
+	pthread_mutex_lock(&bufferLock); //lock mutex
+	if (restored > 0)
+	{
+		void *buffer = variable_store.data + VARS_HEADER_SIZE;
+		maxsize = variable_size - VARS_HEADER_SIZE;
+		memcpy(&__CURRENT_TIME, variable_store.data + sizeof(uint32_t), sizeof(IEC_TIME));
+		config_restore__(&buffer, &maxsize);
+		publishProcessImage(); //RETAIN located variables live in the buffers
+		printf("Retain: %d bytes of RETAIN variables restored\n", variable_size - (int)VARS_HEADER_SIZE);
+	}
+	backupVariables();
+	pthread_mutex_unlock(&bufferLock); //unlock mutex
+
+	//a cold start replaces the image of the other program right away
+	retainUpdate(&variable_store, variable_image);
+}
+
+//-----------------------------------------------------------------------------
+// Main function for the thread. Every retain.interval_ms the holding
+// registers and the RETAIN variables are compared with the data stored, and
+// the changed bytes are written to the journals. The variables are copied
+// under the mutex, between two scans, so the image is consistent
+//-----------------------------------------------------------------------------
+void *persistentStorage(void *args)
+{
+	int interval = configInt("retain.interval_ms", DEFAULT_RETAIN_INTERVAL);
+	IEC_INT currentBuffer[BUFFER_SIZE];
+
+	while (1)
+	{
+		//the analog outputs are the first holding registers of the process image
+		readProcessImage(IMAGE_HOLDING_REGS, 0, BUFFER_SIZE, currentBuffer);
+		retainUpdate(&register_store, currentBuffer);
+
+		if (variable_size > 0)
+		{
+			pthread_mutex_lock(&bufferLock); //lock mutex
+			backupVariables();
+			pthread_mutex_unlock(&bufferLock); //unlock mutex
+			retainUpdate(&variable_store, variable_image);
+		}
+
+		sleep_thread(interval);
 	}
+}
 
-	IEC_INT persistentBuffer[BUFFER_SIZE];
+//-----------------------------------------------------------------------------
+// Opens the stores of the holding registers and of the RETAIN variables and
+// restores them. Returns 1 if the registers were restored
+//-----------------------------------------------------------------------------
+int readPersistentStorage()
+{
+	const char *path = configString("retain.file", "");
+
+	readRetainedVariables(path);
 
-	if (fread(persistentBuffer, sizeof(IEC_INT), BUFFER_SIZE, fd) < BUFFER_SIZE)
+	int restored = retainOpen(&register_store, path, sizeof(IEC_INT) * BUFFER_SIZE);
+	if (restored <= 0)
 	{
-		printf("Error while trying to read the persistent memory file!\n");
+		if (restored == 0)
+			printf("Retain: no data in %s yet\n", path);
 		return 0;
 	}
-	fclose(fd);
+
+	IEC_INT *persistentBuffer = (IEC_INT *)register_store.data;
 
 	pthread_mutex_lock(&bufferLock); //lock mutex
 	for (int i = 0; i < BUFFER_SIZE; i++)
 	{
 		if (int_output[i] != NULL) *int_output[i] = persistentBuffer[i];
 	}
+	publishProcessImage(); //the storage thread compares against the image
 	pthread_mutex_unlock(&bufferLock); //unlock mutex
+
+	return 1;
 }
@@ -0,0 +1,538 @@
+//-----------------------------------------------------------------------------
+// Copyright 2019 Novasom Industries
+//
+// Based on the software by Thiago Alves
+// This file is part of the OpenPLC Software Stack.
+//
+// OpenPLC is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenPLC is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenPLC.  If not, see <http://www.gnu.org/licenses/>.
+//------
+//
+// This file holds the process image seen by the network and persistence
+// threads. Once per cycle the scan thread copies the Modbus address space
+// into one of two buffers and publishes it; readers copy from the latest
+// buffer under a sequence counter and retry if the scan thread overwrote it
+// meanwhile, so they never block the scan. Writes coming from the network
+// are queued and applied by the scan thread at the next input phase.
+//
+// The image is kept in Modbus wire format: bits packed 8 per byte (lowest
+// address in the least significant bit) and registers in big endian, so the
+// Modbus responses are built with plain byte copies.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "ladder.h"
+
+#define WRITE_QUEUE_SIZE		4096
+
+#define IMAGE_WRITE_SET			0
+#define IMAGE_WRITE_MASK		1 //(current AND value) OR (or_mask AND NOT value)
+
+struct process_image
+{
+	uint32_t seq; //odd while the scan thread is writing the buffer
+	uint8_t discrete_input[MAX_DISCRETE_INPUT / 8];
+	uint8_t coils[MAX_COILS / 8];
+	uint8_t input_regs[MAX_INP_REGS * 2];
+	uint8_t holding_regs[MAX_HOLD_REGS * 2];
+};
+
+struct image_write
+{
+	uint8_t area;
+	uint8_t op;
+	uint16_t address;
+	IEC_UINT value;
+	IEC_UINT or_mask;
+};
+
+struct write_queue
+{
+	int count;
+	struct image_write entry[WRITE_QUEUE_SIZE];
+};
+
+static struct process_image image[2];
+static int image_latest = 0;
+
+//the network threads fill the active queue while the scan thread applies the other one
+static struct write_queue write_queue[2];
+static int write_queue_active = 0;
+static pthread_mutex_t writeQueueLock = PTHREAD_MUTEX_INITIALIZER;
+
+extern IEC_UINT mb_holding_regs[MAX_HOLD_REGS];
+
+//-----------------------------------------------------------------------------
+// Reads the value of a holding register from the located variables
+//-----------------------------------------------------------------------------
+static IEC_UINT readHoldingRegister(int position)
+{
+	//analog outputs
+	if (position < MIN_16B_RANGE)
+	{
+		return int_output[position] != NULL ? *int_output[position] : 0;
+	}
+	//16-bit registers
+	else if (position <= MAX_16B_RANGE)
+	{
+		return int_memory[position - MIN_16B_RANGE] != NULL ? *int_memory[position - MIN_16B_RANGE] : 0;
+	}
+	//32-bit registers, most significant word first
+	else if (position <= MAX_32B_RANGE)
+	{
+		IEC_DINT *dint = dint_memory[(position - MIN_32B_RANGE) / 2];
+		if (dint == NULL) return mb_holding_regs[position];
+
+		int shift = 16 * (1 - (position - MIN_32B_RANGE) % 2);
+		return (IEC_UINT)(((uint32_t)*dint >> shift) & 0xffff);
+	}
+	//64-bit registers, most significant word first
+	else
+	{
+		IEC_LINT *lint = lint_memory[(position - MIN_64B_RANGE) / 4];
+		if (lint == NULL) return mb_holding_regs[position];
+
+		int shift = 16 * (3 - (position - MIN_64B_RANGE) % 4);
+		return (IEC_UINT)(((uint64_t)*lint >> shift) & 0xffff);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Writes the value of a holding register to the located variables
+//-----------------------------------------------------------------------------
+static void writeHoldingRegister(int position, IEC_UINT value)
+{
+	//analog outputs
+	if (position < MIN_16B_RANGE)
+	{
+		if (int_output[position] != NULL) *int_output[position] = value;
+	}
+	//16-bit registers
+	else if (position <= MAX_16B_RANGE)
+	{
+		if (int_memory[position - MIN_16B_RANGE] != NULL) *int_memory[position - MIN_16B_RANGE] = value;
+	}
+	//32-bit registers, most significant word first
+	else if (position <= MAX_32B_RANGE)
+	{
+		IEC_DINT *dint = dint_memory[(position - MIN_32B_RANGE) / 2];
+		if (dint == NULL)
+		{
+			mb_holding_regs[position] = value;
+			return;
+		}
+
+		int shift = 16 * (1 - (position - MIN_32B_RANGE) % 2);
+		uint32_t tempValue = (uint32_t)*dint & ~((uint32_t)0xffff << shift);
+		*dint = (IEC_DINT)(tempValue | ((uint32_t)value << shift));
+	}
+	//64-bit registers, most significant word first
+	else
+	{
+		IEC_LINT *lint = lint_memory[(position - MIN_64B_RANGE) / 4];
+		if (lint == NULL)
+		{
+			mb_holding_regs[position] = value;
+			return;
+		}
+
+		int shift = 16 * (3 - (position - MIN_64B_RANGE) % 4);
+		uint64_t tempValue = (uint64_t)*lint & ~((uint64_t)0xffff << shift);
+		*lint = (IEC_LINT)(tempValue | ((uint64_t)value << shift));
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Packs 8 located bits into one byte
+//-----------------------------------------------------------------------------
+static inline uint8_t packBits(IEC_BOOL **bits)
+{
+	uint8_t value = 0;
+
+	for (int j = 0; j < 8; j++)
+	{
+		if (bits[j] != NULL && *bits[j]) value |= (1 << j);
+	}
+
+	return value;
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Stores a register in big endian
+//-----------------------------------------------------------------------------
+static inline void storeRegister(uint8_t *dst, IEC_UINT value)
+{
+	dst[0] = value >> 8;
+	dst[1] = value & 0xff;
+}
+
+//-----------------------------------------------------------------------------
+// Called by the scan thread (holding bufferLock) once per cycle. Copies the
+// located variables into the buffer not currently published and publishes it
+//-----------------------------------------------------------------------------
+void publishProcessImage()
+{
+	int next = 1 - image_latest;
+	struct process_image *img = &image[next];
+
+	__atomic_store_n(&img->seq, img->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	for (int i = 0; i < MAX_DISCRETE_INPUT / 8; i++)
+	{
+		img->discrete_input[i] = packBits(bool_input[i]);
+	}
+
+	for (int i = 0; i < MAX_COILS / 8; i++)
+	{
+		img->coils[i] = packBits(bool_output[i]);
+	}
+
+	for (int i = 0; i < MAX_INP_REGS; i++)
+	{
+		storeRegister(&img->input_regs[i * 2], int_input[i] != NULL ? *int_input[i] : 0);
+	}
+
+	//analog outputs
+	uint8_t *reg = img->holding_regs;
+	for (int i = 0; i < MIN_16B_RANGE; i++, reg += 2)
+	{
+		storeRegister(reg, int_output[i] != NULL ? *int_output[i] : 0);
+	}
+
+	//16-bit registers
+	for (int i = 0; i <= MAX_16B_RANGE - MIN_16B_RANGE; i++, reg += 2)
+	{
+		storeRegister(reg, int_memory[i] != NULL ? *int_memory[i] : 0);
+	}
+
+	//32-bit registers, most significant word first
+	for (int i = 0; i < (MAX_32B_RANGE - MIN_32B_RANGE + 1) / 2; i++, reg += 4)
+	{
+		if (dint_memory[i] != NULL)
+		{
+			uint32_t value = (uint32_t)*dint_memory[i];
+			storeRegister(reg, value >> 16);
+			storeRegister(reg + 2, value & 0xffff);
+		}
+		else
+		{
+			storeRegister(reg, mb_holding_regs[MIN_32B_RANGE + i * 2]);
+			storeRegister(reg + 2, mb_holding_regs[MIN_32B_RANGE + i * 2 + 1]);
+		}
+	}
+
+	//64-bit registers, most significant word first
+	for (int i = 0; i < (MAX_64B_RANGE - MIN_64B_RANGE + 1) / 4; i++, reg += 8)
+	{
+		if (lint_memory[i] != NULL)
+		{
+			uint64_t value = (uint64_t)*lint_memory[i];
+			for (int w = 0; w < 4; w++)
+				storeRegister(reg + w * 2, (value >> (16 * (3 - w))) & 0xffff);
+		}
+		else
+		{
+			for (int w = 0; w < 4; w++)
+				storeRegister(reg + w * 2, mb_holding_regs[MIN_64B_RANGE + i * 4 + w]);
+		}
+	}
+
+	__atomic_store_n(&img->seq, img->seq + 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&image_latest, next, __ATOMIC_RELEASE);
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Number of bits or registers in an area, 0 if the area is
+// not valid
+//-----------------------------------------------------------------------------
+static int areaSize(int area)
+{
+	switch (area)
+	{
+		case IMAGE_DISCRETE_INPUTS:	return MAX_DISCRETE_INPUT;
+		case IMAGE_COILS:			return MAX_COILS;
+		case IMAGE_INPUT_REGS:		return MAX_INP_REGS;
+		case IMAGE_HOLDING_REGS:	return MAX_HOLD_REGS;
+	}
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Copies size bytes starting at offset from one area of the latest published
+// image. Retries until the copy is not torn by the scan thread
+//-----------------------------------------------------------------------------
+static void snapshotImage(int area, int offset, int size, void *dst)
+{
+	while (1)
+	{
+		struct process_image *img = &image[__atomic_load_n(&image_latest, __ATOMIC_ACQUIRE)];
+		uint32_t seq = __atomic_load_n(&img->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) continue;
+
+		const uint8_t *src;
+		switch (area)
+		{
+			case IMAGE_DISCRETE_INPUTS:	src = img->discrete_input;	break;
+			case IMAGE_COILS:			src = img->coils;			break;
+			case IMAGE_INPUT_REGS:		src = img->input_regs;		break;
+			default:					src = img->holding_regs;	break;
+		}
+		memcpy(dst, src + offset, size);
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&img->seq, __ATOMIC_RELAXED) == seq)
+			return;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Copies count bits starting at start from a bit area of the latest image,
+// packed the Modbus way (8 per byte, lowest address in the least significant
+// bit, unused bits of the last byte cleared). Returns -1 if the range is
+// outside the area
+//-----------------------------------------------------------------------------
+int readImageBits(int area, int start, int count, unsigned char *dst)
+{
+	uint8_t bytes[MAX_COILS / 8 + 1];
+
+	if (area != IMAGE_DISCRETE_INPUTS && area != IMAGE_COILS)
+		return -1;
+	if (start < 0 || count <= 0 || start + count > areaSize(area))
+		return -1;
+
+	int first = start / 8;
+	int last = (start + count - 1) / 8;
+	snapshotImage(area, first, last - first + 1, bytes);
+	bytes[last - first + 1] = 0;
+
+	int shift = start % 8;
+	int size = (count + 7) / 8;
+	for (int i = 0; i < size; i++)
+	{
+		dst[i] = shift ? (bytes[i] >> shift) | (bytes[i + 1] << (8 - shift)) : bytes[i];
+	}
+	if (count % 8)
+		dst[size - 1] &= (1 << (count % 8)) - 1;
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Copies count registers starting at start from a register area of the latest
+// image, in big endian. Returns -1 if the range is outside the area
+//-----------------------------------------------------------------------------
+int readImageRegisters(int area, int start, int count, unsigned char *dst)
+{
+	if (area != IMAGE_INPUT_REGS && area != IMAGE_HOLDING_REGS)
+		return -1;
+	if (start < 0 || count < 0 || start + count > areaSize(area))
+		return -1;
+
+	snapshotImage(area, start * 2, count * 2, dst);
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Copies count elements starting at start from one area of the latest
+// published image. Bits are copied as IEC_BOOL, registers as IEC_UINT.
+// Returns -1 if the range is outside the area
+//-----------------------------------------------------------------------------
+int readProcessImage(int area, int start, int count, void *dst)
+{
+	if (area == IMAGE_DISCRETE_INPUTS || area == IMAGE_COILS)
+	{
+		uint8_t bits[MAX_COILS / 8];
+		if (readImageBits(area, start, count, bits) < 0)
+			return -1;
+
+		for (int i = 0; i < count; i++)
+			((IEC_BOOL *)dst)[i] = (bits[i / 8] >> (i % 8)) & 1;
+	}
+	else
+	{
+		if (readImageRegisters(area, start, count, (unsigned char *)dst) < 0)
+			return -1;
+
+		uint8_t *bytes = (uint8_t *)dst;
+		for (int i = 0; i < count; i++)
+			((IEC_UINT *)dst)[i] = (bytes[i * 2] << 8) | bytes[i * 2 + 1];
+	}
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Locks the write queue if it has room for count more
+// writes. Returns NULL (unlocked) if it does not
+//-----------------------------------------------------------------------------
+static struct write_queue *lockWriteQueue(int count)
+{
+	pthread_mutex_lock(&writeQueueLock);
+	struct write_queue *queue = &write_queue[write_queue_active];
+	if (queue->count + count > WRITE_QUEUE_SIZE)
+	{
+		pthread_mutex_unlock(&writeQueueLock);
+		return NULL;
+	}
+
+	return queue;
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Publishes the writes added to the queue and unlocks it
+//-----------------------------------------------------------------------------
+static void unlockWriteQueue(struct write_queue *queue, int count)
+{
+	__atomic_store_n(&queue->count, count, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&writeQueueLock);
+}
+
+//-----------------------------------------------------------------------------
+// Queues a write of count coils (IMAGE_COILS) or holding registers
+// (IMAGE_HOLDING_REGS) starting at start. All the values are applied in the
+// same scan cycle. Returns -1 if the area or range is invalid and -2 if the
+// queue is full
+//-----------------------------------------------------------------------------
+int queueImageWrite(int area, int start, int count, const IEC_UINT *values)
+{
+	if (area != IMAGE_COILS && area != IMAGE_HOLDING_REGS)
+		return -1;
+	if (start < 0 || count < 0 || start + count > areaSize(area))
+		return -1;
+
+	struct write_queue *queue = lockWriteQueue(count);
+	if (queue == NULL)
+		return -2;
+
+	int n = queue->count;
+	for (int i = 0; i < count; i++)
+	{
+		struct image_write *w = &queue->entry[n++];
+		w->area = area;
+		w->op = IMAGE_WRITE_SET;
+		w->address = start + i;
+		w->value = values[i];
+	}
+	unlockWriteQueue(queue, n);
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Same as queueImageWrite() for coils packed the Modbus way (8 per byte,
+// lowest address in the least significant bit)
+//-----------------------------------------------------------------------------
+int queueImageBits(int start, int count, const unsigned char *bits)
+{
+	if (start < 0 || count < 0 || start + count > MAX_COILS)
+		return -1;
+
+	struct write_queue *queue = lockWriteQueue(count);
+	if (queue == NULL)
+		return -2;
+
+	int n = queue->count;
+	for (int i = 0; i < count; i++)
+	{
+		struct image_write *w = &queue->entry[n++];
+		w->area = IMAGE_COILS;
+		w->op = IMAGE_WRITE_SET;
+		w->address = start + i;
+		w->value = (bits[i / 8] >> (i % 8)) & 1;
+	}
+	unlockWriteQueue(queue, n);
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Queues a mask write of a holding register. The scan thread reads the
+// current value and writes (current AND and_mask) OR (or_mask AND NOT
+// and_mask), so no other write can slip in between. Returns -1 if the
+// address is invalid and -2 if the queue is full
+//-----------------------------------------------------------------------------
+int queueImageMask(int address, IEC_UINT and_mask, IEC_UINT or_mask)
+{
+	if (address < 0 || address >= MAX_HOLD_REGS)
+		return -1;
+
+	struct write_queue *queue = lockWriteQueue(1);
+	if (queue == NULL)
+		return -2;
+
+	int n = queue->count;
+	struct image_write *w = &queue->entry[n++];
+	w->area = IMAGE_HOLDING_REGS;
+	w->op = IMAGE_WRITE_MASK;
+	w->address = address;
+	w->value = and_mask;
+	w->or_mask = or_mask;
+	unlockWriteQueue(queue, n);
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Called by the scan thread (holding bufferLock) at the input phase. Applies
+// the queued writes to the located variables. If a network thread is queueing
+// at this very moment the writes are left for the next cycle, so the scan
+// thread never waits for the network
+//-----------------------------------------------------------------------------
+void applyImageWrites()
+{
+	if (__atomic_load_n(&write_queue[write_queue_active].count, __ATOMIC_RELAXED) == 0)
+		return;
+
+	if (pthread_mutex_trylock(&writeQueueLock) != 0)
+		return;
+	struct write_queue *queue = &write_queue[write_queue_active];
+	write_queue_active = 1 - write_queue_active;
+	pthread_mutex_unlock(&writeQueueLock);
+
+	for (int i = 0; i < queue->count; i++)
+	{
+		struct image_write *w = &queue->entry[i];
+		if (w->area == IMAGE_COILS)
+		{
+			if (bool_output[w->address/8][w->address%8] != NULL)
+				*bool_output[w->address/8][w->address%8] = (w->value != 0);
+		}
+		else if (w->op == IMAGE_WRITE_MASK)
+		{
+			IEC_UINT current = readHoldingRegister(w->address);
+			writeHoldingRegister(w->address, (current & w->value) | (w->or_mask & ~w->value));
+		}
+		else
+		{
+			writeHoldingRegister(w->address, w->value);
+		}
+	}
+	queue->count = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Builds the first image so the readers have valid data before the first scan
+//-----------------------------------------------------------------------------
+void initProcessImage()
+{
+	pthread_mutex_lock(&bufferLock);
+	publishProcessImage();
+	publishProcessImage();
+	pthread_mutex_unlock(&bufferLock);
+}
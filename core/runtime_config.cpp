@@ -0,0 +1,166 @@
+//-----------------------------------------------------------------------------
+// Copyright 2019 Novasom Industries
+//
+// Based on the software by Thiago Alves
+// This file is part of the OpenPLC Software Stack.
+//
+// OpenPLC is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenPLC is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenPLC.  If not, see <http://www.gnu.org/licenses/>.
+//------
+//
+// This file reads the runtime configuration file (novaplc.cfg). It uses the
+// same format as mbconfig.cfg: one 'key = "value"' per line, lines starting
+// with # are comments. Every parameter has a default, so the file is optional.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ladder.h"
+
+#define CONFIG_MAX_ENTRIES		128
+#define CONFIG_MAX_KEY			64
+#define CONFIG_MAX_VALUE		256
+
+struct config_entry
+{
+	char key[CONFIG_MAX_KEY];
+	char value[CONFIG_MAX_VALUE];
+};
+
+static struct config_entry config_entries[CONFIG_MAX_ENTRIES];
+static int config_count = 0;
+
+//-----------------------------------------------------------------------------
+// Copies the text between the separators on the line provided
+//-----------------------------------------------------------------------------
+static void getValue(const char *line, char *buf, int size, char separator1, char separator2)
+{
+	int j = 0;
+	buf[0] = '\0';
+
+	while (*line != separator1 && *line != '\0') line++;
+	if (*line == '\0') return;
+	line++;
+
+	while (*line != separator2 && *line != '\0' && j < size - 1)
+	{
+		buf[j++] = *line++;
+	}
+	buf[j] = '\0';
+}
+
+//-----------------------------------------------------------------------------
+// Loads the configuration file. Returns the number of parameters read or -1
+// if the file could not be opened (the defaults are used in that case)
+//-----------------------------------------------------------------------------
+int loadRuntimeConfig(const char *path)
+{
+	char line[1024];
+	FILE *cfgfile = fopen(path, "r");
+
+	if (cfgfile == NULL)
+	{
+		printf("Config: %s not found, using the default settings\n", path);
+		return -1;
+	}
+
+	config_count = 0;
+	while (fgets(line, sizeof(line), cfgfile) != NULL)
+	{
+		if (line[0] == '#' || strchr(line, '=') == NULL)
+			continue;
+
+		if (config_count >= CONFIG_MAX_ENTRIES)
+		{
+			printf("WARNING: Too many parameters in %s, ignoring the rest\n", path);
+			break;
+		}
+
+		struct config_entry *entry = &config_entries[config_count];
+		int j = 0;
+		for (int i = 0; line[i] != ' ' && line[i] != '\t' && line[i] != '=' && j < CONFIG_MAX_KEY - 1; i++)
+		{
+			entry->key[j++] = line[i];
+		}
+		entry->key[j] = '\0';
+		getValue(line, entry->value, CONFIG_MAX_VALUE, '"', '"');
+
+		if (entry->key[0] != '\0') config_count++;
+	}
+	fclose(cfgfile);
+
+	printf("Config: %d parameters read from %s\n", config_count, path);
+	return config_count;
+}
+
+//-----------------------------------------------------------------------------
+// Returns the value of a parameter, or def if it is not set
+//-----------------------------------------------------------------------------
+const char *configString(const char *key, const char *def)
+{
+	for (int i = 0; i < config_count; i++)
+	{
+		if (!strcmp(config_entries[i].key, key))
+			return config_entries[i].value;
+	}
+
+	return def;
+}
+
+//-----------------------------------------------------------------------------
+// Returns the value of an integer parameter, or def if it is not set or empty
+//-----------------------------------------------------------------------------
+int configInt(const char *key, int def)
+{
+	const char *value = configString(key, NULL);
+	if (value == NULL || value[0] == '\0')
+		return def;
+
+	return atoi(value);
+}
+
+//-----------------------------------------------------------------------------
+// Parses a list of numbers such as "2,3" or "1-3" (CPUs, GPIO lines...) into
+// values. Returns the number of values found
+//-----------------------------------------------------------------------------
+int parseIntList(const char *list, int *values, int max)
+{
+	int count = 0;
+
+	while (list != NULL && *list != '\0' && count < max)
+	{
+		char *end;
+		int first = strtol(list, &end, 10);
+		if (end == list) break;
+
+		int last = first;
+		if (*end == '-')
+		{
+			list = end + 1;
+			last = strtol(list, &end, 10);
+			if (end == list) last = first;
+		}
+
+		for (int value = first; value <= last && count < max; value++)
+		{
+			values[count++] = value;
+		}
+
+		list = end;
+		while (*list == ',' || *list == ' ') list++;
+	}
+
+	return count;
+}
@@ -0,0 +1,87 @@
+//-----------------------------------------------------------------------------
+// Copyright 2019 Novasom Industries
+//
+// Based on the software by Thiago Alves
+// This file is part of the OpenPLC Software Stack.
+//
+// OpenPLC is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenPLC is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenPLC.  If not, see <http://www.gnu.org/licenses/>.
+//------
+//
+// Log-linear histogram buckets shared by the scan cycle statistics
+// (scan_timing.cpp) and the tools reading them (src/modbus_bench.cpp), so
+// both always agree on the layout.
+//-----------------------------------------------------------------------------
+
+#ifndef SCAN_HIST_H
+#define SCAN_HIST_H
+
+#include <stdint.h>
+
+#define SCAN_HIST_SUB_BITS		4
+#define SCAN_HIST_BUCKETS		(64 << SCAN_HIST_SUB_BITS)
+
+//-----------------------------------------------------------------------------
+// Maps a value to its histogram bucket. Values below 2^SCAN_HIST_SUB_BITS
+// have one bucket each; above that every power of two is split in
+// 2^SCAN_HIST_SUB_BITS linear sub-buckets (~6% resolution)
+//-----------------------------------------------------------------------------
+static inline int scanHistBucket(uint64_t value)
+{
+	if (value < (1 << SCAN_HIST_SUB_BITS))
+		return (int)value;
+
+	int msb = 63 - __builtin_clzll(value);
+	int shift = msb - SCAN_HIST_SUB_BITS;
+
+	return ((shift + 1) << SCAN_HIST_SUB_BITS) + (int)((value >> shift) & ((1 << SCAN_HIST_SUB_BITS) - 1));
+}
+
+//-----------------------------------------------------------------------------
+// Lowest value that falls in the given bucket
+//-----------------------------------------------------------------------------
+static inline uint64_t scanHistBucketValue(int bucket)
+{
+	if (bucket < (1 << SCAN_HIST_SUB_BITS))
+		return (uint64_t)bucket;
+
+	int shift = (bucket >> SCAN_HIST_SUB_BITS) - 1;
+	uint64_t sub = (uint64_t)((1 << SCAN_HIST_SUB_BITS) + (bucket & ((1 << SCAN_HIST_SUB_BITS) - 1)));
+
+	return sub << shift;
+}
+
+//-----------------------------------------------------------------------------
+// Returns the bucket below which the given fraction (0.0 - 1.0) of the count
+// samples falls, or -1 if the buckets hold less than count samples. The
+// buckets may be updated meanwhile by the scan thread
+//-----------------------------------------------------------------------------
+static inline int scanHistRank(uint64_t *bucket, uint64_t count, double fraction)
+{
+	if (count == 0) return -1;
+
+	uint64_t target = (uint64_t)(fraction * count);
+	if (target >= count) target = count - 1;
+
+	uint64_t seen = 0;
+	for (int i = 0; i < SCAN_HIST_BUCKETS; i++)
+	{
+		seen += __atomic_load_n(&bucket[i], __ATOMIC_RELAXED);
+		if (seen > target)
+			return i;
+	}
+
+	return -1;
+}
+
+#endif
@@ -0,0 +1,294 @@
+//-----------------------------------------------------------------------------
+// Copyright 2019 Novasom Industries
+//
+// Based on the software by Thiago Alves
+// This file is part of the OpenPLC Software Stack.
+//
+// OpenPLC is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenPLC is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenPLC.  If not, see <http://www.gnu.org/licenses/>.
+//------
+//
+// This file records the timing of every scan cycle: the duration of the
+// input, logic and output phases, the wake-up lateness against the absolute
+// deadline and the number of overruns. The samples are kept in log-linear
+// (HDR style) histograms inside a preallocated structure. The scan thread is
+// the only writer and never takes a lock, so any other thread (or process,
+// through the shared memory segment) can read the statistics at any time.
+// It also times the startup phases, from the exec to the first scan.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "ladder.h"
+
+static struct scan_stats local_stats;
+struct scan_stats *scan_stats = &local_stats;
+
+static struct timespec phase_start;
+static struct timespec cycle_start;
+
+//startup phases, filled by the main thread before the first scan
+#define MAX_STARTUP_PHASES			16
+#define DEFAULT_STARTUP_BUDGET_MS	100
+
+static struct timespec startup_start;
+static struct timespec startup_end[MAX_STARTUP_PHASES];
+static const char *startup_names[MAX_STARTUP_PHASES];
+static int startup_phases = 0;
+static int64_t exec_to_main_ns = -1;
+
+const char *scan_hist_names[SCAN_HIST_COUNT] = { "input", "logic", "output", "cycle", "wakeup" };
+
+//-----------------------------------------------------------------------------
+// Helper function - Difference in nanoseconds between two timestamps
+//-----------------------------------------------------------------------------
+static inline int64_t diffNs(struct timespec *end, struct timespec *start)
+{
+	return (int64_t)(end->tv_sec - start->tv_sec) * 1000000000LL + (end->tv_nsec - start->tv_nsec);
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Only the scan thread writes the statistics, so a relaxed
+// store of the incremented value is enough for the readers to see it
+//-----------------------------------------------------------------------------
+static inline void statAdd(uint64_t *counter, uint64_t value)
+{
+	__atomic_store_n(counter, *counter + value, __ATOMIC_RELAXED);
+}
+
+static inline void histRecord(struct scan_histogram *hist, int64_t value)
+{
+	if (value < 0) value = 0;
+
+	statAdd(&hist->bucket[scanHistBucket((uint64_t)value)], 1);
+	statAdd(&hist->total, (uint64_t)value);
+	if ((uint64_t)value > hist->max)
+		__atomic_store_n(&hist->max, (uint64_t)value, __ATOMIC_RELAXED);
+	statAdd(&hist->count, 1);
+}
+
+//-----------------------------------------------------------------------------
+// Returns the value below which the given fraction (0.0 - 1.0) of the samples
+// of the histogram falls
+//-----------------------------------------------------------------------------
+uint64_t scanHistPercentile(struct scan_histogram *hist, double fraction)
+{
+	uint64_t count = __atomic_load_n(&hist->count, __ATOMIC_RELAXED);
+	if (count == 0) return 0;
+
+	int bucket = scanHistRank(hist->bucket, count, fraction);
+	if (bucket >= 0)
+		return scanHistBucketValue(bucket);
+
+	return __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+}
+
+//-----------------------------------------------------------------------------
+// Allocates the statistics area. It is placed in a shared memory segment
+// (/dev/shm/novaplc_stats) so that external tools can read it without
+// disturbing the runtime. If that fails a private static area is used.
+// Must be called before mlockall() so the pages are locked as well.
+//-----------------------------------------------------------------------------
+void initScanTiming(unsigned long long period_ns)
+{
+	int fd = shm_open(SCAN_STATS_SHM, O_CREAT | O_RDWR, 0644);
+	if (fd >= 0)
+	{
+		if (ftruncate(fd, sizeof(struct scan_stats)) == 0)
+		{
+			void *area = mmap(NULL, sizeof(struct scan_stats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (area != MAP_FAILED) scan_stats = (struct scan_stats *)area;
+		}
+		close(fd);
+	}
+
+	if (scan_stats == &local_stats)
+	{
+		printf("WARNING: Failed to create shared scan statistics, using private memory\n");
+	}
+
+	//touching every page here keeps page faults out of the scan thread
+	memset(scan_stats, 0, sizeof(struct scan_stats));
+	scan_stats->period_ns = period_ns;
+	__atomic_store_n(&scan_stats->magic, SCAN_STATS_MAGIC, __ATOMIC_RELEASE);
+}
+
+//-----------------------------------------------------------------------------
+// Called by the scan thread right after waking up. The deadline is the
+// absolute time the thread was supposed to wake up at.
+//-----------------------------------------------------------------------------
+void scanCycleBegin(struct timespec *deadline)
+{
+	clock_gettime(CLOCK_MONOTONIC, &cycle_start);
+	phase_start = cycle_start;
+
+	histRecord(&scan_stats->hist[SCAN_HIST_WAKEUP], diffNs(&cycle_start, deadline));
+}
+
+//-----------------------------------------------------------------------------
+// Called by the scan thread at the end of each phase (input, logic, output)
+//-----------------------------------------------------------------------------
+void scanPhaseEnd(int phase)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	histRecord(&scan_stats->hist[phase], diffNs(&now, &phase_start));
+	phase_start = now;
+}
+
+//-----------------------------------------------------------------------------
+// Called by the scan thread when the cycle is complete. If the next deadline
+// (deadline + period) has already passed, the cycle is counted as an overrun.
+// Returns by how many nanoseconds the next deadline was missed (<= 0 if not)
+//-----------------------------------------------------------------------------
+int64_t scanCycleEnd(struct timespec *deadline, unsigned long long period_ns)
+{
+	int64_t late = diffNs(&phase_start, deadline) - (int64_t)period_ns;
+
+	histRecord(&scan_stats->hist[SCAN_HIST_CYCLE], diffNs(&phase_start, &cycle_start));
+	if (late > 0)
+	{
+		statAdd(&scan_stats->overruns, 1);
+		if ((uint64_t)late > scan_stats->max_overrun_ns)
+			__atomic_store_n(&scan_stats->max_overrun_ns, (uint64_t)late, __ATOMIC_RELAXED);
+	}
+	statAdd(&scan_stats->cycles, 1);
+
+	return late;
+}
+
+//-----------------------------------------------------------------------------
+// Prints a summary of the statistics collected so far
+//-----------------------------------------------------------------------------
+void printScanStats()
+{
+	printf("Scan stats: %llu cycles, %llu overruns (worst %llu us), period %llu us\n",
+		(unsigned long long)__atomic_load_n(&scan_stats->cycles, __ATOMIC_RELAXED),
+		(unsigned long long)__atomic_load_n(&scan_stats->overruns, __ATOMIC_RELAXED),
+		(unsigned long long)__atomic_load_n(&scan_stats->max_overrun_ns, __ATOMIC_RELAXED) / 1000,
+		(unsigned long long)scan_stats->period_ns / 1000);
+
+	for (int i = 0; i < SCAN_HIST_COUNT; i++)
+	{
+		struct scan_histogram *hist = &scan_stats->hist[i];
+		uint64_t count = __atomic_load_n(&hist->count, __ATOMIC_RELAXED);
+
+		printf("  %-7s avg %8llu ns  p50 %8llu ns  p99 %8llu ns  p99.9 %8llu ns  max %8llu ns\n",
+			scan_hist_names[i],
+			(unsigned long long)(count ? __atomic_load_n(&hist->total, __ATOMIC_RELAXED) / count : 0),
+			(unsigned long long)scanHistPercentile(hist, 0.50),
+			(unsigned long long)scanHistPercentile(hist, 0.99),
+			(unsigned long long)scanHistPercentile(hist, 0.999),
+			(unsigned long long)__atomic_load_n(&hist->max, __ATOMIC_RELAXED));
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Starts the startup timing. Called first thing in main(). The time spent
+// between the exec and main() (loader, static constructors) is estimated
+// from the start time of the process, which the kernel keeps in clock ticks
+//-----------------------------------------------------------------------------
+void initStartupTiming()
+{
+	char stat[1024];
+	struct timespec boot_now;
+
+	clock_gettime(CLOCK_MONOTONIC, &startup_start);
+	clock_gettime(CLOCK_BOOTTIME, &boot_now);
+
+	int fd = open("/proc/self/stat", O_RDONLY);
+	if (fd < 0)
+		return;
+	int length = read(fd, stat, sizeof(stat) - 1);
+	close(fd);
+	if (length <= 0)
+		return;
+	stat[length] = '\0';
+
+	//the start time is the 22nd field, the 20th after the command name
+	char *field = strrchr(stat, ')');
+	for (int i = 0; field != NULL && i < 20; i++)
+	{
+		field = strchr(field + 1, ' ');
+	}
+	if (field == NULL)
+		return;
+
+	long long ticks = strtoll(field + 1, NULL, 10);
+	long long hz = sysconf(_SC_CLK_TCK);
+	int64_t since_boot = (int64_t)boot_now.tv_sec * 1000000000LL + boot_now.tv_nsec;
+	if (hz > 0 && ticks > 0)
+		exec_to_main_ns = since_boot - ticks * (1000000000LL / hz);
+}
+
+//-----------------------------------------------------------------------------
+// Marks the end of a startup phase
+//-----------------------------------------------------------------------------
+void startupPhaseEnd(const char *name)
+{
+	if (startup_phases >= MAX_STARTUP_PHASES)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &startup_end[startup_phases]);
+	startup_names[startup_phases++] = name;
+}
+
+//-----------------------------------------------------------------------------
+// Prints the duration of every startup phase and warns if the runtime took
+// longer than startup.budget_ms to get ready for the first scan
+//-----------------------------------------------------------------------------
+void printStartupReport()
+{
+	int budget_ms = configInt("startup.budget_ms", DEFAULT_STARTUP_BUDGET_MS);
+	struct timespec *previous = &startup_start;
+
+	printf("Startup timing:\n");
+	if (exec_to_main_ns >= 0)
+		printf("  %-16s %8.3f ms (process start time, clock tick resolution)\n", "exec", exec_to_main_ns / 1e6);
+
+	for (int i = 0; i < startup_phases; i++)
+	{
+		printf("  %-16s %8.3f ms\n", startup_names[i], diffNs(&startup_end[i], previous) / 1e6);
+		previous = &startup_end[i];
+	}
+
+	int64_t total = diffNs(previous, &startup_start);
+	printf("  %-16s %8.3f ms from main()\n", "ready to scan", total / 1e6);
+
+	if (total > (int64_t)budget_ms * 1000000LL)
+		printf("WARNING: Startup took longer than the %d ms budget\n", budget_ms);
+}
+
+//-----------------------------------------------------------------------------
+// Thread that periodically prints the scan statistics. The interval in
+// seconds is passed as argument
+//-----------------------------------------------------------------------------
+void *scanStatsThread(void *arg)
+{
+	int interval = *(int *)arg;
+
+	while (1)
+	{
+		sleep_thread(interval * 1000);
+		printScanStats();
+		printTaskStats();
+		printIoStats();
+	}
+}
@@ -0,0 +1,163 @@
+//-----------------------------------------------------------------------------
+// Copyright 2019 Novasom Industries
+//
+// Based on the software by Thiago Alves
+// This file is part of the OpenPLC Software Stack.
+//
+// OpenPLC is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenPLC is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenPLC.  If not, see <http://www.gnu.org/licenses/>.
+//------
+//
+// This file is the multi-task scheduler of the OpenPLC. Instead of running
+// every task from config_run__() on the common tick, each TASK declared in
+// the IEC program gets its own SCHED_FIFO thread running at the declared
+// INTERVAL, with the IEC PRIORITY mapped to a real-time priority. The task
+// tables are generated by iec2c (config_tasks__).
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "iec_types.h"
+#include "ladder.h"
+
+#define MAX_TASKS				32
+
+//IEC priority 0 is mapped to this RT priority, lower priorities go down from
+//here. The scan thread doing the I/O runs above it (priority 30)
+#define TASK_RT_PRIORITY_MAX	29
+#define TASK_RT_PRIORITY_MIN	1
+
+extern IEC_TASK *config_tasks__[];
+
+struct task_thread
+{
+	IEC_TASK *task;
+	pthread_t thread;
+	unsigned long long period;
+	int rt_priority;
+	uint64_t cycles;
+	uint64_t overruns;
+};
+
+static struct task_thread task_threads[MAX_TASKS];
+static int task_count = 0;
+
+//set by the main loop on START/PAUSE
+int tasks_running = 0;
+
+//-----------------------------------------------------------------------------
+// Maps an IEC task priority (0 is the highest) to a SCHED_FIFO priority
+//-----------------------------------------------------------------------------
+static int taskRtPriority(int iec_priority)
+{
+	if (iec_priority < 0) return TASK_RT_PRIORITY_MIN;
+
+	int rt_priority = TASK_RT_PRIORITY_MAX - iec_priority;
+	if (rt_priority < TASK_RT_PRIORITY_MIN) rt_priority = TASK_RT_PRIORITY_MIN;
+
+	return rt_priority;
+}
+
+//-----------------------------------------------------------------------------
+// Thread running a single IEC task with its own period
+//-----------------------------------------------------------------------------
+static void *taskThread(void *arg)
+{
+	struct task_thread *t = (struct task_thread *)arg;
+	struct timespec deadline, now;
+	unsigned long tick = 0;
+
+	prefaultStack();
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+	while (1)
+	{
+		if (__atomic_load_n(&tasks_running, __ATOMIC_ACQUIRE))
+		{
+			//the inputs may have been read since the scan applied the
+			//forced values, and the outputs go out after the scan unlocks
+			pthread_mutex_lock(&bufferLock);
+			applyForcing();
+			t->task->run(tick++);
+			applyForcing();
+			pthread_mutex_unlock(&bufferLock);
+
+			//the task is late if it finished after its next activation
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			long long late = (long long)(now.tv_sec - deadline.tv_sec) * 1000000000LL + (now.tv_nsec - deadline.tv_nsec);
+			if (late > (long long)t->period)
+				__atomic_store_n(&t->overruns, t->overruns + 1, __ATOMIC_RELAXED);
+			__atomic_store_n(&t->cycles, t->cycles + 1, __ATOMIC_RELAXED);
+		}
+		sleep_until(&deadline, t->period);
+	}
+
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Creates one thread for each task of the IEC program. Returns the number of
+// tasks started
+//-----------------------------------------------------------------------------
+int startTaskScheduler()
+{
+	for (int r = 0; config_tasks__[r] != NULL; r++)
+	{
+		for (IEC_TASK *task = config_tasks__[r]; task->run != NULL; task++)
+		{
+			if (task_count >= MAX_TASKS)
+			{
+				printf("Scheduler: too many tasks, %s will not run\n", task->name);
+				continue;
+			}
+
+			struct task_thread *t = &task_threads[task_count];
+			t->task = task;
+			t->period = task->interval ? task->interval : common_ticktime__;
+			t->rt_priority = taskRtPriority(task->priority);
+
+			//the tasks share the CPUs of the scan class, with the priority
+			//of the IEC task
+			if (pthread_create(&t->thread, NULL, taskThread, t) != 0)
+			{
+				printf("Scheduler: could not create thread for task %s\n", task->name);
+				continue;
+			}
+			setupThread(t->thread, THREAD_CLASS_SCAN, task->name[0] ? task->name : "task", t->rt_priority);
+
+			printf("Scheduler: task %s every %llu us, RT priority %d\n",
+				task->name[0] ? task->name : "(cyclic)", t->period / 1000, t->rt_priority);
+			task_count++;
+		}
+	}
+
+	return task_count;
+}
+
+//-----------------------------------------------------------------------------
+// Prints the number of cycles and overruns of every task
+//-----------------------------------------------------------------------------
+void printTaskStats()
+{
+	for (int i = 0; i < task_count; i++)
+	{
+		struct task_thread *t = &task_threads[i];
+		printf("  task %-12s %llu cycles, %llu overruns\n",
+			t->task->name[0] ? t->task->name : "(cyclic)",
+			(unsigned long long)__atomic_load_n(&t->cycles, __ATOMIC_RELAXED),
+			(unsigned long long)__atomic_load_n(&t->overruns, __ATOMIC_RELAXED));
+	}
+}
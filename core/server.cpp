@@ -20,6 +20,11 @@
 // to create a socket, bind it and start network communication.
 // Thiago Alves, Dec 2015
 //-----------------------------------------------------------------------------
+//
+// The server runs on a fixed pool of connections: one acceptor (the thread
+// calling startServer) hands every new socket to one of N worker threads, and
+// each worker serves all its sockets from a single epoll loop.
+//-----------------------------------------------------------------------------
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -27,7 +32,13 @@
 #include <errno.h>
 #include <netdb.h>
 #include <string.h>
+#include <fcntl.h>
+#include <time.h>
 #include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <netinet/tcp.h>
 
 #include "ladder.h"
 
@@ -35,6 +46,62 @@
 #define MAX_OUTPUT 16
 #define MAX_MODBUS 100
 
+#define MAX_SERVER_WORKERS		8
+#define MAX_EPOLL_EVENTS		64
+#define RX_BUFFER_SIZE			1024
+
+//MBAP framing. Each request is answered in its own slot of the transmit
+//buffer and up to MAX_PIPELINE responses go out with one writev()
+#define MBAP_HEADER_SIZE		6 //transaction id, protocol id and length
+#define MODBUS_TCP_MAX_ADU		260
+#define RESPONSE_SLOT_SIZE		264 //longest response built by modbus.cpp (9 + 255 bytes)
+#define MAX_PIPELINE			16
+
+//defaults, can be changed in novaplc.cfg
+#define DEFAULT_MAX_CONNECTIONS	32
+#define DEFAULT_IDLE_TIMEOUT	60 //seconds, 0 disables it
+#define DEFAULT_WORKERS			1
+
+struct connection
+{
+	int fd;
+	int worker; //index of the worker serving it + 1, 0 if the slot is free
+	time_t last_activity;
+	int rx_len;
+	unsigned char rx_buffer[RX_BUFFER_SIZE];
+	int tx_len; //bytes waiting for the socket to become writable
+	int tx_sent;
+	unsigned char tx_buffer[MAX_PIPELINE * RESPONSE_SLOT_SIZE];
+	struct connection *next_free;
+};
+
+struct server_worker
+{
+	int index;
+	int epoll_fd;
+	int cpu; //-1 if not pinned
+	pthread_t thread;
+};
+
+static struct connection *connections;
+static struct connection *free_connections;
+static pthread_mutex_t connectionsLock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct server_worker workers[MAX_SERVER_WORKERS];
+static int worker_count;
+static int max_connections;
+static int idle_timeout;
+
+//-----------------------------------------------------------------------------
+// Helper function - Seconds from the monotonic clock
+//-----------------------------------------------------------------------------
+static time_t monotonicSeconds()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec;
+}
+
 //-----------------------------------------------------------------------------
 // Create the socket and bind it. Returns the file descriptor for the socket
 // created.
@@ -52,6 +119,10 @@ int createSocket(int port)
 		exit(1);
 	}
 
+	//Allow the runtime to be restarted while old connections are in TIME_WAIT
+	int reuse = 1;
+	setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
 	//Initialize Server Struct
 	bzero((char *) &server_addr, sizeof(server_addr));
 	server_addr.sin_family = AF_INET;
@@ -64,8 +135,8 @@ int createSocket(int port)
 		perror("Server: error binding socket");
 		exit(1);
 	}
-        // we accept max 5 pending connections
-	listen(socket_fd,5);
+
+	listen(socket_fd, max_connections);
 	printf("Server: Listening on port %d\n", port);
 
 	return socket_fd;
@@ -81,8 +152,6 @@ int waitForClient(int socket_fd)
 	struct sockaddr_in client_addr;
 	socklen_t client_len;
 
-	printf("Server: waiting for new client...\n");
-
 	client_len = sizeof(client_addr);
 	client_fd = accept(socket_fd, (struct sockaddr *)&client_addr, &client_len); //blocking call
 
@@ -90,75 +159,340 @@ int waitForClient(int socket_fd)
 }
 
 //-----------------------------------------------------------------------------
-// Blocking call. Holds here until something is received from the client.
-// Once the message is received, it is stored on the buffer and the function
-// returns the number of bytes received.
+// Takes a free connection from the pool. Returns NULL if the limit has been
+// reached
 //-----------------------------------------------------------------------------
-int listenToClient(int client_fd, unsigned char *buffer)
+static struct connection *allocConnection()
 {
-	bzero(buffer, 1024);
-	int n = read(client_fd, buffer, 1024);
-	return n;
+	pthread_mutex_lock(&connectionsLock);
+	struct connection *conn = free_connections;
+	if (conn != NULL) free_connections = conn->next_free;
+	pthread_mutex_unlock(&connectionsLock);
+
+	return conn;
 }
 
 //-----------------------------------------------------------------------------
-// Process client's request
+// Closes the client socket and gives the connection back to the pool
 //-----------------------------------------------------------------------------
-void processMessage(unsigned char *buffer, int bufferSize, int client_fd)
+static void closeConnection(struct server_worker *worker, struct connection *conn)
 {
-	int messageSize = processModbusMessage(buffer, bufferSize);
-	write(client_fd, buffer, messageSize);
+	epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+	close(conn->fd);
+	__atomic_store_n(&conn->worker, 0, __ATOMIC_RELEASE);
+
+	pthread_mutex_lock(&connectionsLock);
+	conn->next_free = free_connections;
+	free_connections = conn;
+	pthread_mutex_unlock(&connectionsLock);
 }
 
 //-----------------------------------------------------------------------------
-// Thread to handle requests for each connected client
+// Changes the events the worker waits for on the connection
 //-----------------------------------------------------------------------------
-void *handleConnections(void *arguments)
+static void watchConnection(struct server_worker *worker, struct connection *conn, uint32_t events)
 {
-	int client_fd = *(int *)arguments;
-	unsigned char buffer[1024];
-	int messageSize;
+	struct epoll_event event;
+	event.events = events;
+	event.data.ptr = conn;
+	epoll_ctl(worker->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+}
 
-	printf("Server: Thread created for client ID: %d\n", client_fd);
+//-----------------------------------------------------------------------------
+// Sends the responses with a single writev(). Whatever the socket does not
+// take is moved to the start of the transmit buffer and sent when it becomes
+// writable again. Returns -1 if the connection must be closed
+//-----------------------------------------------------------------------------
+static int sendResponses(struct server_worker *worker, struct connection *conn, struct iovec *iov, int count)
+{
+	int total = 0;
+	for (int i = 0; i < count; i++) total += iov[i].iov_len;
 
-	while(1)
+	int sent = writev(conn->fd, iov, count);
+	if (sent < 0)
+	{
+		if (errno != EAGAIN && errno != EINTR)
+		{
+			printf("Server: could not send the response to client ID: %d\n", conn->fd);
+			return -1;
+		}
+		sent = 0;
+	}
+
+	if (sent == total)
+		return 0;
+
+	//keep the unsent bytes. The slots only move towards the start of the
+	//buffer, so memmove in order is safe
+	conn->tx_len = 0;
+	conn->tx_sent = 0;
+	for (int i = 0; i < count; i++)
+	{
+		int skip = sent < (int)iov[i].iov_len ? sent : iov[i].iov_len;
+		sent -= skip;
+		memmove(conn->tx_buffer + conn->tx_len, (unsigned char *)iov[i].iov_base + skip, iov[i].iov_len - skip);
+		conn->tx_len += iov[i].iov_len - skip;
+	}
+	watchConnection(worker, conn, EPOLLOUT);
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Processes every complete MBAP frame in the receive buffer. A single read
+// may carry several pipelined requests, or only part of one; incomplete
+// frames stay in the buffer until the rest arrives. Returns -1 if the
+// connection must be closed
+//-----------------------------------------------------------------------------
+static int processFrames(struct server_worker *worker, struct connection *conn)
+{
+	while (conn->tx_len == 0)
 	{
-		//unsigned char buffer[1024];
-		//int messageSize;
+		struct iovec iov[MAX_PIPELINE];
+		int count = 0;
+		int offset = 0;
 
-		messageSize = listenToClient(client_fd, buffer);
-		if (messageSize <= 0 || messageSize > 1024)
+		while (count < MAX_PIPELINE && conn->rx_len - offset >= MBAP_HEADER_SIZE)
 		{
-			// something has  gone wrong or the client has closed connection
-			if (messageSize == 0)
-			{
-				printf("Server: client ID: %d has closed the connection\n", client_fd);
-			}
-			else
+			unsigned char *frame = conn->rx_buffer + offset;
+			int length = (frame[4] << 8) | frame[5];
+			int frameSize = MBAP_HEADER_SIZE + length;
+
+			if (length < 2 || frameSize > MODBUS_TCP_MAX_ADU)
 			{
-				printf("Server: Something is wrong with the  client ID: %d message Size : %i\n", client_fd, messageSize);
+				printf("Server: invalid MBAP length %d from client ID: %d\n", length, conn->fd);
+				return -1;
 			}
+			if (conn->rx_len - offset < frameSize)
+				break;
+			offset += frameSize;
+
+			//only the Modbus protocol (id 0) is served, other frames are dropped
+			if (frame[2] != 0 || frame[3] != 0)
+				continue;
+
+			//the response is built in place, so it gets a slot of its own
+			unsigned char *response = conn->tx_buffer + count * RESPONSE_SLOT_SIZE;
+			memcpy(response, frame, frameSize);
+			iov[count].iov_base = response;
+			iov[count].iov_len = processModbusMessage(response, frameSize);
+			count++;
+		}
+
+		if (offset > 0)
+		{
+			conn->rx_len -= offset;
+			memmove(conn->rx_buffer, conn->rx_buffer + offset, conn->rx_len);
+		}
+
+		if (count == 0)
 			break;
+
+		if (sendResponses(worker, conn, iov, count) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Reads what the client sent and answers the complete requests. Returns -1
+// if the connection must be closed
+//-----------------------------------------------------------------------------
+static int handleClient(struct server_worker *worker, struct connection *conn)
+{
+	int n = read(conn->fd, conn->rx_buffer + conn->rx_len, RX_BUFFER_SIZE - conn->rx_len);
+	if (n < 0 && (errno == EAGAIN || errno == EINTR))
+		return 0;
+
+	if (n <= 0)
+	{
+		// something has gone wrong or the client has closed connection
+		if (n == 0)
+			printf("Server: client ID: %d has closed the connection\n", conn->fd);
+		else
+			printf("Server: Something is wrong with the client ID: %d\n", conn->fd);
+		return -1;
+	}
+
+	conn->rx_len += n;
+	conn->last_activity = monotonicSeconds();
+
+	return processFrames(worker, conn);
+}
+
+//-----------------------------------------------------------------------------
+// Sends the responses left over by a partial write. Once they are all out,
+// goes back to reading requests. Returns -1 if the connection must be closed
+//-----------------------------------------------------------------------------
+static int flushClient(struct server_worker *worker, struct connection *conn)
+{
+	int n = write(conn->fd, conn->tx_buffer + conn->tx_sent, conn->tx_len - conn->tx_sent);
+	if (n < 0 && (errno == EAGAIN || errno == EINTR))
+		return 0;
+
+	if (n < 0)
+	{
+		printf("Server: could not send the response to client ID: %d\n", conn->fd);
+		return -1;
+	}
+
+	conn->tx_sent += n;
+	if (conn->tx_sent < conn->tx_len)
+		return 0;
+
+	conn->tx_len = 0;
+	conn->tx_sent = 0;
+	watchConnection(worker, conn, EPOLLIN);
+
+	//requests that arrived while the responses were pending
+	return processFrames(worker, conn);
+}
+
+//-----------------------------------------------------------------------------
+// Closes the connections of this worker that have been silent for longer than
+// the idle timeout
+//-----------------------------------------------------------------------------
+static void closeIdleConnections(struct server_worker *worker)
+{
+	time_t now = monotonicSeconds();
+
+	for (int i = 0; i < max_connections; i++)
+	{
+		struct connection *conn = &connections[i];
+		if (__atomic_load_n(&conn->worker, __ATOMIC_ACQUIRE) != worker->index + 1)
+			continue;
+
+		if (now - conn->last_activity >= idle_timeout)
+		{
+			printf("Server: closing idle client ID: %d\n", conn->fd);
+			closeConnection(worker, conn);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Event loop of a worker thread. Serves every connection assigned to it
+//-----------------------------------------------------------------------------
+static void *serverWorker(void *arg)
+{
+	struct server_worker *worker = (struct server_worker *)arg;
+	struct epoll_event events[MAX_EPOLL_EVENTS];
+	time_t last_check = monotonicSeconds();
+
+	while (1)
+	{
+		int n = epoll_wait(worker->epoll_fd, events, MAX_EPOLL_EVENTS, 1000);
+		if (n < 0 && errno != EINTR)
+		{
+			perror("Server: epoll_wait");
+			sleep_thread(100);
+		}
+
+		for (int i = 0; i < n; i++)
+		{
+			struct connection *conn = (struct connection *)events[i].data.ptr;
+
+			int ret;
+
+			if (events[i].events & (EPOLLERR | EPOLLHUP))
+				ret = -1;
+			else if (events[i].events & EPOLLOUT)
+				ret = flushClient(worker, conn);
+			else
+				ret = handleClient(worker, conn);
+
+			if (ret < 0)
+				closeConnection(worker, conn);
+		}
+
+		if (idle_timeout > 0 && monotonicSeconds() != last_check)
+		{
+			closeIdleConnections(worker);
+			last_check = monotonicSeconds();
 		}
+	}
+
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Reads the server settings from the configuration, allocates the connection
+// pool and starts the worker threads
+//-----------------------------------------------------------------------------
+static void initServer()
+{
+	int cpus[MAX_SERVER_WORKERS];
+
+	max_connections = configInt("modbus.max_connections", DEFAULT_MAX_CONNECTIONS);
+	idle_timeout = configInt("modbus.idle_timeout", DEFAULT_IDLE_TIMEOUT);
+	worker_count = configInt("modbus.workers", DEFAULT_WORKERS);
+	int cpu_count = parseIntList(configString("modbus.worker_cpus", ""), cpus, MAX_SERVER_WORKERS);
+
+	if (max_connections < 1) max_connections = 1;
+	if (worker_count < 1) worker_count = 1;
+	if (worker_count > MAX_SERVER_WORKERS) worker_count = MAX_SERVER_WORKERS;
 
-		processMessage(buffer, messageSize, client_fd);
+	//the whole pool is allocated here, so the memory used by the server does
+	//not grow with the number of clients
+	connections = (struct connection *)calloc(max_connections, sizeof(struct connection));
+	if (connections == NULL)
+	{
+		printf("Server: could not allocate %d connections\n", max_connections);
+		exit(1);
 	}
-	//printf("Debug: Closing client socket and calling pthread_exit in server.cpp\n");
-	close(client_fd);
-	pthread_exit(NULL);
+	for (int i = max_connections - 1; i >= 0; i--)
+	{
+		connections[i].next_free = free_connections;
+		free_connections = &connections[i];
+	}
+
+	for (int i = 0; i < worker_count; i++)
+	{
+		struct server_worker *worker = &workers[i];
+		worker->index = i;
+		worker->cpu = cpu_count > 0 ? cpus[i % cpu_count] : -1;
+		worker->epoll_fd = epoll_create(max_connections);
+		if (worker->epoll_fd < 0)
+		{
+			perror("Server: error creating epoll instance");
+			exit(1);
+		}
+
+		if (pthread_create(&worker->thread, NULL, serverWorker, worker) != 0)
+		{
+			printf("Server: could not create worker %d\n", i);
+			exit(1);
+		}
+		pthread_detach(worker->thread);
+
+		//modbus.worker_cpus pins each worker to its own CPU, inside the
+		//settings of the network class
+		setupThread(worker->thread, THREAD_CLASS_NETWORK, "modbus worker", -1);
+		if (worker->cpu >= 0)
+		{
+			cpu_set_t cpuset;
+			CPU_ZERO(&cpuset);
+			CPU_SET(worker->cpu, &cpuset);
+			if (pthread_setaffinity_np(worker->thread, sizeof(cpuset), &cpuset) != 0)
+				printf("WARNING: Failed to pin server worker %d to CPU %d\n", worker->index, worker->cpu);
+		}
+	}
+
+	printf("Server: %d workers, up to %d connections, idle timeout %d s\n", worker_count, max_connections, idle_timeout);
 }
 
 //-----------------------------------------------------------------------------
 // Function to start the server. It receives the port number as argument and
-// creates an infinite loop to listen and parse the messages sent by the
-// clients
+// creates an infinite loop to accept the clients and hand them to the workers
 //-----------------------------------------------------------------------------
 void startServer(int port)
 {
 	int socket_fd, client_fd;
+	int next_worker = 0;
 
+	initServer();
 	socket_fd = createSocket(port);
-	mapUnusedIO();
 
 	while(1)
 	{
@@ -166,21 +500,42 @@ void startServer(int port)
 		if (client_fd < 0)
 		{
 			printf("Server: Error accepting client!\n");
+			continue;
 		}
 
-		else
+		struct connection *conn = allocConnection();
+		if (conn == NULL)
 		{
-			int arguments[1];
-			pthread_t thread;
-                        int ret = -1;
-
-			printf("Server: Client accepted! Creating thread for the new client ID: %d...\n", client_fd);
-			arguments[0] = client_fd;
-			ret = pthread_create(&thread, NULL, handleConnections, arguments);
-			if (ret==0) 
-			{
-				pthread_detach(thread);
-			}
+			printf("Server: connection limit (%d) reached, rejecting client\n", max_connections);
+			close(client_fd);
+			continue;
+		}
+
+		int flags = fcntl(client_fd, F_GETFL, 0);
+		fcntl(client_fd, F_SETFL, flags | O_NONBLOCK);
+		int nodelay = 1;
+		setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+		struct server_worker *worker = &workers[next_worker];
+		next_worker = (next_worker + 1) % worker_count;
+
+		conn->fd = client_fd;
+		conn->last_activity = monotonicSeconds();
+		conn->rx_len = 0;
+		conn->tx_len = 0;
+		conn->tx_sent = 0;
+		__atomic_store_n(&conn->worker, worker->index + 1, __ATOMIC_RELEASE);
+
+		struct epoll_event event;
+		event.events = EPOLLIN;
+		event.data.ptr = conn;
+		if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, client_fd, &event) < 0)
+		{
+			perror("Server: error adding client to epoll");
+			closeConnection(worker, conn);
+			continue;
 		}
+
+		printf("Server: Client accepted! ID: %d on worker %d\n", client_fd, worker->index);
 	}
 }
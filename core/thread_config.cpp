@@ -0,0 +1,294 @@
+//-----------------------------------------------------------------------------
+// Copyright 2019 Novasom Industries
+//
+// Based on the software by Thiago Alves
+// This file is part of the OpenPLC Software Stack.
+//
+// OpenPLC is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenPLC is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenPLC.  If not, see <http://www.gnu.org/licenses/>.
+//------
+//
+// CPU affinity and scheduling of the runtime threads. Every thread belongs to
+// a class (scan, io, network, persistence, logging, watchdog) and gets the CPUs, the
+// policy and the priority of its class from novaplc.cfg:
+//
+//     thread.<class>.cpus = "3"        CPU list, blank for any CPU
+//     thread.<class>.policy = "fifo"   fifo, rr or other
+//     thread.<class>.priority = "30"   1..99 for fifo and rr
+//
+// The settings are applied by the thread creating the thread, right after
+// pthread_create(), and every result is kept for the report printed at the
+// end of the startup. The memory of the runtime is locked once the stacks
+// and the heap have been touched, so the scan never takes a page fault.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <alloca.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include "ladder.h"
+
+#define MAX_THREAD_REPORTS		64
+#define MAX_CLASS_CPUS			64
+
+//defaults, can be changed in novaplc.cfg
+#define DEFAULT_STACK_PREFAULT_KB	128
+#define DEFAULT_HEAP_PREFAULT_KB	1024
+
+struct thread_class
+{
+	const char *name;
+	int policy;
+	int priority;
+	int cpu_count; //0 if not pinned
+	int cpus[MAX_CLASS_CPUS];
+	char cpu_list[32];
+};
+
+struct thread_report
+{
+	char name[16];
+	int thread_class;
+	int policy;
+	int priority;
+	char error[48]; //empty if every setting was applied
+};
+
+//the scan thread keeps its historical priority of 30, with the edge capture
+//and the watchdog right above it and the task threads (1..29) below
+static struct thread_class thread_classes[THREAD_CLASS_COUNT] = {
+	{ "scan",        SCHED_FIFO,  30 },
+	{ "io",          SCHED_FIFO,  31 },
+	{ "network",     SCHED_OTHER, 0 },
+	{ "persistence", SCHED_OTHER, 0 },
+	{ "logging",     SCHED_OTHER, 0 },
+	{ "watchdog",    SCHED_FIFO,  32 },
+};
+
+static struct thread_report thread_reports[MAX_THREAD_REPORTS];
+static int report_count = 0;
+static pthread_mutex_t reportLock = PTHREAD_MUTEX_INITIALIZER;
+
+//-----------------------------------------------------------------------------
+// Helper function - Name of a scheduling policy
+//-----------------------------------------------------------------------------
+static const char *policyName(int policy)
+{
+	if (policy == SCHED_FIFO) return "fifo";
+	if (policy == SCHED_RR) return "rr";
+	return "other";
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Warns if a CPU of the scan thread is shared with another
+// pinned class or is not isolated from the kernel scheduler
+//-----------------------------------------------------------------------------
+static void checkScanIsolation()
+{
+	struct thread_class *scan = &thread_classes[THREAD_CLASS_SCAN];
+	int isolated[MAX_CLASS_CPUS];
+	int isolated_count = 0;
+	char line[256];
+
+	FILE *file = fopen("/sys/devices/system/cpu/isolated", "r");
+	if (file != NULL)
+	{
+		if (fgets(line, sizeof(line), file) != NULL)
+			isolated_count = parseIntList(line, isolated, MAX_CLASS_CPUS);
+		fclose(file);
+	}
+
+	for (int i = 0; i < scan->cpu_count; i++)
+	{
+		int cpu = scan->cpus[i];
+
+		bool is_isolated = false;
+		for (int j = 0; j < isolated_count; j++)
+			if (isolated[j] == cpu) is_isolated = true;
+		if (!is_isolated)
+			printf("WARNING: CPU %d of the scan thread is not isolated (boot with isolcpus=%d)\n", cpu, cpu);
+
+		for (int c = 0; c < THREAD_CLASS_COUNT; c++)
+		{
+			if (c == THREAD_CLASS_SCAN) continue;
+			for (int j = 0; j < thread_classes[c].cpu_count; j++)
+				if (thread_classes[c].cpus[j] == cpu)
+					printf("WARNING: CPU %d of the scan thread is also used by the %s threads\n", cpu, thread_classes[c].name);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Reads the settings of every thread class. Must be called after
+// loadRuntimeConfig() and before the threads are started
+//-----------------------------------------------------------------------------
+void loadThreadConfig()
+{
+	char key[64];
+
+	for (int c = 0; c < THREAD_CLASS_COUNT; c++)
+	{
+		struct thread_class *tc = &thread_classes[c];
+
+		snprintf(key, sizeof(key), "thread.%s.cpus", tc->name);
+		const char *cpus = configString(key, "");
+		tc->cpu_count = parseIntList(cpus, tc->cpus, MAX_CLASS_CPUS);
+		snprintf(tc->cpu_list, sizeof(tc->cpu_list), "%s", tc->cpu_count > 0 ? cpus : "any");
+
+		snprintf(key, sizeof(key), "thread.%s.policy", tc->name);
+		const char *policy = configString(key, policyName(tc->policy));
+		if (!strcmp(policy, "fifo"))
+			tc->policy = SCHED_FIFO;
+		else if (!strcmp(policy, "rr"))
+			tc->policy = SCHED_RR;
+		else if (!strcmp(policy, "other"))
+			tc->policy = SCHED_OTHER;
+		else
+			printf("WARNING: Unknown policy %s for the %s threads, keeping %s\n", policy, tc->name, policyName(tc->policy));
+
+		snprintf(key, sizeof(key), "thread.%s.priority", tc->name);
+		tc->priority = configInt(key, tc->priority);
+		if (tc->policy == SCHED_OTHER)
+			tc->priority = 0;
+	}
+
+	checkScanIsolation();
+}
+
+//-----------------------------------------------------------------------------
+// Applies the settings of its class to a thread. priority overrides the
+// priority of the class if it is not negative (the IEC tasks have their
+// own). Returns 0 if every setting was applied
+//-----------------------------------------------------------------------------
+int setupThread(pthread_t thread, int thread_class, const char *name, int priority)
+{
+	struct thread_class *tc = &thread_classes[thread_class];
+	struct thread_report report;
+	struct sched_param sp;
+	int ret;
+
+	memset(&report, 0, sizeof(report));
+	snprintf(report.name, sizeof(report.name), "%s", name);
+	report.thread_class = thread_class;
+	report.policy = tc->policy;
+	report.priority = tc->policy == SCHED_OTHER ? 0 : (priority >= 0 ? priority : tc->priority);
+
+	pthread_setname_np(thread, report.name);
+
+	if (tc->cpu_count > 0)
+	{
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+		for (int i = 0; i < tc->cpu_count; i++)
+			CPU_SET(tc->cpus[i], &cpuset);
+
+		ret = pthread_setaffinity_np(thread, sizeof(cpuset), &cpuset);
+		if (ret != 0)
+			snprintf(report.error, sizeof(report.error), "affinity %s: %s", tc->cpu_list, strerror(ret));
+	}
+
+	sp.sched_priority = report.priority;
+	ret = pthread_setschedparam(thread, report.policy, &sp);
+	if (ret != 0)
+	{
+		int len = strlen(report.error);
+		snprintf(report.error + len, sizeof(report.error) - len, "%s%s %d: %s",
+			len > 0 ? ", " : "", policyName(report.policy), report.priority, strerror(ret));
+	}
+
+	if (report.error[0] != '\0')
+		printf("WARNING: Thread %s: failed to set %s\n", report.name, report.error);
+
+	pthread_mutex_lock(&reportLock);
+	if (report_count < MAX_THREAD_REPORTS)
+		thread_reports[report_count++] = report;
+	pthread_mutex_unlock(&reportLock);
+
+	return report.error[0] == '\0' ? 0 : -1;
+}
+
+//-----------------------------------------------------------------------------
+// Touches rt.stack_prefault_kb of the stack of the calling thread, so the
+// pages are mapped (and locked) before the thread gets real-time work
+//-----------------------------------------------------------------------------
+void prefaultStack()
+{
+	int size = configInt("rt.stack_prefault_kb", DEFAULT_STACK_PREFAULT_KB) * 1024;
+	if (size <= 0)
+		return;
+
+	volatile unsigned char *stack = (volatile unsigned char *)alloca(size);
+	for (int i = 0; i < size; i += 4096)
+		stack[i] = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Touches the stack of the calling thread and rt.heap_prefault_kb of heap,
+// keeps the heap from being given back to the kernel and locks the memory.
+// Returns 0 if the memory was locked
+//-----------------------------------------------------------------------------
+int lockMemory()
+{
+	int heap_size = configInt("rt.heap_prefault_kb", DEFAULT_HEAP_PREFAULT_KB) * 1024;
+
+	//the blocks freed stay in the heap, and large blocks come from it too
+	//instead of from a new mmap() that would fault again
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+
+	if (heap_size > 0)
+	{
+		volatile unsigned char *heap = (volatile unsigned char *)malloc(heap_size);
+		if (heap != NULL)
+		{
+			for (int i = 0; i < heap_size; i += 4096)
+				heap[i] = 0;
+			free((void *)heap);
+		}
+	}
+	prefaultStack();
+
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+	{
+		printf("WARNING: Failed to lock memory: %s\n", strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Prints the settings of every thread set up so far, and the ones that could
+// not be applied
+//-----------------------------------------------------------------------------
+void printThreadReport()
+{
+	pthread_mutex_lock(&reportLock);
+	printf("Threads:\n");
+	for (int i = 0; i < report_count; i++)
+	{
+		struct thread_report *report = &thread_reports[i];
+		struct thread_class *tc = &thread_classes[report->thread_class];
+
+		printf("  %-16s %-12s cpus %-8s %-5s %2d  %s%s\n", report->name, tc->name, tc->cpu_list,
+			policyName(report->policy), report->priority,
+			report->error[0] != '\0' ? "FAILED " : "ok", report->error);
+	}
+	pthread_mutex_unlock(&reportLock);
+}
@@ -0,0 +1,171 @@
+//-----------------------------------------------------------------------------
+// Copyright 2019 Novasom Industries
+//
+// Based on the software by Thiago Alves
+// This file is part of the OpenPLC Software Stack.
+//
+// OpenPLC is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenPLC is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenPLC.  If not, see <http://www.gnu.org/licenses/>.
+//------
+//
+// Hierarchical timing wheel backing the TP, TON and TOF instances when the
+// runtime and the program are built with IEC_TIMER_WHEEL. A running instance
+// is linked in a slot of the wheel by __timer_wheel_start() and is marked
+// expired by advanceTimerWheel() at its tick, so the timers that are not
+// running cost nothing and the expiry costs O(1) per timer.
+//
+// The wheel has WHEEL_LEVELS levels of WHEEL_SLOTS slots. Level 0 has one
+// slot per common tick, each level above covers WHEEL_SLOTS times the range
+// of the one below, and its slots are moved down (cascaded) when the level
+// below wraps. With a 1 ms tick the 4 levels cover 49 days, longer timers
+// wait in the last level and are cascaded again.
+//
+// The wheel is only used with bufferLock held: the timers are started and
+// stopped by the program, and the scan thread advances the wheel after
+// updateTime().
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+
+#include "iec_types.h"
+#include "ladder.h"
+
+#ifdef IEC_TIMER_WHEEL
+
+#define WHEEL_BITS			8
+#define WHEEL_SLOTS			(1 << WHEEL_BITS)
+#define WHEEL_MASK			(WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS		4
+#define WHEEL_RANGE			(1ULL << (WHEEL_BITS * WHEEL_LEVELS))
+
+static IEC_TIMER *wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+
+//tick of the scan running now, the timers expire on the next ones
+static unsigned long long wheel_tick = 0;
+
+//-----------------------------------------------------------------------------
+// Helper function - Links a timer in the slot of its expiry tick
+//-----------------------------------------------------------------------------
+static void linkTimer(IEC_TIMER *timer)
+{
+	unsigned long long delta = timer->expires - wheel_tick;
+	unsigned long long expires = timer->expires;
+	int level = 0;
+
+	if (delta >= WHEEL_RANGE)
+	{
+		delta = WHEEL_RANGE - 1;
+		expires = wheel_tick + delta;
+	}
+	while (level < WHEEL_LEVELS - 1 && delta >= (1ULL << (WHEEL_BITS * (level + 1))))
+		level++;
+
+	IEC_TIMER **slot = &wheel[level][(expires >> (WHEEL_BITS * level)) & WHEEL_MASK];
+	timer->next = *slot;
+	if (*slot != NULL)
+		(*slot)->pprev = &timer->next;
+	timer->pprev = slot;
+	*slot = timer;
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Unlinks a timer from its slot
+//-----------------------------------------------------------------------------
+static void unlinkTimer(IEC_TIMER *timer)
+{
+	*timer->pprev = timer->next;
+	if (timer->next != NULL)
+		timer->next->pprev = timer->pprev;
+	timer->next = NULL;
+	timer->pprev = NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Moves the timers of a slot of an upper level to the
+// levels below. Returns the index of the slot
+//-----------------------------------------------------------------------------
+static int cascade(int level)
+{
+	int index = (wheel_tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+	IEC_TIMER *timer = wheel[level][index];
+
+	wheel[level][index] = NULL;
+	while (timer != NULL)
+	{
+		IEC_TIMER *next = timer->next;
+		linkTimer(timer);
+		timer = next;
+	}
+
+	return index;
+}
+
+//-----------------------------------------------------------------------------
+// Starts the timer of a TP, TON or TOF instance. It expires on the first
+// common tick where PT has elapsed, one tick from now at the earliest (the
+// instance sees it on its next call)
+//-----------------------------------------------------------------------------
+void __timer_wheel_start(IEC_TIMER *timer, IEC_TIME PT)
+{
+	long long pt_ns = (long long)__time_sec(PT) * 1000000000LL + __time_nsec(PT);
+	unsigned long long ticks = 1;
+
+	if (pt_ns > 0)
+		ticks = (pt_ns + common_ticktime__ - 1) / common_ticktime__;
+
+	if (timer->state == __TIMER_PENDING)
+		unlinkTimer(timer);
+
+	timer->expires = wheel_tick + ticks;
+	timer->state = __TIMER_PENDING;
+	linkTimer(timer);
+}
+
+//-----------------------------------------------------------------------------
+// Stops the timer of a TP, TON or TOF instance, pending or expired
+//-----------------------------------------------------------------------------
+void __timer_wheel_stop(IEC_TIMER *timer)
+{
+	if (timer->state == __TIMER_PENDING)
+		unlinkTimer(timer);
+	timer->state = __TIMER_IDLE;
+}
+
+//-----------------------------------------------------------------------------
+// Moves the wheel to the next common tick and marks the timers expiring on
+// it. Called by the scan thread after updateTime()
+//-----------------------------------------------------------------------------
+void advanceTimerWheel()
+{
+	pthread_mutex_lock(&bufferLock);
+	wheel_tick++;
+
+	int index = wheel_tick & WHEEL_MASK;
+	for (int level = 1; index == 0 && level < WHEEL_LEVELS; level++)
+		index = cascade(level);
+
+	IEC_TIMER **slot = &wheel[0][wheel_tick & WHEEL_MASK];
+	IEC_TIMER *timer = *slot;
+	*slot = NULL;
+	while (timer != NULL)
+	{
+		IEC_TIMER *next = timer->next;
+		timer->next = NULL;
+		timer->pprev = NULL;
+		timer->state = __TIMER_EXPIRED;
+		timer = next;
+	}
+	pthread_mutex_unlock(&bufferLock);
+}
+
+#endif
@@ -0,0 +1,307 @@
+//-----------------------------------------------------------------------------
+// Copyright 2019 Novasom Industries
+//
+// Based on the software by Thiago Alves
+// This file is part of the OpenPLC Software Stack.
+//
+// OpenPLC is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenPLC is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenPLC.  If not, see <http://www.gnu.org/licenses/>.
+//------
+//
+// Scan cycle watchdog. Two kinds of faults are handled, each with its own
+// policy (log, skip, safe or restart):
+//
+//  - overruns: a cycle that ends after the next deadline is minor, or major
+//    if it is late by more than watchdog.major_percent of the period. The
+//    scan thread classifies it and applies the policy itself.
+//  - hung scan: after every cycle the scan thread stores the time by which
+//    the next cycle must be over (the heartbeat). A supervisor thread woken
+//    by a timerfd four times per watchdog.timeout_us applies the hung policy
+//    when the heartbeat is older than the timeout. The timeout defaults to
+//    4/5 of the period, so with the checks a hung scan is caught at most
+//    one period after the deadline it missed.
+//
+// The restarts are counted in NOVAPLC_RESTARTS. Past watchdog.max_restarts
+// the restart policy falls back to safe, so a program that overruns on
+// every cycle does not restart forever.
+//
+// The scan thread never prints: it only counts, and the supervisor logs the
+// counters once per second when they change.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/timerfd.h>
+
+#include "ladder.h"
+
+#define WATCHDOG_MINOR			0
+#define WATCHDOG_MAJOR			1
+#define WATCHDOG_HUNG			2
+#define WATCHDOG_SEVERITIES		3
+
+#define WATCHDOG_MIN_CHECK_NS	100000ULL //100 us
+
+//defaults, can be changed in novaplc.cfg
+#define DEFAULT_MAJOR_PERCENT	100
+#define DEFAULT_TIMEOUT_PERCENT	80 //timeout + timeout / 4 is one period
+#define DEFAULT_MAX_RESTARTS	3
+
+//set when the outputs have been driven low, cleared by START
+int outputs_safe = 0;
+
+static const char *severity_names[WATCHDOG_SEVERITIES] = { "minor", "major", "hung" };
+static const char *action_names[] = { "none", "log", "skip", "safe", "restart" };
+static int policies[WATCHDOG_SEVERITIES] = { WATCHDOG_LOG, WATCHDOG_LOG, WATCHDOG_LOG };
+
+static unsigned long long period_ns;
+static int64_t major_ns;
+static uint64_t timeout_ns;
+static char **restart_argv;
+static int max_restarts = DEFAULT_MAX_RESTARTS;
+
+//written by the scan thread only
+static uint64_t heartbeat_ns = 0; //0 until the first cycle
+static uint64_t overrun_counts[WATCHDOG_SEVERITIES];
+static uint64_t worst_late_ns;
+
+//-----------------------------------------------------------------------------
+// Helper function - Monotonic time in nanoseconds
+//-----------------------------------------------------------------------------
+static inline uint64_t timespecNs(struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Reads the policy of a severity from the configuration
+//-----------------------------------------------------------------------------
+static void loadPolicy(int severity, const char *key)
+{
+	const char *name = configString(key, action_names[policies[severity]]);
+
+	for (int action = WATCHDOG_NONE; action <= WATCHDOG_RESTART; action++)
+	{
+		if (!strcmp(name, action_names[action]))
+		{
+			policies[severity] = action;
+			return;
+		}
+	}
+	printf("WARNING: Unknown watchdog policy %s for %s, keeping %s\n", name, key, action_names[policies[severity]]);
+}
+
+//-----------------------------------------------------------------------------
+// Drives the outputs low and pauses the program. The outputs stay low until
+// the next START
+//-----------------------------------------------------------------------------
+void watchdogSafeState()
+{
+	__atomic_store_n(&outputs_safe, 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&plc_state, PLC_STATE_PAUSED, __ATOMIC_RELEASE);
+	emergency_stop();
+}
+
+//-----------------------------------------------------------------------------
+// Drives the outputs low and starts the runtime again with the same
+// arguments. The RETAIN variables and the holding registers are restored
+// from the store, and the program runs as soon as it is ready. Once
+// watchdog.max_restarts is reached the safe state is applied instead
+//-----------------------------------------------------------------------------
+void watchdogRestart()
+{
+	char restarts[16];
+	const char *previous = getenv("NOVAPLC_RESTARTS");
+	int count = previous != NULL ? atoi(previous) : 0;
+
+	if (count >= max_restarts)
+	{
+		printf("Watchdog: %d restarts, safe state instead\n", count);
+		watchdogSafeState();
+		return;
+	}
+
+	emergency_stop();
+
+	snprintf(restarts, sizeof(restarts), "%d", count + 1);
+	setenv("NOVAPLC_RESTARTS", restarts, 1);
+
+	//the sockets and the stores are opened again by the new image
+	int max_fd = sysconf(_SC_OPEN_MAX);
+	for (int fd = 3; fd < max_fd; fd++)
+		close(fd);
+
+	execv("/proc/self/exe", restart_argv);
+	_exit(1);
+}
+
+//-----------------------------------------------------------------------------
+// Called by the scan thread with the result of scanCycleEnd(). Counts the
+// overrun and returns the action the scan thread must take
+//-----------------------------------------------------------------------------
+int watchdogOverrun(int64_t late_ns)
+{
+	if (late_ns <= 0)
+		return WATCHDOG_NONE;
+
+	int severity = late_ns > major_ns ? WATCHDOG_MAJOR : WATCHDOG_MINOR;
+	__atomic_store_n(&overrun_counts[severity], overrun_counts[severity] + 1, __ATOMIC_RELAXED);
+	if ((uint64_t)late_ns > worst_late_ns)
+		__atomic_store_n(&worst_late_ns, (uint64_t)late_ns, __ATOMIC_RELAXED);
+
+	return policies[severity];
+}
+
+//-----------------------------------------------------------------------------
+// Called by the scan thread once per cycle, with the deadline it is going to
+// wake up at. The next cycle must be over one period later
+//-----------------------------------------------------------------------------
+void watchdogKick(struct timespec *deadline)
+{
+	__atomic_store_n(&heartbeat_ns, timespecNs(deadline) + period_ns, __ATOMIC_RELEASE);
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Logs the overruns counted since the last call
+//-----------------------------------------------------------------------------
+static void logOverruns(uint64_t *logged)
+{
+	for (int severity = WATCHDOG_MINOR; severity <= WATCHDOG_MAJOR; severity++)
+	{
+		uint64_t count = __atomic_load_n(&overrun_counts[severity], __ATOMIC_RELAXED);
+		if (count != logged[severity] && policies[severity] != WATCHDOG_NONE)
+		{
+			printf("Watchdog: %llu %s overruns (worst %llu us late), %s\n",
+				(unsigned long long)(count - logged[severity]), severity_names[severity],
+				(unsigned long long)__atomic_load_n(&worst_late_ns, __ATOMIC_RELAXED) / 1000,
+				action_names[policies[severity]]);
+		}
+		logged[severity] = count;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Main function for the supervisor thread
+//-----------------------------------------------------------------------------
+static void *watchdogThread(void *arg)
+{
+	int timer_fd = (int)(long)arg;
+	uint64_t logged[WATCHDOG_SEVERITIES] = { 0 };
+	uint64_t last_log_ns = 0;
+	uint64_t hung_since_ns = 0;
+
+	prefaultStack();
+	while (1)
+	{
+		uint64_t expirations;
+		if (read(timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EINTR)
+		{
+			perror("Watchdog: error reading the timer");
+			return NULL;
+		}
+
+		struct timespec now_ts;
+		clock_gettime(CLOCK_MONOTONIC, &now_ts);
+		uint64_t now = timespecNs(&now_ts);
+		uint64_t heartbeat = __atomic_load_n(&heartbeat_ns, __ATOMIC_ACQUIRE);
+
+		if (heartbeat != 0 && now > heartbeat + timeout_ns && policies[WATCHDOG_HUNG] != WATCHDOG_NONE)
+		{
+			if (hung_since_ns == 0)
+			{
+				hung_since_ns = heartbeat;
+				overrun_counts[WATCHDOG_HUNG]++;
+
+				if (policies[WATCHDOG_HUNG] == WATCHDOG_SAFE)
+					watchdogSafeState();
+				else if (policies[WATCHDOG_HUNG] == WATCHDOG_RESTART)
+				{
+					printf("Watchdog: scan hung for %llu us, restarting\n", (unsigned long long)(now - heartbeat) / 1000);
+					watchdogRestart(); //only returns when the restarts are exhausted
+				}
+				else
+					printf("Watchdog: scan hung for %llu us, %s\n", (unsigned long long)(now - heartbeat) / 1000,
+						action_names[policies[WATCHDOG_HUNG]]);
+			}
+		}
+		else if (hung_since_ns != 0)
+		{
+			printf("Watchdog: scan resumed after %llu us\n", (unsigned long long)(now - hung_since_ns) / 1000);
+			hung_since_ns = 0;
+		}
+
+		if (now - last_log_ns >= 1000000000ULL)
+		{
+			logOverruns(logged);
+			last_log_ns = now;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Reads the policies and starts the supervisor thread. argv is used to start
+// the runtime again with the restart policy
+//-----------------------------------------------------------------------------
+void startWatchdog(char **argv, unsigned long long period)
+{
+	restart_argv = argv;
+	period_ns = period;
+	major_ns = (int64_t)period * configInt("watchdog.major_percent", DEFAULT_MAJOR_PERCENT) / 100;
+	timeout_ns = configInt("watchdog.timeout_us", (int)(period * DEFAULT_TIMEOUT_PERCENT / 100 / 1000)) * 1000ULL;
+	max_restarts = configInt("watchdog.max_restarts", DEFAULT_MAX_RESTARTS);
+
+	loadPolicy(WATCHDOG_MINOR, "watchdog.minor");
+	loadPolicy(WATCHDOG_MAJOR, "watchdog.major");
+	loadPolicy(WATCHDOG_HUNG, "watchdog.hung");
+	if (policies[WATCHDOG_HUNG] == WATCHDOG_SKIP)
+	{
+		printf("WARNING: A hung scan can't be skipped, logging it instead\n");
+		policies[WATCHDOG_HUNG] = WATCHDOG_LOG;
+	}
+
+	//the supervisor also logs the overruns
+	if (policies[WATCHDOG_MINOR] == WATCHDOG_NONE && policies[WATCHDOG_MAJOR] == WATCHDOG_NONE &&
+		policies[WATCHDOG_HUNG] == WATCHDOG_NONE)
+		return;
+
+	uint64_t check_ns = timeout_ns / 4;
+	if (check_ns < WATCHDOG_MIN_CHECK_NS) check_ns = WATCHDOG_MIN_CHECK_NS;
+
+	int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	struct itimerspec spec;
+	spec.it_interval.tv_sec = check_ns / 1000000000ULL;
+	spec.it_interval.tv_nsec = check_ns % 1000000000ULL;
+	spec.it_value = spec.it_interval;
+	if (timer_fd < 0 || timerfd_settime(timer_fd, 0, &spec, NULL) < 0)
+	{
+		perror("Watchdog: error creating the timer");
+		return;
+	}
+
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, watchdogThread, (void *)(long)timer_fd) != 0)
+	{
+		printf("Watchdog: could not create the thread\n");
+		return;
+	}
+	setupThread(thread, THREAD_CLASS_WATCHDOG, "watchdog", -1);
+
+	printf("Watchdog: minor %s, major (> %lld us late) %s, hung (> %llu us) %s\n",
+		action_names[policies[WATCHDOG_MINOR]], (long long)major_ns / 1000, action_names[policies[WATCHDOG_MAJOR]],
+		(unsigned long long)timeout_ns / 1000, action_names[policies[WATCHDOG_HUNG]]);
+}
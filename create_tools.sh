@@ -42,6 +42,18 @@ if [ "$VAR" = "3" ]; then
 	TARGET_ARC="arm64"
 	BOARD_TYPE="NOVASOM_M7"
 fi
+# IEC_TIME_NS=1 ./create_tools.sh builds TIME, DATE, TOD and DT as a 64 bit count of nanoseconds
+if [ "$IEC_TIME_NS" = "1" ]; then
+	ARMGCC="${ARMGCC} -DIEC_TIME_NS"
+fi
+# IEC_TIMER_WHEEL=1 ./create_tools.sh runs TP, TON and TOF on the timing wheel of the runtime
+if [ "$IEC_TIMER_WHEEL" = "1" ]; then
+	ARMGCC="${ARMGCC} -DIEC_TIMER_WHEEL"
+fi
+# IEC_NO_FORCING=1 ./create_tools.sh leaves the force flags out of the variables, forcing is done by the runtime
+if [ "$IEC_NO_FORCING" = "1" ]; then
+	ARMGCC="${ARMGCC} -DIEC_NO_FORCING"
+fi
 ! [ -d tools ] && mkdir tools
 if ! [ -d ${REFERENCE_FILESYSTEM} ]; then
 	echo "Please select an existing file system as base file system"
@@ -71,7 +83,7 @@ cd ..
 cd core
 echo "Generating executables ... "
 ../tools/st_optimizer ../st/st_file.st ../st/out.st >/dev/null 2>&1
-../tools/iec2c -I ../lib ../st/out.st >/dev/null 2>&1
+../tools/iec2c -O b -I ../lib ../st/out.st >/dev/null 2>&1
 ARCH=${TARGET_ARC} ${ARMGCC} -I./lib -c Config0.c -lasiodnp3 -lasiopal -lopendnp3 -lopenpal >/dev/null 2>&1
 ARCH=${TARGET_ARC} ${ARMGCC} -I./lib -c Res0.c -lasiodnp3 -lasiopal -lopendnp3 -lopenpal >/dev/null 2>&1
 ../tools/glue_generator
@@ -79,4 +91,5 @@ echo "ARCH=${TARGET_ARC} ${ARMGCC} *.cpp *.o -o ../novaplc -D${BOARD_TYPE} -I./l
 ARCH=${TARGET_ARC} ${ARMGCC} *.cpp *.o -o ../novaplc -D${BOARD_TYPE} -I./lib -lrt -lpthread -lmodbus -fpermissive -I${REFERENCE_FILESYSTEM}/output/host/arm-buildroot-linux-gnueabihf/sysroot/usr/include/modbus
 cd ..
 ARCH=${TARGET_ARC} ${ARMGCC} writefifo.c -o  writefifo >/dev/null 2>&1
+ARCH=${TARGET_ARC} ${ARMGCC} src/modbus_bench.cpp -o modbus_bench -lpthread -lrt >/dev/null 2>&1
 echo "Done"
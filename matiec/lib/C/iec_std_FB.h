@@ -13,6 +13,9 @@
  *             e.g.:   static void R_TRIG_init__(...)
  *                     ^^^^^^
  * 
+ * NOTE: The FBNAME_retain__() functions are the ones generated with the -O b option, they hand the
+ *       RETAIN variables of an instance to the backup/restore functions of the configuration.
+ *
  * NOTE: If the structure of the C code generated by iec2c (matiec) should change, then this C 'library'
  *       file will need to be recompiled. 
  *       The correct way of going about this would be to have this file be automatically generated during
@@ -383,6 +386,9 @@ typedef struct {
   __DECLARE_VAR(BOOL,PREV_IN)
   __DECLARE_VAR(TIME,CURRENT_TIME)
   __DECLARE_VAR(TIME,START_TIME)
+#ifdef IEC_TIMER_WHEEL
+  IEC_TIMER WHEEL;
+#endif
 
 } TP;
 
@@ -402,6 +408,9 @@ typedef struct {
   __DECLARE_VAR(BOOL,PREV_IN)
   __DECLARE_VAR(TIME,CURRENT_TIME)
   __DECLARE_VAR(TIME,START_TIME)
+#ifdef IEC_TIMER_WHEEL
+  IEC_TIMER WHEEL;
+#endif
 
 } TON;
 
@@ -421,6 +430,9 @@ typedef struct {
   __DECLARE_VAR(BOOL,PREV_IN)
   __DECLARE_VAR(TIME,CURRENT_TIME)
   __DECLARE_VAR(TIME,START_TIME)
+#ifdef IEC_TIMER_WHEEL
+  IEC_TIMER WHEEL;
+#endif
 
 } TOF;
 
@@ -568,6 +580,12 @@ static void R_TRIG_init__(R_TRIG *data__, BOOL retain) {
   __INIT_VAR(data__->M,__BOOL_LITERAL(FALSE),1)
 }
 
+static void R_TRIG_retain__(R_TRIG *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->CLK)
+  __RETAIN_VAR(data__->Q)
+  __RETAIN_VAR(data__->M)
+}
+
 // Code part
 static void R_TRIG_body__(R_TRIG *data__) {
   // Control execution
@@ -601,6 +619,12 @@ static void F_TRIG_init__(F_TRIG *data__, BOOL retain) {
   __INIT_VAR(data__->M,__BOOL_LITERAL(FALSE),1)
 }
 
+static void F_TRIG_retain__(F_TRIG *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->CLK)
+  __RETAIN_VAR(data__->Q)
+  __RETAIN_VAR(data__->M)
+}
+
 // Code part
 static void F_TRIG_body__(F_TRIG *data__) {
   // Control execution
@@ -634,6 +658,12 @@ static void SR_init__(SR *data__, BOOL retain) {
   __INIT_VAR(data__->Q1,__BOOL_LITERAL(FALSE),retain)
 }
 
+static void SR_retain__(SR *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->S1)
+  __RETAIN_VAR(data__->R)
+  __RETAIN_VAR(data__->Q1)
+}
+
 // Code part
 static void SR_body__(SR *data__) {
   // Control execution
@@ -666,6 +696,12 @@ static void RS_init__(RS *data__, BOOL retain) {
   __INIT_VAR(data__->Q1,__BOOL_LITERAL(FALSE),retain)
 }
 
+static void RS_retain__(RS *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->S)
+  __RETAIN_VAR(data__->R1)
+  __RETAIN_VAR(data__->Q1)
+}
+
 // Code part
 static void RS_body__(RS *data__) {
   // Control execution
@@ -701,6 +737,15 @@ static void CTU_init__(CTU *data__, BOOL retain) {
   R_TRIG_init__(&data__->CU_T,retain);
 }
 
+static void CTU_retain__(CTU *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->CU)
+  __RETAIN_VAR(data__->R)
+  __RETAIN_VAR(data__->PV)
+  __RETAIN_VAR(data__->Q)
+  __RETAIN_VAR(data__->CV)
+  __RETAIN_FB(R_TRIG,data__->CU_T)
+}
+
 // Code part
 static void CTU_body__(CTU *data__) {
   // Control execution
@@ -743,6 +788,15 @@ static void CTU_DINT_init__(CTU_DINT *data__, BOOL retain) {
   R_TRIG_init__(&data__->CU_T,retain);
 }
 
+static void CTU_DINT_retain__(CTU_DINT *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->CU)
+  __RETAIN_VAR(data__->R)
+  __RETAIN_VAR(data__->PV)
+  __RETAIN_VAR(data__->Q)
+  __RETAIN_VAR(data__->CV)
+  __RETAIN_FB(R_TRIG,data__->CU_T)
+}
+
 // Code part
 static void CTU_DINT_body__(CTU_DINT *data__) {
   // Control execution
@@ -785,6 +839,15 @@ static void CTU_LINT_init__(CTU_LINT *data__, BOOL retain) {
   R_TRIG_init__(&data__->CU_T,retain);
 }
 
+static void CTU_LINT_retain__(CTU_LINT *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->CU)
+  __RETAIN_VAR(data__->R)
+  __RETAIN_VAR(data__->PV)
+  __RETAIN_VAR(data__->Q)
+  __RETAIN_VAR(data__->CV)
+  __RETAIN_FB(R_TRIG,data__->CU_T)
+}
+
 // Code part
 static void CTU_LINT_body__(CTU_LINT *data__) {
   // Control execution
@@ -827,6 +890,15 @@ static void CTU_UDINT_init__(CTU_UDINT *data__, BOOL retain) {
   R_TRIG_init__(&data__->CU_T,retain);
 }
 
+static void CTU_UDINT_retain__(CTU_UDINT *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->CU)
+  __RETAIN_VAR(data__->R)
+  __RETAIN_VAR(data__->PV)
+  __RETAIN_VAR(data__->Q)
+  __RETAIN_VAR(data__->CV)
+  __RETAIN_FB(R_TRIG,data__->CU_T)
+}
+
 // Code part
 static void CTU_UDINT_body__(CTU_UDINT *data__) {
   // Control execution
@@ -869,6 +941,15 @@ static void CTU_ULINT_init__(CTU_ULINT *data__, BOOL retain) {
   R_TRIG_init__(&data__->CU_T,retain);
 }
 
+static void CTU_ULINT_retain__(CTU_ULINT *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->CU)
+  __RETAIN_VAR(data__->R)
+  __RETAIN_VAR(data__->PV)
+  __RETAIN_VAR(data__->Q)
+  __RETAIN_VAR(data__->CV)
+  __RETAIN_FB(R_TRIG,data__->CU_T)
+}
+
 // Code part
 static void CTU_ULINT_body__(CTU_ULINT *data__) {
   // Control execution
@@ -911,6 +992,15 @@ static void CTD_init__(CTD *data__, BOOL retain) {
   R_TRIG_init__(&data__->CD_T,retain);
 }
 
+static void CTD_retain__(CTD *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->CD)
+  __RETAIN_VAR(data__->LD)
+  __RETAIN_VAR(data__->PV)
+  __RETAIN_VAR(data__->Q)
+  __RETAIN_VAR(data__->CV)
+  __RETAIN_FB(R_TRIG,data__->CD_T)
+}
+
 // Code part
 static void CTD_body__(CTD *data__) {
   // Control execution
@@ -953,6 +1043,15 @@ static void CTD_DINT_init__(CTD_DINT *data__, BOOL retain) {
   R_TRIG_init__(&data__->CD_T,retain);
 }
 
+static void CTD_DINT_retain__(CTD_DINT *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->CD)
+  __RETAIN_VAR(data__->LD)
+  __RETAIN_VAR(data__->PV)
+  __RETAIN_VAR(data__->Q)
+  __RETAIN_VAR(data__->CV)
+  __RETAIN_FB(R_TRIG,data__->CD_T)
+}
+
 // Code part
 static void CTD_DINT_body__(CTD_DINT *data__) {
   // Control execution
@@ -995,6 +1094,15 @@ static void CTD_LINT_init__(CTD_LINT *data__, BOOL retain) {
   R_TRIG_init__(&data__->CD_T,retain);
 }
 
+static void CTD_LINT_retain__(CTD_LINT *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->CD)
+  __RETAIN_VAR(data__->LD)
+  __RETAIN_VAR(data__->PV)
+  __RETAIN_VAR(data__->Q)
+  __RETAIN_VAR(data__->CV)
+  __RETAIN_FB(R_TRIG,data__->CD_T)
+}
+
 // Code part
 static void CTD_LINT_body__(CTD_LINT *data__) {
   // Control execution
@@ -1037,6 +1145,15 @@ static void CTD_UDINT_init__(CTD_UDINT *data__, BOOL retain) {
   R_TRIG_init__(&data__->CD_T,retain);
 }
 
+static void CTD_UDINT_retain__(CTD_UDINT *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->CD)
+  __RETAIN_VAR(data__->LD)
+  __RETAIN_VAR(data__->PV)
+  __RETAIN_VAR(data__->Q)
+  __RETAIN_VAR(data__->CV)
+  __RETAIN_FB(R_TRIG,data__->CD_T)
+}
+
 // Code part
 static void CTD_UDINT_body__(CTD_UDINT *data__) {
   // Control execution
@@ -1079,6 +1196,15 @@ static void CTD_ULINT_init__(CTD_ULINT *data__, BOOL retain) {
   R_TRIG_init__(&data__->CD_T,retain);
 }
 
+static void CTD_ULINT_retain__(CTD_ULINT *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->CD)
+  __RETAIN_VAR(data__->LD)
+  __RETAIN_VAR(data__->PV)
+  __RETAIN_VAR(data__->Q)
+  __RETAIN_VAR(data__->CV)
+  __RETAIN_FB(R_TRIG,data__->CD_T)
+}
+
 // Code part
 static void CTD_ULINT_body__(CTD_ULINT *data__) {
   // Control execution
@@ -1125,6 +1251,19 @@ static void CTUD_init__(CTUD *data__, BOOL retain) {
   R_TRIG_init__(&data__->CU_T,retain);
 }
 
+static void CTUD_retain__(CTUD *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->CU)
+  __RETAIN_VAR(data__->CD)
+  __RETAIN_VAR(data__->R)
+  __RETAIN_VAR(data__->LD)
+  __RETAIN_VAR(data__->PV)
+  __RETAIN_VAR(data__->QU)
+  __RETAIN_VAR(data__->QD)
+  __RETAIN_VAR(data__->CV)
+  __RETAIN_FB(R_TRIG,data__->CD_T)
+  __RETAIN_FB(R_TRIG,data__->CU_T)
+}
+
 // Code part
 static void CTUD_body__(CTUD *data__) {
   // Control execution
@@ -1182,6 +1321,19 @@ static void CTUD_DINT_init__(CTUD_DINT *data__, BOOL retain) {
   R_TRIG_init__(&data__->CU_T,retain);
 }
 
+static void CTUD_DINT_retain__(CTUD_DINT *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->CU)
+  __RETAIN_VAR(data__->CD)
+  __RETAIN_VAR(data__->R)
+  __RETAIN_VAR(data__->LD)
+  __RETAIN_VAR(data__->PV)
+  __RETAIN_VAR(data__->QU)
+  __RETAIN_VAR(data__->QD)
+  __RETAIN_VAR(data__->CV)
+  __RETAIN_FB(R_TRIG,data__->CD_T)
+  __RETAIN_FB(R_TRIG,data__->CU_T)
+}
+
 // Code part
 static void CTUD_DINT_body__(CTUD_DINT *data__) {
   // Control execution
@@ -1239,6 +1391,19 @@ static void CTUD_LINT_init__(CTUD_LINT *data__, BOOL retain) {
   R_TRIG_init__(&data__->CU_T,retain);
 }
 
+static void CTUD_LINT_retain__(CTUD_LINT *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->CU)
+  __RETAIN_VAR(data__->CD)
+  __RETAIN_VAR(data__->R)
+  __RETAIN_VAR(data__->LD)
+  __RETAIN_VAR(data__->PV)
+  __RETAIN_VAR(data__->QU)
+  __RETAIN_VAR(data__->QD)
+  __RETAIN_VAR(data__->CV)
+  __RETAIN_FB(R_TRIG,data__->CD_T)
+  __RETAIN_FB(R_TRIG,data__->CU_T)
+}
+
 // Code part
 static void CTUD_LINT_body__(CTUD_LINT *data__) {
   // Control execution
@@ -1296,6 +1461,19 @@ static void CTUD_UDINT_init__(CTUD_UDINT *data__, BOOL retain) {
   R_TRIG_init__(&data__->CU_T,retain);
 }
 
+static void CTUD_UDINT_retain__(CTUD_UDINT *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->CU)
+  __RETAIN_VAR(data__->CD)
+  __RETAIN_VAR(data__->R)
+  __RETAIN_VAR(data__->LD)
+  __RETAIN_VAR(data__->PV)
+  __RETAIN_VAR(data__->QU)
+  __RETAIN_VAR(data__->QD)
+  __RETAIN_VAR(data__->CV)
+  __RETAIN_FB(R_TRIG,data__->CD_T)
+  __RETAIN_FB(R_TRIG,data__->CU_T)
+}
+
 // Code part
 static void CTUD_UDINT_body__(CTUD_UDINT *data__) {
   // Control execution
@@ -1353,6 +1531,19 @@ static void CTUD_ULINT_init__(CTUD_ULINT *data__, BOOL retain) {
   R_TRIG_init__(&data__->CU_T,retain);
 }
 
+static void CTUD_ULINT_retain__(CTUD_ULINT *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->CU)
+  __RETAIN_VAR(data__->CD)
+  __RETAIN_VAR(data__->R)
+  __RETAIN_VAR(data__->LD)
+  __RETAIN_VAR(data__->PV)
+  __RETAIN_VAR(data__->QU)
+  __RETAIN_VAR(data__->QD)
+  __RETAIN_VAR(data__->CV)
+  __RETAIN_FB(R_TRIG,data__->CD_T)
+  __RETAIN_FB(R_TRIG,data__->CU_T)
+}
+
 // Code part
 static void CTUD_ULINT_body__(CTUD_ULINT *data__) {
   // Control execution
@@ -1395,6 +1586,41 @@ __end:
 
 
 
+#ifdef IEC_TIMER_WHEEL
+/* TP, TON and TOF backed by the timing wheel of the runtime, for programs with many timers.
+ * The instance is put in the wheel on the edge of IN that starts it, and the wheel marks it
+ * expired at the first common tick where START_TIME + PT is reached. An idle instance only
+ * tests IN and STATE, and a running one updates ET and compares PT with the PT it was armed
+ * with: there is no time copy and no other time comparison on each call.
+ * A running instance whose PT changed, or restored from its RETAIN variables, is put back in
+ * the wheel for the rest of PT, and expires at once if ET already reached PT.
+ */
+#define __INIT_TIMER(timer) {(timer).next = NULL; (timer).pprev = NULL; (timer).expires = 0; (timer).pt = __time_to_timespec(1, 0, 0, 0, 0, 0); (timer).state = __TIMER_IDLE;}
+
+#define __TIMER_WHEEL_START(data__)\
+  data__->WHEEL.pt = __GET_VAR(data__->PT,);\
+  __timer_wheel_start(&data__->WHEEL, data__->WHEEL.pt);
+
+#define __TIMER_WHEEL_REARM(data__)\
+  data__->WHEEL.pt = __GET_VAR(data__->PT,);\
+  if (__time_cmp(data__->WHEEL.pt, __GET_VAR(data__->ET,)) > 0) {\
+    __timer_wheel_start(&data__->WHEEL, __time_sub(data__->WHEEL.pt, __GET_VAR(data__->ET,)));\
+  } else {\
+    __timer_wheel_stop(&data__->WHEEL);\
+    data__->WHEEL.state = __TIMER_EXPIRED;\
+  }
+
+#define __TIMER_WHEEL_UPDATE_ET(data__)\
+  if (data__->WHEEL.state == __TIMER_IDLE) {\
+    __SET_VAR(data__->,START_TIME,,__time_sub(__CURRENT_TIME, __GET_VAR(data__->ET,)));\
+    __TIMER_WHEEL_REARM(data__)\
+  }\
+  __SET_VAR(data__->,ET,,__time_sub(__CURRENT_TIME, __GET_VAR(data__->START_TIME,)));\
+  if (__time_cmp(data__->WHEEL.pt, __GET_VAR(data__->PT,)) != 0) {\
+    __TIMER_WHEEL_REARM(data__)\
+  }
+#endif
+
 static void TP_init__(TP *data__, BOOL retain) {
   __INIT_VAR(data__->EN,__BOOL_LITERAL(TRUE),retain)
   __INIT_VAR(data__->ENO,__BOOL_LITERAL(TRUE),retain)
@@ -1406,9 +1632,61 @@ static void TP_init__(TP *data__, BOOL retain) {
   __INIT_VAR(data__->PREV_IN,__BOOL_LITERAL(FALSE),retain)
   __INIT_VAR(data__->CURRENT_TIME,__time_to_timespec(1, 0, 0, 0, 0, 0),retain)
   __INIT_VAR(data__->START_TIME,__time_to_timespec(1, 0, 0, 0, 0, 0),retain)
+#ifdef IEC_TIMER_WHEEL
+  __INIT_TIMER(data__->WHEEL)
+#endif
+}
+
+static void TP_retain__(TP *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->IN)
+  __RETAIN_VAR(data__->PT)
+  __RETAIN_VAR(data__->Q)
+  __RETAIN_VAR(data__->ET)
+  __RETAIN_VAR(data__->STATE)
+  __RETAIN_VAR(data__->PREV_IN)
+  __RETAIN_VAR(data__->CURRENT_TIME)
+  __RETAIN_VAR(data__->START_TIME)
 }
 
 // Code part
+#ifdef IEC_TIMER_WHEEL
+static void TP_body__(TP *data__) {
+  // Control execution
+  if (!__GET_VAR(data__->EN)) {
+    __SET_VAR(data__->,ENO,,__BOOL_LITERAL(FALSE));
+    return;
+  }
+  else {
+    __SET_VAR(data__->,ENO,,__BOOL_LITERAL(TRUE));
+  }
+  // Initialise TEMP variables
+
+  if ((((__GET_VAR(data__->STATE,) == 0) && !(__GET_VAR(data__->PREV_IN,))) && __GET_VAR(data__->IN,))) {
+    __SET_VAR(data__->,STATE,,1);
+    __SET_VAR(data__->,Q,,__BOOL_LITERAL(TRUE));
+    __SET_VAR(data__->,START_TIME,,__CURRENT_TIME);
+    __TIMER_WHEEL_START(data__)
+  } else if ((__GET_VAR(data__->STATE,) == 1)) {
+    __TIMER_WHEEL_UPDATE_ET(data__)
+    if ((data__->WHEEL.state == __TIMER_EXPIRED)) {
+      __timer_wheel_stop(&data__->WHEEL);
+      __SET_VAR(data__->,STATE,,2);
+      __SET_VAR(data__->,Q,,__BOOL_LITERAL(FALSE));
+      __SET_VAR(data__->,ET,,__GET_VAR(data__->PT,));
+    };
+  };
+  if (((__GET_VAR(data__->STATE,) == 2) && !(__GET_VAR(data__->IN,)))) {
+    __SET_VAR(data__->,ET,,__time_to_timespec(1, 0, 0, 0, 0, 0));
+    __SET_VAR(data__->,STATE,,0);
+  };
+  __SET_VAR(data__->,PREV_IN,,__GET_VAR(data__->IN,));
+
+  goto __end;
+
+__end:
+  return;
+} // TP_body__() 
+#else
 static void TP_body__(TP *data__) {
   // Control execution
   if (!__GET_VAR(data__->EN)) {
@@ -1431,7 +1709,7 @@ __SET_VAR(data__->,CURRENT_TIME,,__CURRENT_TIME)
     __SET_VAR(data__->,Q,,__BOOL_LITERAL(TRUE));
     __SET_VAR(data__->,START_TIME,,__GET_VAR(data__->CURRENT_TIME,));
   } else if ((__GET_VAR(data__->STATE,) == 1)) {
-    if (LE_TIME(__BOOL_LITERAL(TRUE), NULL, 2, __time_add(__GET_VAR(data__->START_TIME,), __GET_VAR(data__->PT,)), __GET_VAR(data__->CURRENT_TIME,))) {
+    if (LE_TIME2(__BOOL_LITERAL(TRUE), NULL, __time_add(__GET_VAR(data__->START_TIME,), __GET_VAR(data__->PT,)), __GET_VAR(data__->CURRENT_TIME,))) {
       __SET_VAR(data__->,STATE,,2);
       __SET_VAR(data__->,Q,,__BOOL_LITERAL(FALSE));
       __SET_VAR(data__->,ET,,__GET_VAR(data__->PT,));
@@ -1450,6 +1728,7 @@ __SET_VAR(data__->,CURRENT_TIME,,__CURRENT_TIME)
 __end:
   return;
 } // TP_body__() 
+#endif
 
 
 
@@ -1466,9 +1745,66 @@ static void TON_init__(TON *data__, BOOL retain) {
   __INIT_VAR(data__->PREV_IN,__BOOL_LITERAL(FALSE),retain)
   __INIT_VAR(data__->CURRENT_TIME,__time_to_timespec(1, 0, 0, 0, 0, 0),retain)
   __INIT_VAR(data__->START_TIME,__time_to_timespec(1, 0, 0, 0, 0, 0),retain)
+#ifdef IEC_TIMER_WHEEL
+  __INIT_TIMER(data__->WHEEL)
+#endif
+}
+
+static void TON_retain__(TON *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->IN)
+  __RETAIN_VAR(data__->PT)
+  __RETAIN_VAR(data__->Q)
+  __RETAIN_VAR(data__->ET)
+  __RETAIN_VAR(data__->STATE)
+  __RETAIN_VAR(data__->PREV_IN)
+  __RETAIN_VAR(data__->CURRENT_TIME)
+  __RETAIN_VAR(data__->START_TIME)
 }
 
 // Code part
+#ifdef IEC_TIMER_WHEEL
+static void TON_body__(TON *data__) {
+  // Control execution
+  if (!__GET_VAR(data__->EN)) {
+    __SET_VAR(data__->,ENO,,__BOOL_LITERAL(FALSE));
+    return;
+  }
+  else {
+    __SET_VAR(data__->,ENO,,__BOOL_LITERAL(TRUE));
+  }
+  // Initialise TEMP variables
+
+  if ((((__GET_VAR(data__->STATE,) == 0) && !(__GET_VAR(data__->PREV_IN,))) && __GET_VAR(data__->IN,))) {
+    __SET_VAR(data__->,STATE,,1);
+    __SET_VAR(data__->,Q,,__BOOL_LITERAL(FALSE));
+    __SET_VAR(data__->,START_TIME,,__CURRENT_TIME);
+    __TIMER_WHEEL_START(data__)
+  } else {
+    if (!(__GET_VAR(data__->IN,))) {
+      if ((__GET_VAR(data__->STATE,) != 0)) {
+        __timer_wheel_stop(&data__->WHEEL);
+        __SET_VAR(data__->,ET,,__time_to_timespec(1, 0, 0, 0, 0, 0));
+        __SET_VAR(data__->,Q,,__BOOL_LITERAL(FALSE));
+        __SET_VAR(data__->,STATE,,0);
+      };
+    } else if ((__GET_VAR(data__->STATE,) == 1)) {
+      __TIMER_WHEEL_UPDATE_ET(data__)
+      if ((data__->WHEEL.state == __TIMER_EXPIRED)) {
+        __timer_wheel_stop(&data__->WHEEL);
+        __SET_VAR(data__->,STATE,,2);
+        __SET_VAR(data__->,Q,,__BOOL_LITERAL(TRUE));
+        __SET_VAR(data__->,ET,,__GET_VAR(data__->PT,));
+      };
+    };
+  };
+  __SET_VAR(data__->,PREV_IN,,__GET_VAR(data__->IN,));
+
+  goto __end;
+
+__end:
+  return;
+} // TON_body__() 
+#else
 static void TON_body__(TON *data__) {
   // Control execution
   if (!__GET_VAR(data__->EN)) {
@@ -1496,7 +1832,7 @@ __SET_VAR(data__->,CURRENT_TIME,,__CURRENT_TIME)
       __SET_VAR(data__->,Q,,__BOOL_LITERAL(FALSE));
       __SET_VAR(data__->,STATE,,0);
     } else if ((__GET_VAR(data__->STATE,) == 1)) {
-      if (LE_TIME(__BOOL_LITERAL(TRUE), NULL, 2, __time_add(__GET_VAR(data__->START_TIME,), __GET_VAR(data__->PT,)), __GET_VAR(data__->CURRENT_TIME,))) {
+      if (LE_TIME2(__BOOL_LITERAL(TRUE), NULL, __time_add(__GET_VAR(data__->START_TIME,), __GET_VAR(data__->PT,)), __GET_VAR(data__->CURRENT_TIME,))) {
         __SET_VAR(data__->,STATE,,2);
         __SET_VAR(data__->,Q,,__BOOL_LITERAL(TRUE));
         __SET_VAR(data__->,ET,,__GET_VAR(data__->PT,));
@@ -1512,6 +1848,7 @@ __SET_VAR(data__->,CURRENT_TIME,,__CURRENT_TIME)
 __end:
   return;
 } // TON_body__() 
+#endif
 
 
 
@@ -1528,9 +1865,64 @@ static void TOF_init__(TOF *data__, BOOL retain) {
   __INIT_VAR(data__->PREV_IN,__BOOL_LITERAL(FALSE),retain)
   __INIT_VAR(data__->CURRENT_TIME,__time_to_timespec(1, 0, 0, 0, 0, 0),retain)
   __INIT_VAR(data__->START_TIME,__time_to_timespec(1, 0, 0, 0, 0, 0),retain)
+#ifdef IEC_TIMER_WHEEL
+  __INIT_TIMER(data__->WHEEL)
+#endif
+}
+
+static void TOF_retain__(TOF *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->IN)
+  __RETAIN_VAR(data__->PT)
+  __RETAIN_VAR(data__->Q)
+  __RETAIN_VAR(data__->ET)
+  __RETAIN_VAR(data__->STATE)
+  __RETAIN_VAR(data__->PREV_IN)
+  __RETAIN_VAR(data__->CURRENT_TIME)
+  __RETAIN_VAR(data__->START_TIME)
 }
 
 // Code part
+#ifdef IEC_TIMER_WHEEL
+static void TOF_body__(TOF *data__) {
+  // Control execution
+  if (!__GET_VAR(data__->EN)) {
+    __SET_VAR(data__->,ENO,,__BOOL_LITERAL(FALSE));
+    return;
+  }
+  else {
+    __SET_VAR(data__->,ENO,,__BOOL_LITERAL(TRUE));
+  }
+  // Initialise TEMP variables
+
+  if ((((__GET_VAR(data__->STATE,) == 0) && __GET_VAR(data__->PREV_IN,)) && !(__GET_VAR(data__->IN,)))) {
+    __SET_VAR(data__->,STATE,,1);
+    __SET_VAR(data__->,START_TIME,,__CURRENT_TIME);
+    __TIMER_WHEEL_START(data__)
+  } else {
+    if (__GET_VAR(data__->IN,)) {
+      if ((__GET_VAR(data__->STATE,) != 0)) {
+        __timer_wheel_stop(&data__->WHEEL);
+        __SET_VAR(data__->,ET,,__time_to_timespec(1, 0, 0, 0, 0, 0));
+        __SET_VAR(data__->,STATE,,0);
+      };
+    } else if ((__GET_VAR(data__->STATE,) == 1)) {
+      __TIMER_WHEEL_UPDATE_ET(data__)
+      if ((data__->WHEEL.state == __TIMER_EXPIRED)) {
+        __timer_wheel_stop(&data__->WHEEL);
+        __SET_VAR(data__->,STATE,,2);
+        __SET_VAR(data__->,ET,,__GET_VAR(data__->PT,));
+      };
+    };
+  };
+  __SET_VAR(data__->,Q,,(__GET_VAR(data__->IN,) || (__GET_VAR(data__->STATE,) == 1)));
+  __SET_VAR(data__->,PREV_IN,,__GET_VAR(data__->IN,));
+
+  goto __end;
+
+__end:
+  return;
+} // TOF_body__() 
+#else
 static void TOF_body__(TOF *data__) {
   // Control execution
   if (!__GET_VAR(data__->EN)) {
@@ -1556,7 +1948,7 @@ __SET_VAR(data__->,CURRENT_TIME,,__CURRENT_TIME)
       __SET_VAR(data__->,ET,,__time_to_timespec(1, 0, 0, 0, 0, 0));
       __SET_VAR(data__->,STATE,,0);
     } else if ((__GET_VAR(data__->STATE,) == 1)) {
-      if (LE_TIME(__BOOL_LITERAL(TRUE), NULL, 2, __time_add(__GET_VAR(data__->START_TIME,), __GET_VAR(data__->PT,)), __GET_VAR(data__->CURRENT_TIME,))) {
+      if (LE_TIME2(__BOOL_LITERAL(TRUE), NULL, __time_add(__GET_VAR(data__->START_TIME,), __GET_VAR(data__->PT,)), __GET_VAR(data__->CURRENT_TIME,))) {
         __SET_VAR(data__->,STATE,,2);
         __SET_VAR(data__->,ET,,__GET_VAR(data__->PT,));
       } else {
@@ -1572,6 +1964,7 @@ __SET_VAR(data__->,CURRENT_TIME,,__CURRENT_TIME)
 __end:
   return;
 } // TOF_body__() 
+#endif
 
 
 
@@ -1589,6 +1982,16 @@ static void DERIVATIVE_init__(DERIVATIVE *data__, BOOL retain) {
   __INIT_VAR(data__->X3,0,retain)
 }
 
+static void DERIVATIVE_retain__(DERIVATIVE *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->RUN)
+  __RETAIN_VAR(data__->XIN)
+  __RETAIN_VAR(data__->CYCLE)
+  __RETAIN_VAR(data__->XOUT)
+  __RETAIN_VAR(data__->X1)
+  __RETAIN_VAR(data__->X2)
+  __RETAIN_VAR(data__->X3)
+}
+
 // Code part
 static void DERIVATIVE_body__(DERIVATIVE *data__) {
   // Control execution
@@ -1634,6 +2037,13 @@ static void HYSTERESIS_init__(HYSTERESIS *data__, BOOL retain) {
   __INIT_VAR(data__->Q,0,retain)
 }
 
+static void HYSTERESIS_retain__(HYSTERESIS *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->XIN1)
+  __RETAIN_VAR(data__->XIN2)
+  __RETAIN_VAR(data__->EPS)
+  __RETAIN_VAR(data__->Q)
+}
+
 // Code part
 static void HYSTERESIS_body__(HYSTERESIS *data__) {
   // Control execution
@@ -1676,6 +2086,16 @@ static void INTEGRAL_init__(INTEGRAL *data__, BOOL retain) {
   __INIT_VAR(data__->XOUT,0,retain)
 }
 
+static void INTEGRAL_retain__(INTEGRAL *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->RUN)
+  __RETAIN_VAR(data__->R1)
+  __RETAIN_VAR(data__->XIN)
+  __RETAIN_VAR(data__->X0)
+  __RETAIN_VAR(data__->CYCLE)
+  __RETAIN_VAR(data__->Q)
+  __RETAIN_VAR(data__->XOUT)
+}
+
 // Code part
 static void INTEGRAL_body__(INTEGRAL *data__) {
   // Control execution
@@ -1724,6 +2144,21 @@ static void PID_init__(PID *data__, BOOL retain) {
   DERIVATIVE_init__(&data__->DTERM,retain);
 }
 
+static void PID_retain__(PID *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->AUTO)
+  __RETAIN_VAR(data__->PV)
+  __RETAIN_VAR(data__->SP)
+  __RETAIN_VAR(data__->X0)
+  __RETAIN_VAR(data__->KP)
+  __RETAIN_VAR(data__->TR)
+  __RETAIN_VAR(data__->TD)
+  __RETAIN_VAR(data__->CYCLE)
+  __RETAIN_VAR(data__->XOUT)
+  __RETAIN_VAR(data__->ERROR)
+  __RETAIN_FB(INTEGRAL,data__->ITERM)
+  __RETAIN_FB(DERIVATIVE,data__->DTERM)
+}
+
 // Code part
 static void PID_body__(PID *data__) {
   // Control execution
@@ -1773,6 +2208,18 @@ static void RAMP_init__(RAMP *data__, BOOL retain) {
   __INIT_VAR(data__->T,__time_to_timespec(1, 0, 0, 0, 0, 0),retain)
 }
 
+static void RAMP_retain__(RAMP *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->RUN)
+  __RETAIN_VAR(data__->X0)
+  __RETAIN_VAR(data__->X1)
+  __RETAIN_VAR(data__->TR)
+  __RETAIN_VAR(data__->CYCLE)
+  __RETAIN_VAR(data__->BUSY)
+  __RETAIN_VAR(data__->XOUT)
+  __RETAIN_VAR(data__->XI)
+  __RETAIN_VAR(data__->T)
+}
+
 // Code part
 static void RAMP_body__(RAMP *data__) {
   // Control execution
@@ -1787,7 +2234,7 @@ static void RAMP_body__(RAMP *data__) {
 
   __SET_VAR(data__->,BUSY,,__GET_VAR(data__->RUN,));
   if (__GET_VAR(data__->RUN,)) {
-    if (GE_TIME(__BOOL_LITERAL(TRUE), NULL, 2, __GET_VAR(data__->T,), __GET_VAR(data__->TR,))) {
+    if (GE_TIME2(__BOOL_LITERAL(TRUE), NULL, __GET_VAR(data__->T,), __GET_VAR(data__->TR,))) {
       __SET_VAR(data__->,BUSY,,0);
       __SET_VAR(data__->,XOUT,,__GET_VAR(data__->X1,));
     } else {
@@ -1826,6 +2273,16 @@ static void RTC_init__(RTC *data__, BOOL retain) {
   __INIT_VAR(data__->CURRENT_TIME,__dt_to_timespec(0, 0, 0, 1, 1, 1970),retain)
 }
 
+static void RTC_retain__(RTC *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->IN)
+  __RETAIN_VAR(data__->PDT)
+  __RETAIN_VAR(data__->Q)
+  __RETAIN_VAR(data__->CDT)
+  __RETAIN_VAR(data__->PREV_IN)
+  __RETAIN_VAR(data__->OFFSET)
+  __RETAIN_VAR(data__->CURRENT_TIME)
+}
+
 // Code part
 static void RTC_body__(RTC *data__) {
   // Control execution
@@ -1874,6 +2331,13 @@ static void SEMA_init__(SEMA *data__, BOOL retain) {
   __INIT_VAR(data__->Q_INTERNAL,__BOOL_LITERAL(FALSE),retain)
 }
 
+static void SEMA_retain__(SEMA *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize) {
+  __RETAIN_VAR(data__->CLAIM)
+  __RETAIN_VAR(data__->RELEASE)
+  __RETAIN_VAR(data__->BUSY)
+  __RETAIN_VAR(data__->Q_INTERNAL)
+}
+
 // Code part
 static void SEMA_body__(SEMA *data__) {
   // Control execution
@@ -89,6 +89,11 @@
 /* Idem as body, but for run CONFIG and RESOURCE function */
 #define FB_RUN_SUFFIX "_run__"
 
+/* Idem as body, but for the function handing the RETAIN variables of a FB/PROGRAM
+ * instance to the backup/restore functions (only generated with the 'b' option).
+ */
+#define FB_RETAIN_SUFFIX "_retain__"
+
 /* The FB body function is passed as the only parameter a pointer to the FB data
  * structure instance. The name of this parameter is given by the following constant.
  * In order not to clash with any variable in the IL and ST source codem the
@@ -102,6 +107,15 @@
 
 #define FB_FUNCTION_PARAM "data__"
 
+/* Extensible standard functions (ADD, MUL, AND, OR, XOR, MAX, MIN, MUX, GT, GE,
+ * EQ, LE, LT, CONCAT) called with up to this number of inputs are called through
+ * their fixed arity version, named after the function with the number of inputs
+ * appended (e.g. ADD__INT__INT3(EN, ENO, a, b, c)). Calls with more inputs pass
+ * the number of inputs to the varargs version (e.g. ADD__INT__INT(EN, ENO, 9, ...)).
+ * Must match MAX_INLINE_PARAM_COUNT in lib/C/iec_std_functions.h
+ */
+#define MAX_INLINE_PARAM_COUNT 8
+
 
 #define SFC_STEP_ACTION_PREFIX "__SFC_"
 
@@ -127,6 +141,11 @@
 #define INIT_LOCATED "__INIT_LOCATED"
 #define INIT_LOCATED_VALUE "__INIT_LOCATED_VALUE"
 
+/* Variable backup/restore symbol for accessor macros */
+#define RETAIN_VAR "__RETAIN_VAR"
+#define RETAIN_FB "__RETAIN_FB"
+#define RETAIN_LOCATED "__RETAIN_LOCATED"
+
 /* Variable getter symbol for accessor macros */
 #define GET_VAR "__GET_VAR"
 #define GET_EXTERNAL "__GET_EXTERNAL"
@@ -154,6 +173,13 @@
 #define SET_EXTERNAL_FB "__SET_EXTERNAL_FB"
 #define SET_LOCATED "__SET_LOCATED"
 
+/* Variable setter symbol for accessor macros, for the functions writing
+ * their STRING result by reference (e.g. LEFT__STRING__STRING__INT_BY_REF)
+ */
+#define SET_VAR_BY_REF "__SET_VAR_BY_REF"
+#define SET_EXTERNAL_BY_REF "__SET_EXTERNAL_BY_REF"
+#define SET_LOCATED_BY_REF "__SET_LOCATED_BY_REF"
+
 /* Variable initial value symbol for accessor macros */
 #define INITIAL_VALUE "__INITIAL_VALUE"
 
@@ -808,6 +834,47 @@ class generate_c_pous_c {
     }
   
 
+    /* Print the function handing the RETAIN variables of a FB or PROGRAM instance to the
+     * backup/restore functions, only generated with the 'b' option:
+     *   void FBNAME_retain__(FBNAME *data__, __IEC_RETAIN_OP op, void **buffer, int *maxsize)
+     * The RETAIN flag of each variable is the one set by FBNAME_init__(), so the RETAIN and
+     * NON_RETAIN qualifiers and the retain parameter of the constructor are all honoured.
+     * EN, ENO, IN_OUT, TEMP and EXTERNAL variables are never handed over, they are not kept
+     * by the instance.
+     */
+    static void print_retain_function(symbol_c *pou_name, symbol_c *var_declarations, stage4out_c &s4o, bool print_declaration) {
+      generate_c_base_and_typeid_c print_base(&s4o);
+
+      if (generate_plc_state_backup_fuctions__ == 0)
+        return;
+
+      s4o.print(s4o.indent_spaces + "void ");
+      pou_name->accept(print_base);
+      s4o.print(FB_RETAIN_SUFFIX);
+      s4o.print("(");
+      pou_name->accept(print_base);
+      s4o.print(" *");
+      s4o.print(FB_FUNCTION_PARAM);
+      s4o.print(", __IEC_RETAIN_OP op, void **buffer, int *maxsize)");
+
+      if (print_declaration) {
+        s4o.print(";\n");
+        return;
+      }
+      s4o.print(" {\n");
+      s4o.indent_right();
+      generate_c_vardecl_c vardecl(&s4o,
+                                   generate_c_vardecl_c::retain_vf,
+                                   generate_c_vardecl_c::input_vt    |
+                                   generate_c_vardecl_c::output_vt   |
+                                   generate_c_vardecl_c::private_vt  |
+                                   generate_c_vardecl_c::located_vt);
+      vardecl.print(var_declarations, NULL, FB_FUNCTION_PARAM"->");
+      s4o.indent_left();
+      s4o.print(s4o.indent_spaces + "}\n\n");
+    }
+
+
     /*************/
     /* Functions */
     /*************/
@@ -1064,6 +1131,8 @@ class generate_c_pous_c {
 
       if (print_declaration) {
         s4o.print(";\n");
+        /* (B.4) Backup/restore of the RETAIN variables */
+        print_retain_function(symbol->fblock_name, symbol->var_declarations, s4o, print_declaration);
       } else {
         s4o.print(" {\n");
         s4o.indent_right();
@@ -1091,6 +1160,9 @@ class generate_c_pous_c {
         s4o.indent_left();
         s4o.print(s4o.indent_spaces + "}\n\n");
 
+        /* (B.4) Backup/restore of the RETAIN variables */
+        print_retain_function(symbol->fblock_name, symbol->var_declarations, s4o, print_declaration);
+
         /* (C) Function with FB body */
         /* (C.1) Step definitions */
         sfcdecl->generate(symbol->fblock_body, generate_c_sfcdecl_c::stepdef_sd);
@@ -1299,6 +1371,9 @@ class generate_c_pous_c {
         s4o.indent_left();
         s4o.print(s4o.indent_spaces + "}\n\n");
       }
+
+      /* (B.4) Backup/restore of the RETAIN variables */
+      print_retain_function(symbol->program_type_name, symbol->var_declarations, s4o, print_declaration);
     
       if (!print_declaration) {    
         /* (C) Function with PROGRAM body */
@@ -1391,7 +1466,9 @@ class generate_c_config_c: public generate_c_base_and_typeid_c {
       initprotos_dt,
       initdeclare_dt,
       runprotos_dt,
-      rundeclare_dt
+      rundeclare_dt,
+      taskprotos_dt,
+      tasklist_dt
     } declaretype_t;
 
     declaretype_t wanted_declaretype;
@@ -1525,12 +1602,37 @@ void *visit(configuration_declaration_c *symbol) {
 
   /* (C.3) Close Public Function body */
   s4o.indent_left();
-  s4o.print(s4o.indent_spaces + "}\n");
+  s4o.print(s4o.indent_spaces + "}\n\n");
+
+  /* (D) Task tables of every resource, used by the runtime task scheduler */
+  /* (D.1) Resources task tables protos... */
+  wanted_declaretype = taskprotos_dt;
+  symbol->resource_declarations->accept(*this);
+  s4o.print("\n");
+
+  /* (D.2) NULL terminated list of the task tables... */
+  s4o.print(s4o.indent_spaces + "IEC_TASK *config_tasks__[] = {\n");
+  s4o.indent_right();
+  wanted_declaretype = tasklist_dt;
+  symbol->resource_declarations->accept(*this);
+  s4o.print(s4o.indent_spaces + "NULL\n");
+  s4o.indent_left();
+  s4o.print(s4o.indent_spaces + "};\n");
 
   return NULL;
 }
 
 void *visit(resource_declaration_c *symbol) {
+  if (wanted_declaretype == taskprotos_dt) {
+    s4o.print(s4o.indent_spaces + "extern IEC_TASK ");
+    symbol->resource_name->accept(*this);
+    s4o.print("__tasks__[];\n");
+  }
+  if (wanted_declaretype == tasklist_dt) {
+    s4o.print(s4o.indent_spaces);
+    symbol->resource_name->accept(*this);
+    s4o.print("__tasks__,\n");
+  }
   if (wanted_declaretype == initprotos_dt || wanted_declaretype == runprotos_dt) {
     s4o.print(s4o.indent_spaces + "void ");
     symbol->resource_name->accept(*this);
@@ -1559,6 +1661,10 @@ void *visit(resource_declaration_c *symbol) {
 }
 
 void *visit(single_resource_declaration_c *symbol) {
+  if (wanted_declaretype == taskprotos_dt)
+    s4o.print(s4o.indent_spaces + "extern IEC_TASK RESOURCE__tasks__[];\n");
+  if (wanted_declaretype == tasklist_dt)
+    s4o.print(s4o.indent_spaces + "RESOURCE__tasks__,\n");
   if (wanted_declaretype == initprotos_dt || wanted_declaretype == runprotos_dt) {
     s4o.print(s4o.indent_spaces + "void RESOURCE");
     if (wanted_declaretype == initprotos_dt) {
@@ -1610,6 +1716,11 @@ class generate_c_resources_c: public generate_c_base_and_typeid_c {
     symbol_c *current_global_vars;
     bool configuration_name;
 
+    /* Used when generating one run function per task (see task_run_dt)... */
+    symbol_c *current_program_list;
+    symbol_c *current_run_task;
+    bool      filter_run_task;
+
   public:
     generate_c_resources_c(stage4out_c *s4o_ptr, symbol_c *config_scope, symbol_c *resource_scope, unsigned long long time)
       : generate_c_base_and_typeid_c(s4o_ptr) {
@@ -1621,6 +1732,9 @@ class generate_c_resources_c: public generate_c_base_and_typeid_c {
       current_task_name = NULL;
       current_global_vars = NULL;
       configuration_name = false;
+      current_program_list = NULL;
+      current_run_task = NULL;
+      filter_run_task = false;
     };
 
     virtual ~generate_c_resources_c(void) {
@@ -1631,7 +1745,9 @@ class generate_c_resources_c: public generate_c_base_and_typeid_c {
     typedef enum {
       declare_dt,
       init_dt,
-      run_dt
+      run_dt,
+      task_run_dt,   /* one run function per task, called by the runtime task scheduler */
+      task_table_dt  /* table describing the tasks of the resource (IEC_TASK) */
     } declaretype_t;
 
     declaretype_t wanted_declaretype;
@@ -1854,6 +1970,48 @@ END_RESOURCE
       s4o.indent_left();
       s4o.print("}\n\n");
       
+      /* (D) One run function per task, so each task may be scheduled on its own thread... */
+      current_program_list = symbol->program_configuration_list;
+      wanted_declaretype = task_run_dt;
+      symbol->task_configuration_list->accept(*this);
+      
+      /* (D.1) Programs not associated to any task are grouped in a cyclic run function... */
+      bool has_cyclic_programs = cyclic_programs_count(symbol->program_configuration_list) > 0;
+      if (has_cyclic_programs) {
+        s4o.print("void ");
+        current_resource_name->accept(*this);
+        s4o.print("__cyclic");
+        s4o.print(FB_RUN_SUFFIX);
+        s4o.print("(unsigned long tick) {\n");
+        s4o.indent_right();
+        wanted_declaretype = run_dt;
+        filter_run_task = true;
+        current_run_task = NULL;
+        symbol->program_configuration_list->accept(*this);
+        filter_run_task = false;
+        s4o.indent_left();
+        s4o.print("}\n\n");
+      }
+      current_program_list = NULL;
+      
+      /* (E) Task table... */
+      s4o.print("IEC_TASK ");
+      current_resource_name->accept(*this);
+      s4o.print("__tasks__[] = {\n");
+      s4o.indent_right();
+      wanted_declaretype = task_table_dt;
+      symbol->task_configuration_list->accept(*this);
+      if (has_cyclic_programs) {
+        s4o.print(s4o.indent_spaces + "{\"\", ");
+        current_resource_name->accept(*this);
+        s4o.print("__cyclic");
+        s4o.print(FB_RUN_SUFFIX);
+        s4o.print(", 0ULL, -1},\n");
+      }
+      s4o.print(s4o.indent_spaces + "{NULL, NULL, 0ULL, 0}\n");
+      s4o.indent_left();
+      s4o.print("};\n\n");
+      
       if (single_resource) {
         delete current_resource_name;
         current_resource_name = NULL;
@@ -1861,9 +2019,34 @@ END_RESOURCE
       return NULL;
     }
     
+    /* number of programs in the list that are not associated to any task */
+    int cyclic_programs_count(symbol_c *program_list) {
+      list_c *list = dynamic_cast<list_c *>(program_list);
+      int count = 0;
+      if (NULL == list) return 0;
+      for (int i = 0; i < list->n; i++) {
+        program_configuration_c *program = dynamic_cast<program_configuration_c *>(list->get_element(i));
+        if ((NULL != program) && (NULL == program->task_name)) count++;
+      }
+      return count;
+    }
+
+    /* returns true if the program must be run by the task run function currently being generated */
+    bool runs_in_current_task(program_configuration_c *symbol) {
+      if (!filter_run_task) return true;
+      if ((NULL == symbol->task_name) || (NULL == current_run_task))
+        return symbol->task_name == current_run_task;
+      identifier_c *task_id    = dynamic_cast<identifier_c *>(symbol->task_name);
+      identifier_c *current_id = dynamic_cast<identifier_c *>(current_run_task);
+      if ((NULL == task_id) || (NULL == current_id)) ERROR;
+      return strcasecmp(task_id->value, current_id->value) == 0;
+    }
+
 /*  PROGRAM [RETAIN | NON_RETAIN] program_name [WITH task_name] ':' program_type_name ['(' prog_conf_elements ')'] */
 //SYM_REF6(program_configuration_c, retain_option, program_name, task_name, program_type_name, prog_conf_elements, unused)
     void *visit(program_configuration_c *symbol) {
+      if ((wanted_declaretype == run_dt) && !runs_in_current_task(symbol))
+        return NULL;
       switch (wanted_declaretype) {
         case declare_dt:
           s4o.print(s4o.indent_spaces);
@@ -1950,6 +2133,38 @@ END_RESOURCE
         case run_dt:
           symbol->task_initialization->accept(*this);
           break;
+        case task_run_dt:
+          s4o.print("void ");
+          current_resource_name->accept(*this);
+          s4o.print("__");
+          current_task_name->accept(*this);
+          s4o.print(FB_RUN_SUFFIX);
+          s4o.print("(unsigned long tick) {\n");
+          s4o.indent_right();
+          /* the task thread already runs with the task period, so only the SINGLE trigger is evaluated */
+          wanted_declaretype = run_dt;
+          filter_run_task = true;
+          current_run_task = current_task_name;
+          symbol->task_initialization->accept(*this);
+          current_program_list->accept(*this);
+          current_run_task = NULL;
+          filter_run_task = false;
+          wanted_declaretype = task_run_dt;
+          s4o.indent_left();
+          s4o.print("}\n\n");
+          break;
+        case task_table_dt:
+          s4o.print(s4o.indent_spaces + "{\"");
+          current_task_name->accept(*this);
+          s4o.print("\", ");
+          current_resource_name->accept(*this);
+          s4o.print("__");
+          current_task_name->accept(*this);
+          s4o.print(FB_RUN_SUFFIX);
+          s4o.print(", ");
+          symbol->task_initialization->accept(*this);
+          s4o.print("},\n");
+          break;
         default:
           break;
       }
@@ -2017,6 +2232,11 @@ END_RESOURCE
             current_task_name->accept(*this);
             s4o.print("_R_TRIG.Q)");
           }
+          else if (filter_run_task) {
+            s4o.print(s4o.indent_spaces);
+            current_task_name->accept(*this);
+            s4o.print(" = 1");
+          }
           else {
             s4o.print(s4o.indent_spaces);
             current_task_name->accept(*this);
@@ -2036,6 +2256,15 @@ END_RESOURCE
           }
           s4o.print(";\n");
           break;
+        case task_table_dt:
+          /* interval in ns (0 for SINGLE tasks, which are polled every common tick), priority */
+          if (symbol->single_data_source == NULL)
+            s4o.print_long_long_integer(calculate_time(symbol->interval_data_source));
+          else
+            s4o.print_long_long_integer(0);
+          s4o.print(", ");
+          symbol->priority_data_source->accept(*this);
+          break;
         default:
           break;
       }
@@ -2130,8 +2359,8 @@ END_RESOURCE
 #define RESTORE_  "_restore__"
 #define BACKUP_   "_backup__"
 
-/* class to generate the forward declaration of the XXXX_backup() and XXXX_restore()
- * functions that will later (in the generated C source code) be defined 
+/* class to generate the forward declaration of the XXXX_retain__() function
+ * that will later (in the generated C source code) be defined 
  * to backup/restore the global state of each RESOURCE in the source code being compiled.
  * The XXXX is actually the resource name!
  */
@@ -2144,24 +2373,23 @@ class generate_c_backup_resource_decl_c: public generate_c_base_and_typeid_c {
       s4o.print(s4o.indent_spaces);
       s4o.print("void ");
       symbol->resource_name->accept(*this);
-      s4o.print("_backup__" "(void **buffer, int *maxsize);\n");      
-      s4o.print(s4o.indent_spaces);
-      s4o.print("void ");
-      symbol->resource_name->accept(*this);
-      s4o.print("_restore__" "(void **buffer, int *maxsize);\n");      
+      s4o.print(FB_RETAIN_SUFFIX "(__IEC_RETAIN_OP op, void **buffer, int *maxsize);\n");      
       return NULL;
     }
 };
 
 
 /* print out the begining of the generic backup/restore function */
-void print_backup_restore_function_beg(stage4out_c &s4o, const char *func_name, const char *operation) {
-  /* operation will be either "_backup__" or "_restore__" */
+/* The function hands the variables to op, that will be either _backup__() or _restore__().
+ * Only the variables whose RETAIN flag was set when they were initialised are handed
+ * to the operation, FB instances being handled by their FBNAME_retain__() function.
+ * The located variables are handled through the pointer to their location.
+ */
+void print_backup_restore_function_beg(stage4out_c &s4o, const char *func_name) {
   s4o.print("\n");
   s4o.print("void ");
   s4o.print(func_name);
-  s4o.print(operation);
-  s4o.print("(void **buffer, int *maxsize) {\n");
+  s4o.print(FB_RETAIN_SUFFIX "(__IEC_RETAIN_OP op, void **buffer, int *maxsize) {\n");
   s4o.indent_right();
   // Don't save/restore the __CURRENT_TIME variable, as 'plc controller' has easy access to it
   // and can therefore do the save/restore by itself.
@@ -2170,20 +2398,15 @@ void print_backup_restore_function_beg(stage4out_c &s4o, const char *func_name,
 //s4o.print("(&__CURRENT_TIME, sizeof(__CURRENT_TIME), buffer, maxsize);\n");
   s4o.print(s4o.indent_spaces);
   s4o.print("#define " DECLARE_GLOBAL          "(vartype, domain, varname) \\\n    ");
-  s4o.print(operation);
-  s4o.print("(&domain##__##varname, sizeof(domain##__##varname), buffer, maxsize);\n");
+  s4o.print(RETAIN_VAR "(domain##__##varname)\n");
   s4o.print(s4o.indent_spaces);
   s4o.print("#define " DECLARE_GLOBAL_FB       "(vartype, domain, varname) \\\n    ");
-  s4o.print(operation);
-  s4o.print("(&domain##__##varname, sizeof(domain##__##varname), buffer, maxsize);\n");
+  s4o.print(RETAIN_FB "(vartype, domain##__##varname)\n");
   s4o.print(s4o.indent_spaces);
-  s4o.print("#define " DECLARE_GLOBAL_LOCATION "(vartype, location) \\\n    ");
-  s4o.print(operation);
-  s4o.print("(location, sizeof(*location), buffer, maxsize);\n");
+  s4o.print("#define " DECLARE_GLOBAL_LOCATION "(vartype, location)\n");
   s4o.print(s4o.indent_spaces);
   s4o.print("#define " DECLARE_GLOBAL_LOCATED  "(vartype, domain, varname) \\\n    ");
-  s4o.print(operation);
-  s4o.print("(&domain##__##varname, sizeof(domain##__##varname), buffer, maxsize);\n");
+  s4o.print(RETAIN_LOCATED "(domain##__##varname)\n");
 }
 
 /* print out the ending of the generic backup/restore function */
@@ -2204,6 +2427,11 @@ void print_backup_restore_function_end(stage4out_c &s4o) {
  *
  *   The matiec compiler will now generate two additional functions which 
  *   will backup and restore the PLC internal state to a void *buffer.
+ *   The state is made of the RETAIN variables: the global variables, the
+ *   variables of the PROGRAM instances and of the FB instances they contain
+ *   that were declared RETAIN (or that are part of a RETAIN instance).
+ *   Both go through config_retain__(op, buffer, maxsize), that hands every
+ *   RETAIN variable, always in the same order, to the operation op.
  *       config_backup__(void **buffer, int *maxsize)
  *       config_restore__(void **buffer, int *maxsize)
  *
@@ -2224,14 +2452,9 @@ void print_backup_restore_function_end(stage4out_c &s4o) {
  *          config_backup__(&buffer, &maxsize);
  */
 class generate_c_backup_config_c: public generate_c_base_and_typeid_c {
-  private:
-    const char *func_to_call; // parameter to pass data from: void *visit(configuration_declaration_c *)
-                              //                          to: void *visit(resource_declaration_c *)
-
   public:
     generate_c_backup_config_c(stage4out_c *s4o_ptr)
       : generate_c_base_and_typeid_c(s4o_ptr) {
-      func_to_call = NULL;
     };
 
     virtual ~generate_c_backup_config_c(void) {}
@@ -2258,14 +2481,14 @@ class generate_c_backup_config_c: public generate_c_base_and_typeid_c {
       s4o.print("void ");
       s4o.print("_backup__");
       s4o.print("(void *varptr, int varsize, void **buffer, int *maxsize) {\n");
-      s4o.print("  if (varsize <= *maxsize) {memmove(*buffer, varptr, varsize); *buffer += varsize;}\n");
+      s4o.print("  if (varsize <= *maxsize) {memmove(*buffer, varptr, varsize); *buffer = (char *)*buffer + varsize;}\n");
       s4o.print("  *maxsize -= varsize;\n");
       s4o.print("}\n");
       
       s4o.print("void ");
       s4o.print("_restore__");
       s4o.print("(void *varptr, int varsize, void **buffer, int *maxsize) {\n");
-      s4o.print("  if (varsize <= *maxsize) {memmove(varptr, *buffer, varsize); *buffer += varsize;}\n");
+      s4o.print("  if (varsize <= *maxsize) {memmove(varptr, *buffer, varsize); *buffer = (char *)*buffer + varsize;}\n");
       s4o.print("  *maxsize -= varsize;\n");
       s4o.print("}\n");
       
@@ -2284,32 +2507,29 @@ class generate_c_backup_config_c: public generate_c_base_and_typeid_c {
       generate_c_backup_resource_decl_c declare_functions = generate_c_backup_resource_decl_c(&s4o);
       symbol->resource_declarations->accept(declare_functions);
       
-      print_backup_restore_function_beg(s4o, "config", "_backup__");
+      print_backup_restore_function_beg(s4o, "config");
       vardecl.print(symbol);
       s4o.print("\n");
-      func_to_call = "_backup__";
       symbol->resource_declarations->accept(*this);
-      func_to_call = NULL;
       print_backup_restore_function_end(s4o);      
     
-      print_backup_restore_function_beg(s4o, "config", "_restore__");
-      vardecl.print(symbol);
       s4o.print("\n");
-      func_to_call = "_restore__";
-      symbol->resource_declarations->accept(*this);
-      func_to_call = NULL;
-      print_backup_restore_function_end(s4o);      
+      s4o.print("void config" BACKUP_ "(void **buffer, int *maxsize) {\n");
+      s4o.print("  config" FB_RETAIN_SUFFIX "(" BACKUP_ ", buffer, maxsize);\n");
+      s4o.print("}\n");
+
+      s4o.print("\n");
+      s4o.print("void config" RESTORE_ "(void **buffer, int *maxsize) {\n");
+      s4o.print("  config" FB_RETAIN_SUFFIX "(" RESTORE_ ", buffer, maxsize);\n");
+      s4o.print("}\n");
       
       return NULL;
     }
     
     void *visit(resource_declaration_c *symbol) {
-      if (symbol->global_var_declarations == NULL)
-        return NULL;
       s4o.print(s4o.indent_spaces);
       symbol->resource_name->accept(*this);
-      s4o.print(func_to_call);
-      s4o.print("(buffer, maxsize);\n");      
+      s4o.print(FB_RETAIN_SUFFIX "(op, buffer, maxsize);\n");      
       return NULL;
     }
     
@@ -2324,7 +2544,9 @@ class generate_c_backup_config_c: public generate_c_base_and_typeid_c {
 
 /* generate the backup/restore function for a RESOURCE */
 /* the backup/restore function generated here will be called by the backup/restore
- * function generated for the configuration in which the resource is embedded
+ * function generated for the configuration in which the resource is embedded.
+ * It handles the global variables of the resource and the PROGRAM instances
+ * running in it.
  */
 class generate_c_backup_resource_c: public generate_c_base_and_typeid_c {
   public:
@@ -2347,9 +2569,6 @@ class generate_c_backup_resource_c: public generate_c_base_and_typeid_c {
     /* B 1.7 Configuration elements */
     /********************************/
     void *visit(resource_declaration_c *symbol) {
-      if (symbol->global_var_declarations == NULL)
-        return NULL;
-
       char *resource_name = strdup(symbol->resource_name->token->value);
       /* convert to upper case */
       for (char *c = resource_name; *c != '\0'; *c = toupper(*c), c++);
@@ -2359,33 +2578,35 @@ class generate_c_backup_resource_c: public generate_c_base_and_typeid_c {
                                          generate_c_vardecl_c::global_vt,
                                          symbol->resource_name);
       s4o.print("\n\n\n");
-
-      s4o.print("void ");
-      s4o.print("_backup__");
-      s4o.print("(void *varptr, int varsize, void **buffer, int *maxsize);\n");
-      s4o.print("void ");
-      s4o.print("_restore__");
-      s4o.print("(void *varptr, int varsize, void **buffer, int *maxsize);\n");
-
-      s4o.print("\n\n\n");
       s4o.print("#undef " DECLARE_GLOBAL          "\n");
       s4o.print("#undef " DECLARE_GLOBAL_FB       "\n");
       s4o.print("#undef " DECLARE_GLOBAL_LOCATION "\n");
       s4o.print("#undef " DECLARE_GLOBAL_LOCATED  "\n");
       
-      print_backup_restore_function_beg(s4o, resource_name, "_backup__");
-      vardecl.print(symbol->global_var_declarations);
-      print_backup_restore_function_end(s4o);      
-    
-      print_backup_restore_function_beg(s4o, resource_name, "_restore__");
-      vardecl.print(symbol->global_var_declarations);
+      print_backup_restore_function_beg(s4o, resource_name);
+      if (symbol->global_var_declarations != NULL)
+        vardecl.print(symbol->global_var_declarations);
+      symbol->resource_declaration->accept(*this);
       print_backup_restore_function_end(s4o);      
     
+      free(resource_name);
       return NULL;
     }
-    
+
+    /*  PROGRAM [RETAIN | NON_RETAIN] program_name [WITH task_name] ':' program_type_name ['(' prog_conf_elements ')'] */
+    void *visit(program_configuration_c *symbol) {
+      s4o.print(s4o.indent_spaces);
+      s4o.print(RETAIN_FB "(");
+      symbol->program_type_name->accept(*this);
+      s4o.print(",");
+      symbol->program_name->accept(*this);
+      s4o.print(")\n");
+      return NULL;
+    }
+
+    /* Only reached through the resource_declaration_c visitor, for the PROGRAM instances */
     void *visit(single_resource_declaration_c *symbol) {
-      /* A single resource never has global variables declared, so nothing to do! */
+      symbol->program_configuration_list->accept(*this);
       return NULL;
     }
 
@@ -253,12 +253,12 @@ class generate_c_base_c: public iterator_visitor_c {
      * NOTE: Typically, the function will have the following parameters: 
      *         1st parameter: EN  (enable)
      *         2nd parameter: ENO (enable output)
-     *         3rd parameter: number of operands we will be passing (required because we are calling an extensible standard function!)
-     *         4th parameter: the left  hand side of the comparison expression (in out case, the IL implicit variable)
+     *         3rd parameter: the left  hand side of the comparison expression (in out case, the IL implicit variable)
      *         4th parameter: the right hand side of the comparison expression (in out case, current operand)
      *       
      *         The 1st and 2nd parameter may not be present, only issue them if NE and ENO are being generated!
-     *         The 3rd parameter must not be generated when the 'NE' function is called (it is not an extensible function!)
+     *         Except for 'NE' (it is not an extensible function!), we call the fixed arity version of
+     *         the function for 2 operands (e.g. LE_TIME2), which does not take the number of operands.
      * 
      *  NOTE: To implement this correctly, this function should really instantiate a 
      *   function_invocation_c and have the generate_c visitor generate the code automatically for this
@@ -276,6 +276,8 @@ class generate_c_base_c: public iterator_visitor_c {
       s4o.print(function); // the GT, LE, ... part
       s4o.print("_");  // the '_' part...
       compare_type->accept(*this); // the TIME, DATE, ... part.
+      if (strcmp(function, "NE") != 0) // All comparison library functions are extensible, except for 'NE'!!
+        s4o.print("2"); // function is extensible, so call its fixed arity version for 2 parameters
       s4o.print("(");  // start of parameters to function call...
       // Determine whether this function has the EN parameter
       //    (we just check the base LE, GT, .. function, as it should have
@@ -289,8 +291,6 @@ class generate_c_base_c: public iterator_visitor_c {
         s4o.print("__BOOL_LITERAL(TRUE), "); // function has EN parameter, pass TRUE
       if (search_var.get_vartype(&eno_var) == search_var_instance_decl_c::output_vt)
         s4o.print("NULL, "); // function has ENO parameter, pass NULL
-      if (strcmp(function, "NE") != 0) // All comparison library functions are extensible, except for 'NE'!!
-        s4o.print("2, "); // function is extensible, so must first pass the number of parameters that follow
       l_exp->accept(*this);
       s4o.print(", ");
       r_exp->accept(*this);
@@ -777,29 +777,39 @@ void *visit(il_function_call_c *symbol) {
   bool used_defvar = false; 
     /* flag to cirreclty handle calls to extensible standard functions (i.e. functions with variable number of input parameters) */
   bool found_first_extensible_parameter = false;  
+  /* number of inputs of the fixed arity version of the extensible function being called, 0 if calling the varargs version */
+  int inline_param_count = 0;
   for(int i = 1; (param_name = fp_iterator.next()) != NULL; i++) {
     if (fp_iterator.is_extensible_param() && (!found_first_extensible_parameter)) {
-      /* We are calling an extensible function. Before passing the extensible
-       * parameters, we must add a dummy paramater value to tell the called
-       * function how many extensible parameters we will be passing.
-       *
-       * Note that stage 3 has already determined the number of extensible
-       * paramters, and stored that info in the abstract syntax tree. We simply
-       * re-use that value.
+      /* With up to MAX_INLINE_PARAM_COUNT extensible parameters we call the fixed arity
+       * version of the function instead (e.g. ADD__INT__INT3() instead of ADD__INT__INT()),
+       * which does not take the number of parameters and reduces to a plain C expression.
        */
-      /* NOTE: we are not freeing the malloc'd memory. This is not really a bug.
-       *       Since we are writing a compiler, which runs to termination quickly,
-       *       we can consider this as just memory required for the compilation process
-       *       that will be free'd when the program terminates.
-       */
-      char *tmp = (char *)malloc(32); /* enough space for a call with 10^31 (larger than 2^64) input parameters! */
-      if (tmp == NULL) ERROR;
-      int res = snprintf(tmp, 32, "%d", symbol->extensible_param_count);
-      if ((res >= 32) || (res < 0)) ERROR;
-      identifier_c *param_value = new identifier_c(tmp);
-      uint_type_name_c *param_type  = new uint_type_name_c();
-      identifier_c *param_name = new identifier_c("");
-      ADD_PARAM_LIST(param_name, param_value, param_type, function_param_iterator_c::direction_in)
+      if ((symbol->extensible_param_count > 0) && (symbol->extensible_param_count <= MAX_INLINE_PARAM_COUNT)) {
+        inline_param_count = symbol->extensible_param_count;
+      } else {
+        /* We are calling an extensible function. Before passing the extensible
+         * parameters, we must add a dummy paramater value to tell the called
+         * function how many extensible parameters we will be passing.
+         *
+         * Note that stage 3 has already determined the number of extensible
+         * paramters, and stored that info in the abstract syntax tree. We simply
+         * re-use that value.
+         */
+        /* NOTE: we are not freeing the malloc'd memory. This is not really a bug.
+         *       Since we are writing a compiler, which runs to termination quickly,
+         *       we can consider this as just memory required for the compilation process
+         *       that will be free'd when the program terminates.
+         */
+        char *tmp = (char *)malloc(32); /* enough space for a call with 10^31 (larger than 2^64) input parameters! */
+        if (tmp == NULL) ERROR;
+        int res = snprintf(tmp, 32, "%d", symbol->extensible_param_count);
+        if ((res >= 32) || (res < 0)) ERROR;
+        identifier_c *param_value = new identifier_c(tmp);
+        uint_type_name_c *param_type  = new uint_type_name_c();
+        identifier_c *param_name = new identifier_c("");
+        ADD_PARAM_LIST(param_name, param_value, param_type, function_param_iterator_c::direction_in)
+      }
       found_first_extensible_parameter = true;
     }
     
@@ -924,6 +934,8 @@ void *visit(il_function_call_c *symbol) {
     }
     if (function_type_suffix != NULL)
       function_type_suffix->accept(*this);
+    if (inline_param_count > 0)
+      s4o.print(inline_param_count);
   }
   s4o.print("(");
   s4o.indent_right();
@@ -1186,29 +1198,39 @@ void *visit(il_formal_funct_call_c *symbol) {
 
     /* flag to cirreclty handle calls to extensible standard functions (i.e. functions with variable number of input parameters) */
   bool found_first_extensible_parameter = false;
+  /* number of inputs of the fixed arity version of the extensible function being called, 0 if calling the varargs version */
+  int inline_param_count = 0;
   for(int i = 1; (param_name = fp_iterator.next()) != NULL; i++) {
     if (fp_iterator.is_extensible_param() && (!found_first_extensible_parameter)) {
-      /* We are calling an extensible function. Before passing the extensible
-       * parameters, we must add a dummy paramater value to tell the called
-       * function how many extensible parameters we will be passing.
-       *
-       * Note that stage 3 has already determined the number of extensible
-       * paramters, and stored that info in the abstract syntax tree. We simply
-       * re-use that value.
+      /* With up to MAX_INLINE_PARAM_COUNT extensible parameters we call the fixed arity
+       * version of the function instead (e.g. ADD__INT__INT3() instead of ADD__INT__INT()),
+       * which does not take the number of parameters and reduces to a plain C expression.
        */
-      /* NOTE: we are not freeing the malloc'd memory. This is not really a bug.
-       *       Since we are writing a compiler, which runs to termination quickly,
-       *       we can consider this as just memory required for the compilation process
-       *       that will be free'd when the program terminates.
-       */
-      char *tmp = (char *)malloc(32); /* enough space for a call with 10^31 (larger than 2^64) input parameters! */
-      if (tmp == NULL) ERROR;
-      int res = snprintf(tmp, 32, "%d", symbol->extensible_param_count);
-      if ((res >= 32) || (res < 0)) ERROR;
-      identifier_c *param_value = new identifier_c(tmp);
-      uint_type_name_c *param_type  = new uint_type_name_c();
-      identifier_c *param_name = new identifier_c("");
-      ADD_PARAM_LIST(param_name, param_value, param_type, function_param_iterator_c::direction_in)
+      if ((symbol->extensible_param_count > 0) && (symbol->extensible_param_count <= MAX_INLINE_PARAM_COUNT)) {
+        inline_param_count = symbol->extensible_param_count;
+      } else {
+        /* We are calling an extensible function. Before passing the extensible
+         * parameters, we must add a dummy paramater value to tell the called
+         * function how many extensible parameters we will be passing.
+         *
+         * Note that stage 3 has already determined the number of extensible
+         * paramters, and stored that info in the abstract syntax tree. We simply
+         * re-use that value.
+         */
+        /* NOTE: we are not freeing the malloc'd memory. This is not really a bug.
+         *       Since we are writing a compiler, which runs to termination quickly,
+         *       we can consider this as just memory required for the compilation process
+         *       that will be free'd when the program terminates.
+         */
+        char *tmp = (char *)malloc(32); /* enough space for a call with 10^31 (larger than 2^64) input parameters! */
+        if (tmp == NULL) ERROR;
+        int res = snprintf(tmp, 32, "%d", symbol->extensible_param_count);
+        if ((res >= 32) || (res < 0)) ERROR;
+        identifier_c *param_value = new identifier_c(tmp);
+        uint_type_name_c *param_type  = new uint_type_name_c();
+        identifier_c *param_name = new identifier_c("");
+        ADD_PARAM_LIST(param_name, param_value, param_type, function_param_iterator_c::direction_in)
+      }
       found_first_extensible_parameter = true;
     }
     
@@ -1331,6 +1353,8 @@ void *visit(il_formal_funct_call_c *symbol) {
     }  
     if (function_type_suffix != NULL)
       function_type_suffix->accept(*this);
+    if (inline_param_count > 0)
+      s4o.print(inline_param_count);
   }
   s4o.print("(");
   s4o.indent_right();
@@ -92,7 +92,8 @@ class generate_c_inlinefcall_c: public generate_c_base_and_typeid_c {
             symbol_c *function_type_prefix,
             symbol_c *function_type_suffix,
             std::list<FUNCTION_PARAM*> param_list,
-            function_declaration_c *f_decl = NULL) {
+            function_declaration_c *f_decl = NULL,
+            int inline_param_count = 0) {
 
       std::list<FUNCTION_PARAM*>::iterator pt;
       generating_inlinefunction = true;
@@ -172,6 +173,9 @@ class generate_c_inlinefcall_c: public generate_c_base_and_typeid_c {
 
       if (function_type_suffix)
         function_type_suffix->accept(*this);
+      if (inline_param_count > 0)
+        /* calling the fixed arity version of an extensible function */
+        s4o.print(inline_param_count);
       s4o.print("(");
       s4o.indent_right();
 
@@ -453,29 +457,39 @@ class generate_c_inlinefcall_c: public generate_c_base_and_typeid_c {
       bool used_defvar = false;       
         /* flag to cirreclty handle calls to extensible standard functions (i.e. functions with variable number of input parameters) */
       bool found_first_extensible_parameter = false;  
+      /* number of inputs of the fixed arity version of the extensible function being called, 0 if calling the varargs version */
+      int inline_param_count = 0;
       for(int i = 1; (param_name = fp_iterator.next()) != NULL; i++) {
         if (fp_iterator.is_extensible_param() && (!found_first_extensible_parameter)) {
-          /* We are calling an extensible function. Before passing the extensible
-           * parameters, we must add a dummy paramater value to tell the called
-           * function how many extensible parameters we will be passing.
-           *
-           * Note that stage 3 has already determined the number of extensible
-           * paramters, and stored that info in the abstract syntax tree. We simply
-           * re-use that value.
+          /* With up to MAX_INLINE_PARAM_COUNT extensible parameters we call the fixed arity
+           * version of the function instead (e.g. ADD__INT__INT3() instead of ADD__INT__INT()),
+           * which does not take the number of parameters and reduces to a plain C expression.
            */
-          /* NOTE: we are not freeing the malloc'd memory. This is not really a bug.
-           *       Since we are writing a compiler, which runs to termination quickly,
-           *       we can consider this as just memory required for the compilation process
-           *       that will be free'd when the program terminates.
-           */
-          char *tmp = (char *)malloc(32); /* enough space for a call with 10^31 (larger than 2^64) input parameters! */
-          if (tmp == NULL) ERROR;
-          int res = snprintf(tmp, 32, "%d", symbol->extensible_param_count);
-          if ((res >= 32) || (res < 0)) ERROR;
-          identifier_c *param_value = new identifier_c(tmp);
-          uint_type_name_c *param_type  = new uint_type_name_c();
-          identifier_c *param_name = new identifier_c(INLINE_PARAM_COUNT);
-          ADD_PARAM_LIST(param_name, param_value, param_type, function_param_iterator_c::direction_in)
+          if ((symbol->extensible_param_count > 0) && (symbol->extensible_param_count <= MAX_INLINE_PARAM_COUNT)) {
+            inline_param_count = symbol->extensible_param_count;
+          } else {
+            /* We are calling an extensible function. Before passing the extensible
+             * parameters, we must add a dummy paramater value to tell the called
+             * function how many extensible parameters we will be passing.
+             *
+             * Note that stage 3 has already determined the number of extensible
+             * paramters, and stored that info in the abstract syntax tree. We simply
+             * re-use that value.
+             */
+            /* NOTE: we are not freeing the malloc'd memory. This is not really a bug.
+             *       Since we are writing a compiler, which runs to termination quickly,
+             *       we can consider this as just memory required for the compilation process
+             *       that will be free'd when the program terminates.
+             */
+            char *tmp = (char *)malloc(32); /* enough space for a call with 10^31 (larger than 2^64) input parameters! */
+            if (tmp == NULL) ERROR;
+            int res = snprintf(tmp, 32, "%d", symbol->extensible_param_count);
+            if ((res >= 32) || (res < 0)) ERROR;
+            identifier_c *param_value = new identifier_c(tmp);
+            uint_type_name_c *param_type  = new uint_type_name_c();
+            identifier_c *param_name = new identifier_c(INLINE_PARAM_COUNT);
+            ADD_PARAM_LIST(param_name, param_value, param_type, function_param_iterator_c::direction_in)
+          }
           found_first_extensible_parameter = true;
         }
     
@@ -562,7 +576,7 @@ class generate_c_inlinefcall_c: public generate_c_base_and_typeid_c {
         f_decl = NULL; 
 
       if (has_output_params)
-        generate_inline(function_name, function_type_prefix, function_type_suffix, param_list, f_decl);
+        generate_inline(function_name, function_type_prefix, function_type_suffix, param_list, f_decl, inline_param_count);
 
       CLEAR_PARAM_LIST()
       return NULL;
@@ -620,29 +634,39 @@ class generate_c_inlinefcall_c: public generate_c_base_and_typeid_c {
 
         /* flag to cirreclty handle calls to extensible standard functions (i.e. functions with variable number of input parameters) */
       bool found_first_extensible_parameter = false;
+      /* number of inputs of the fixed arity version of the extensible function being called, 0 if calling the varargs version */
+      int inline_param_count = 0;
       for(int i = 1; (param_name = fp_iterator.next()) != NULL; i++) {
         if (fp_iterator.is_extensible_param() && (!found_first_extensible_parameter)) {
-          /* We are calling an extensible function. Before passing the extensible
-           * parameters, we must add a dummy paramater value to tell the called
-           * function how many extensible parameters we will be passing.
-           *
-           * Note that stage 3 has already determined the number of extensible
-           * paramters, and stored that info in the abstract syntax tree. We simply
-           * re-use that value.
-           */
-          /* NOTE: we are not freeing the malloc'd memory. This is not really a bug.
-           *       Since we are writing a compiler, which runs to termination quickly,
-           *       we can consider this as just memory required for the compilation process
-           *       that will be free'd when the program terminates.
+          /* With up to MAX_INLINE_PARAM_COUNT extensible parameters we call the fixed arity
+           * version of the function instead (e.g. ADD__INT__INT3() instead of ADD__INT__INT()),
+           * which does not take the number of parameters and reduces to a plain C expression.
            */
-          char *tmp = (char *)malloc(32); /* enough space for a call with 10^31 (larger than 2^64) input parameters! */
-          if (tmp == NULL) ERROR;
-          int res = snprintf(tmp, 32, "%d", symbol->extensible_param_count);
-          if ((res >= 32) || (res < 0)) ERROR;
-          identifier_c *param_value = new identifier_c(tmp);
-          uint_type_name_c *param_type  = new uint_type_name_c();
-          identifier_c *param_name = new identifier_c(INLINE_PARAM_COUNT);
-          ADD_PARAM_LIST(param_name, param_value, param_type, function_param_iterator_c::direction_in)
+          if ((symbol->extensible_param_count > 0) && (symbol->extensible_param_count <= MAX_INLINE_PARAM_COUNT)) {
+            inline_param_count = symbol->extensible_param_count;
+          } else {
+            /* We are calling an extensible function. Before passing the extensible
+             * parameters, we must add a dummy paramater value to tell the called
+             * function how many extensible parameters we will be passing.
+             *
+             * Note that stage 3 has already determined the number of extensible
+             * paramters, and stored that info in the abstract syntax tree. We simply
+             * re-use that value.
+             */
+            /* NOTE: we are not freeing the malloc'd memory. This is not really a bug.
+             *       Since we are writing a compiler, which runs to termination quickly,
+             *       we can consider this as just memory required for the compilation process
+             *       that will be free'd when the program terminates.
+             */
+            char *tmp = (char *)malloc(32); /* enough space for a call with 10^31 (larger than 2^64) input parameters! */
+            if (tmp == NULL) ERROR;
+            int res = snprintf(tmp, 32, "%d", symbol->extensible_param_count);
+            if ((res >= 32) || (res < 0)) ERROR;
+            identifier_c *param_value = new identifier_c(tmp);
+            uint_type_name_c *param_type  = new uint_type_name_c();
+            identifier_c *param_name = new identifier_c(INLINE_PARAM_COUNT);
+            ADD_PARAM_LIST(param_name, param_value, param_type, function_param_iterator_c::direction_in)
+          }
           found_first_extensible_parameter = true;
         }
         
@@ -724,7 +748,7 @@ class generate_c_inlinefcall_c: public generate_c_base_and_typeid_c {
         f_decl = NULL; 
 
       if (has_output_params)
-        generate_inline(function_name, function_type_prefix, function_type_suffix, param_list, f_decl);
+        generate_inline(function_name, function_type_prefix, function_type_suffix, param_list, f_decl, inline_param_count);
 
       CLEAR_PARAM_LIST()
       return NULL;
@@ -794,29 +818,39 @@ class generate_c_inlinefcall_c: public generate_c_base_and_typeid_c {
       identifier_c *param_name;
         /* flag to cirreclty handle calls to extensible standard functions (i.e. functions with variable number of input parameters) */
       bool found_first_extensible_parameter = false;  
+      /* number of inputs of the fixed arity version of the extensible function being called, 0 if calling the varargs version */
+      int inline_param_count = 0;
       for(int i = 1; (param_name = fp_iterator.next()) != NULL; i++) {
         if (fp_iterator.is_extensible_param() && (!found_first_extensible_parameter)) {
-          /* We are calling an extensible function. Before passing the extensible
-           * parameters, we must add a dummy paramater value to tell the called
-           * function how many extensible parameters we will be passing.
-           *
-           * Note that stage 3 has already determined the number of extensible
-           * paramters, and stored that info in the abstract syntax tree. We simply
-           * re-use that value.
-           */
-          /* NOTE: we are not freeing the malloc'd memory. This is not really a bug.
-           *       Since we are writing a compiler, which runs to termination quickly,
-           *       we can consider this as just memory required for the compilation process
-           *       that will be free'd when the program terminates.
+          /* With up to MAX_INLINE_PARAM_COUNT extensible parameters we call the fixed arity
+           * version of the function instead (e.g. ADD__INT__INT3() instead of ADD__INT__INT()),
+           * which does not take the number of parameters and reduces to a plain C expression.
            */
-          char *tmp = (char *)malloc(32); /* enough space for a call with 10^31 (larger than 2^64) input parameters! */
-          if (tmp == NULL) ERROR;
-          int res = snprintf(tmp, 32, "%d", symbol->extensible_param_count);
-          if ((res >= 32) || (res < 0)) ERROR;
-          identifier_c *param_value = new identifier_c(tmp);
-          uint_type_name_c *param_type  = new uint_type_name_c();
-          identifier_c *param_name = new identifier_c(INLINE_PARAM_COUNT);
-          ADD_PARAM_LIST(param_name, param_value, param_type, function_param_iterator_c::direction_in)
+          if ((symbol->extensible_param_count > 0) && (symbol->extensible_param_count <= MAX_INLINE_PARAM_COUNT)) {
+            inline_param_count = symbol->extensible_param_count;
+          } else {
+            /* We are calling an extensible function. Before passing the extensible
+             * parameters, we must add a dummy paramater value to tell the called
+             * function how many extensible parameters we will be passing.
+             *
+             * Note that stage 3 has already determined the number of extensible
+             * paramters, and stored that info in the abstract syntax tree. We simply
+             * re-use that value.
+             */
+            /* NOTE: we are not freeing the malloc'd memory. This is not really a bug.
+             *       Since we are writing a compiler, which runs to termination quickly,
+             *       we can consider this as just memory required for the compilation process
+             *       that will be free'd when the program terminates.
+             */
+            char *tmp = (char *)malloc(32); /* enough space for a call with 10^31 (larger than 2^64) input parameters! */
+            if (tmp == NULL) ERROR;
+            int res = snprintf(tmp, 32, "%d", symbol->extensible_param_count);
+            if ((res >= 32) || (res < 0)) ERROR;
+            identifier_c *param_value = new identifier_c(tmp);
+            uint_type_name_c *param_type  = new uint_type_name_c();
+            identifier_c *param_name = new identifier_c(INLINE_PARAM_COUNT);
+            ADD_PARAM_LIST(param_name, param_value, param_type, function_param_iterator_c::direction_in)
+          }
           found_first_extensible_parameter = true;
         }
     
@@ -887,7 +921,7 @@ class generate_c_inlinefcall_c: public generate_c_base_and_typeid_c {
         f_decl = NULL; 
 
       if (has_output_params)
-        generate_inline(function_name, function_type_prefix, function_type_suffix, param_list, f_decl);
+        generate_inline(function_name, function_type_prefix, function_type_suffix, param_list, f_decl, inline_param_count);
 
       CLEAR_PARAM_LIST()
 
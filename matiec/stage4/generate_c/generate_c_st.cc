@@ -38,6 +38,22 @@
 
 #include "../../util/strdup.hh"
 
+
+/* The standard functions returning a STRING that also have a _BY_REF version,
+ * which takes the STRING inputs by reference and writes the result through a
+ * pointer passed first (see lib/C/iec_std_functions.h). CONCAT only has it in
+ * its fixed arity versions.
+ */
+static const char *by_ref_string_functions[] = {
+  "LEFT", "RIGHT", "MID", "INSERT", "DELETE", "REPLACE",
+  "BOOL_TO_STRING", "BYTE_TO_STRING", "WORD_TO_STRING", "DWORD_TO_STRING", "LWORD_TO_STRING",
+  "SINT_TO_STRING", "INT_TO_STRING", "DINT_TO_STRING", "LINT_TO_STRING",
+  "USINT_TO_STRING", "UINT_TO_STRING", "UDINT_TO_STRING", "ULINT_TO_STRING",
+  "REAL_TO_STRING", "LREAL_TO_STRING",
+  "TIME_TO_STRING", "DATE_TO_STRING", "TOD_TO_STRING", "DT_TO_STRING",
+  NULL
+};
+
 /***********************************************************************/
 /***********************************************************************/
 /***********************************************************************/
@@ -84,6 +100,13 @@ class generate_c_st_c: public generate_c_base_and_typeid_c {
 
     variablegeneration_t wanted_variablegeneration;
 
+    /* The variable (and its type) the STRING returned by a function is assigned to.
+     * Set by the assignment statement for the function invocation that follows,
+     * which writes the result straight into it when it can.
+     */
+    symbol_c *string_dest;
+    symbol_c *string_dest_type;
+
   public:
     generate_c_st_c(stage4out_c *s4o_ptr, symbol_c *name, symbol_c *scope, const char *variable_prefix = NULL)
     : generate_c_base_and_typeid_c(s4o_ptr) {
@@ -98,6 +121,8 @@ class generate_c_st_c: public generate_c_base_and_typeid_c {
       fcall_number = 0;
       fbname = name;
       wanted_variablegeneration = expression_vg;
+      string_dest = NULL;
+      string_dest_type = NULL;
     }
 
     virtual ~generate_c_st_c(void) {
@@ -220,6 +245,81 @@ void *print_setter(symbol_c* symbol,
   return NULL;
 }
 
+
+/* Whether symbol can be set by the _BY_REF version of a function, i.e. it is
+ * not inside an external function block.
+ */
+bool can_set_by_ref(symbol_c *symbol) {
+  if (analyse_variable_c::first_nonfb_vardecltype(symbol, scope_) != search_var_instance_decl_c::external_vt)
+    return true;
+  symbol_c *first_nonfb = analyse_variable_c::find_first_nonfb(symbol);
+  if (first_nonfb == NULL) ERROR;
+  if (!get_datatype_info_c::is_type_valid(first_nonfb->datatype)) ERROR;
+  return !get_datatype_info_c::is_function_block(first_nonfb->datatype);
+}
+
+/* Prints the setter of symbol for the _BY_REF version of a function, up to the
+ * function name (e.g. "__SET_VAR_BY_REF(data__->,S,,").
+ */
+void *print_setter_by_ref(symbol_c *symbol) {
+  unsigned int vartype = analyse_variable_c::first_nonfb_vardecltype(symbol, scope_);
+  if (vartype == search_var_instance_decl_c::external_vt)
+    s4o.print(SET_EXTERNAL_BY_REF);
+  else if (vartype == search_var_instance_decl_c::located_vt)
+    s4o.print(SET_LOCATED_BY_REF);
+  else
+    s4o.print(SET_VAR_BY_REF);
+  s4o.print("(");
+  print_variable_prefix();
+  s4o.print(",");
+  wanted_variablegeneration = complextype_base_vg;
+  symbol->accept(*this);
+  s4o.print(",");
+  wanted_variablegeneration = complextype_suffix_vg;
+  symbol->accept(*this);
+  s4o.print(",");
+  wanted_variablegeneration = expression_vg;
+  return NULL;
+}
+
+
+void *print_assignment(symbol_c *l_exp, symbol_c *type, symbol_c *r_exp) {
+  if (this->is_variable_prefix_null()) {
+    l_exp->accept(*this);
+    s4o.print(" = ");
+    print_check_function(type, r_exp);
+  }
+  else {
+    print_setter(l_exp, type, r_exp);
+  }
+  return NULL;
+}
+
+
+bool is_string_type(symbol_c *type) {
+  return (type != NULL) && (typeid(*type) == typeid(string_type_name_c));
+}
+
+bool is_by_ref_string_function(symbol_c *function_name, int inline_param_count) {
+  token_c *name = dynamic_cast<token_c *>(function_name);
+  if (name == NULL) return false;
+  if (strcasecmp(name->value, "CONCAT") == 0) return inline_param_count > 0;
+  for (int i = 0; by_ref_string_functions[i] != NULL; i++)
+    if (strcasecmp(name->value, by_ref_string_functions[i]) == 0) return true;
+  return false;
+}
+
+/* The STRING inputs of the _BY_REF functions are passed by address, so they
+ * must be variables or literals.
+ */
+bool is_by_ref_string_param(symbol_c *param_value) {
+  if (param_value == NULL) return false;
+  return (typeid(*param_value) == typeid(symbolic_variable_c)) ||
+         (typeid(*param_value) == typeid(structured_variable_c)) ||
+         (typeid(*param_value) == typeid(array_variable_c)) ||
+         (typeid(*param_value) == typeid(single_byte_character_string_c));
+}
+
 /********************************/
 /* B 1.3.3 - Derived data types */
 /********************************/
@@ -723,6 +823,10 @@ void *visit(function_invocation_c *symbol) {
   symbol_c* function_name = NULL;
   DECLARE_PARAM_LIST()
 
+  /* Set when the result is assigned to a STRING variable, see visit(assignment_statement_c) */
+  symbol_c *dest = string_dest, *dest_type = string_dest_type;
+  string_dest = string_dest_type = NULL;
+
   symbol_c *parameter_assignment_list = NULL;
   if (NULL != symbol->   formal_param_list) parameter_assignment_list = symbol->   formal_param_list;
   if (NULL != symbol->nonformal_param_list) parameter_assignment_list = symbol->nonformal_param_list;
@@ -743,29 +847,39 @@ void *visit(function_invocation_c *symbol) {
   identifier_c *param_name;
     /* flag to cirreclty handle calls to extensible standard functions (i.e. functions with variable number of input parameters) */
   bool found_first_extensible_parameter = false;  
+  /* number of inputs of the fixed arity version of the extensible function being called, 0 if calling the varargs version */
+  int inline_param_count = 0;
   for(int i = 1; (param_name = fp_iterator.next()) != NULL; i++) {
     if (fp_iterator.is_extensible_param() && (!found_first_extensible_parameter)) {
-      /* We are calling an extensible function. Before passing the extensible
-       * parameters, we must add a dummy paramater value to tell the called
-       * function how many extensible parameters we will be passing.
-       *
-       * Note that stage 3 has already determined the number of extensible
-       * paramters, and stored that info in the abstract syntax tree. We simply
-       * re-use that value.
-       */
-      /* NOTE: we are not freeing the malloc'd memory. This is not really a bug.
-       *       Since we are writing a compiler, which runs to termination quickly,
-       *       we can consider this as just memory required for the compilation process
-       *       that will be free'd when the program terminates.
+      /* With up to MAX_INLINE_PARAM_COUNT extensible parameters we call the fixed arity
+       * version of the function instead (e.g. ADD__INT__INT3() instead of ADD__INT__INT()),
+       * which does not take the number of parameters and reduces to a plain C expression.
        */
-      char *tmp = (char *)malloc(32); /* enough space for a call with 10^31 (larger than 2^64) input parameters! */
-      if (tmp == NULL) ERROR;
-      int res = snprintf(tmp, 32, "%d", symbol->extensible_param_count);
-      if ((res >= 32) || (res < 0)) ERROR;
-      identifier_c *param_value = new identifier_c(tmp);
-      uint_type_name_c *param_type  = new uint_type_name_c();
-      identifier_c *param_name = new identifier_c("");
-      ADD_PARAM_LIST(param_name, param_value, param_type, function_param_iterator_c::direction_in)
+      if ((symbol->extensible_param_count > 0) && (symbol->extensible_param_count <= MAX_INLINE_PARAM_COUNT)) {
+        inline_param_count = symbol->extensible_param_count;
+      } else {
+        /* We are calling an extensible function. Before passing the extensible
+         * parameters, we must add a dummy paramater value to tell the called
+         * function how many extensible parameters we will be passing.
+         *
+         * Note that stage 3 has already determined the number of extensible
+         * paramters, and stored that info in the abstract syntax tree. We simply
+         * re-use that value.
+         */
+        /* NOTE: we are not freeing the malloc'd memory. This is not really a bug.
+         *       Since we are writing a compiler, which runs to termination quickly,
+         *       we can consider this as just memory required for the compilation process
+         *       that will be free'd when the program terminates.
+         */
+        char *tmp = (char *)malloc(32); /* enough space for a call with 10^31 (larger than 2^64) input parameters! */
+        if (tmp == NULL) ERROR;
+        int res = snprintf(tmp, 32, "%d", symbol->extensible_param_count);
+        if ((res >= 32) || (res < 0)) ERROR;
+        identifier_c *param_value = new identifier_c(tmp);
+        uint_type_name_c *param_type  = new uint_type_name_c();
+        identifier_c *param_name = new identifier_c("");
+        ADD_PARAM_LIST(param_name, param_value, param_type, function_param_iterator_c::direction_in)
+      }
       found_first_extensible_parameter = true;
     }
 
@@ -829,6 +943,23 @@ void *visit(function_invocation_c *symbol) {
     }
   }
 
+  /* Call the _BY_REF version of the function, writing the result straight into
+   * dest, when all the STRING inputs are variables or literals. Otherwise the
+   * result is returned by value and assigned as usual.
+   */
+  bool by_ref = (dest != NULL) && !has_output_params &&
+                is_by_ref_string_function(function_name, inline_param_count) &&
+                (this->is_variable_prefix_null() || can_set_by_ref(dest));
+  PARAM_LIST_ITERATOR() {
+    if ((PARAM_DIRECTION == function_param_iterator_c::direction_in) &&
+        is_string_type(PARAM_TYPE) && !is_by_ref_string_param(PARAM_VALUE))
+      by_ref = false;
+  }
+  if ((dest != NULL) && !by_ref) {
+    CLEAR_PARAM_LIST()
+    return print_assignment(dest, dest_type, symbol);
+  }
+
   /* Check whether we are calling an overloaded function! */
   /* (fdecl_mutiplicity > 1)  => calling overloaded function */
   int fdecl_mutiplicity =  function_symtable.count(symbol->function_name);
@@ -849,6 +980,8 @@ void *visit(function_invocation_c *symbol) {
     s4o.print(fcall_number);
   }
   else {
+    if (by_ref && !this->is_variable_prefix_null())
+      print_setter_by_ref(dest);
     function_name->accept(*this);
     if (fdecl_mutiplicity > 1) {
       /* function being called is overloaded! */
@@ -856,12 +989,26 @@ void *visit(function_invocation_c *symbol) {
       print_function_parameter_data_types_c overloaded_func_suf(&s4o);
       f_decl->accept(overloaded_func_suf);
     }
+    if (inline_param_count > 0)
+      s4o.print(inline_param_count);
+    if (by_ref)
+      s4o.print("_BY_REF");
   }
-  s4o.print("(");
+  if (by_ref && !this->is_variable_prefix_null())
+    s4o.print(",");
+  else
+    s4o.print("(");
   s4o.indent_right();
   s4o.print("\n"+s4o.indent_spaces);
   
   int nb_param = 0;
+  if (by_ref && this->is_variable_prefix_null()) {
+    /* the setter passes dest otherwise */
+    wanted_variablegeneration = fparam_output_vg;
+    dest->accept(*this);
+    wanted_variablegeneration = expression_vg;
+    nb_param++;
+  }
   PARAM_LIST_ITERATOR() {
     symbol_c *param_value = PARAM_VALUE;
     current_param_type = PARAM_TYPE;
@@ -875,6 +1022,20 @@ void *visit(function_invocation_c *symbol) {
           param_value = type_initial_value_c::get(current_param_type);
         }
         if (param_value == NULL) ERROR;
+        if (by_ref && is_string_type(current_param_type)) {
+          if (typeid(*param_value) == typeid(single_byte_character_string_c)) {
+            s4o.print("__STRING_REF(");
+            param_value->accept(*this);
+            s4o.print(")");
+          }
+          else {
+            wanted_variablegeneration = fparam_output_vg;
+            param_value->accept(*this);
+            wanted_variablegeneration = expression_vg;
+          }
+          nb_param++;
+          break;
+        }
         s4o.print("(");
         if      (get_datatype_info_c::is_ANY_INT_literal(current_param_type))
           get_datatype_info_c::lint_type_name.accept(*this);
@@ -939,15 +1100,13 @@ void *visit(statement_list_c *symbol) {
 void *visit(assignment_statement_c *symbol) {
   symbol_c *left_type = search_varfb_instance_type->get_type_id(symbol->l_exp);
   
-  if (this->is_variable_prefix_null()) {
-    symbol->l_exp->accept(*this);
-    s4o.print(" = ");
-    print_check_function(left_type, symbol->r_exp);
-  }
-  else {
-    print_setter(symbol->l_exp, left_type, symbol->r_exp);
+  if (is_string_type(symbol->l_exp->datatype) && (typeid(*symbol->r_exp) == typeid(function_invocation_c))) {
+    /* the function invocation prints the assignment, see visit(function_invocation_c) */
+    string_dest = symbol->l_exp;
+    string_dest_type = left_type;
+    return symbol->r_exp->accept(*this);
   }
-  return NULL;
+  return print_assignment(symbol->l_exp, left_type, symbol->r_exp);
 }
 
 /*****************************************/
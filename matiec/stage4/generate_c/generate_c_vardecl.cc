@@ -845,6 +845,13 @@ class generate_c_vardecl_c: protected generate_c_base_and_typeid_c {
      *               underlined code of the above examples,
      *               and no more!!
      *
+     * retain_vf: handing the variables to the backup/restore operation
+     *           of a FB/PROGRAM instance, if their RETAIN flag was set
+     *           when the instance was initialised.
+     *           e.g.
+     *                __RETAIN_VAR(data__->A)
+     *                __RETAIN_FB(TON,data__->T)
+     *
      * globalinit_vf: initialising of static c++ variables. These
      *                variables may have been declared as static inside
      *                a class, in which case the scope within which they were
@@ -861,7 +868,8 @@ class generate_c_vardecl_c: protected generate_c_base_and_typeid_c {
                   init_vf,
                   constructorinit_vf,
                   globalinit_vf,
-                  globalprototype_vf
+                  globalprototype_vf,
+                  retain_vf
                  } varformat_t;
 
 
@@ -1128,6 +1136,25 @@ class generate_c_vardecl_c: protected generate_c_base_and_typeid_c {
         }
       }
 
+      if (wanted_varformat == retain_vf) {
+        for(int i = 0; i < list->n; i++) {
+          s4o.print(s4o.indent_spaces);
+          if (is_fb) {
+            s4o.print(RETAIN_FB);
+            s4o.print("(");
+            this->current_var_type_symbol->accept(*this);
+            s4o.print(",");
+          }
+          else {
+            s4o.print(RETAIN_VAR);
+            s4o.print("(");
+          }
+          this->print_variable_prefix();
+          list->get_element(i)->accept(*this);
+          s4o.print(")\n");
+        }
+      }
+
       if (wanted_varformat == constructorinit_vf) {
         for(int i = 0; i < list->n; i++) {
           if (is_fb) {
@@ -1825,6 +1852,18 @@ void *visit(located_var_decl_c *symbol) {
       }
       break;
 
+    case retain_vf:
+      s4o.print(s4o.indent_spaces);
+      s4o.print(RETAIN_LOCATED);
+      s4o.print("(");
+      print_variable_prefix();
+      if (symbol->variable_name != NULL)
+        symbol->variable_name->accept(*this);
+      else
+        symbol->location->accept(*this);
+      s4o.print(")\n");
+      break;
+
     case globalinit_vf:
       s4o.print(s4o.indent_spaces + "__plc_pt_c<");
       this->current_var_type_symbol->accept(*this);
@@ -2189,7 +2228,6 @@ void *visit(global_var_list_c *symbol) {
           }
           print_retain();
           s4o.print(")");
-          current_varqualifier = none_vq;
 #if 0
       /* The following code would be for globalinit_vf !!
        * But it is not currently required...
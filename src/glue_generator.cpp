@@ -1,6 +1,7 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <sstream>
 
 #include <string.h>
 #include <stdlib.h>
@@ -9,6 +10,7 @@ using namespace std;
 
 ifstream locatedVars;
 ofstream glueVars;
+stringstream validateVars;
 
 void generateHeader()
 {
@@ -163,6 +165,8 @@ void glueVar(char *varName, char *varType)
 {
 	cout << "varName: " << varName << "\tvarType: " << varType << endl;
 	int pos1, pos2;
+	stringstream target;
+	string cast = "";
 
 	findPositions(varName, &pos1, &pos2);
 
@@ -177,13 +181,13 @@ void glueVar(char *varName, char *varType)
 		switch (varName[3])
 		{
 			case 'X':
-				glueVars << "\tbool_input[" << pos1 << "][" << pos2 << "] = " << varName << ";\r\n";
+				target << "bool_input[" << pos1 << "][" << pos2 << "]";
 				break;
 			case 'B':
-				glueVars << "\tbyte_input[" << pos1 << "] = " << varName << ";\r\n";
+				target << "byte_input[" << pos1 << "]";
 				break;
 			case 'W':
-				glueVars << "\tint_input[" << pos1 << "] = " << varName << ";\r\n";
+				target << "int_input[" << pos1 << "]";
 				break;
 		}
 	}
@@ -193,13 +197,13 @@ void glueVar(char *varName, char *varType)
 		switch (varName[3])
 		{
 			case 'X':
-				glueVars << "\tbool_output[" << pos1 << "][" << pos2 << "] = " << varName << ";\r\n";
+				target << "bool_output[" << pos1 << "][" << pos2 << "]";
 				break;
            		case 'B':
-				glueVars << "\tbyte_output[" << pos1 << "] = " << varName << ";\r\n";
+				target << "byte_output[" << pos1 << "]";
 				break;
 			case 'W':
-				glueVars << "\tint_output[" << pos1 << "] = " << varName << ";\r\n";
+				target << "int_output[" << pos1 << "]";
 				break;
 		}
 	}
@@ -209,24 +213,46 @@ void glueVar(char *varName, char *varType)
 		switch (varName[3])
 		{
 			case 'W':
-				glueVars << "\tint_memory[" << pos1 << "] = " << varName << ";\r\n";
+				target << "int_memory[" << pos1 << "]";
 				break;
 			case 'D':
-				glueVars << "\tdint_memory[" << pos1 << "] = (IEC_DINT *)" << varName << ";\r\n";
+				target << "dint_memory[" << pos1 << "]";
+				cast = "(IEC_DINT *)";
 				break;
 			case 'L':
-				glueVars << "\tlint_memory[" << pos1 << "] = (IEC_LINT *)" << varName << ";\r\n";
+				target << "lint_memory[" << pos1 << "]";
+				cast = "(IEC_LINT *)";
 				break;
 		}
 	}
+
+	if (target.str().empty())
+		return;
+
+	glueVars << "\t" << target.str() << " = " << cast << varName << ";\r\n";
+	validateVars << "\tif (" << target.str() << " != " << cast << varName << ") unbound++;\r\n";
 }
 
 void generateBottom()
 {
 	glueVars << "}\r\n\
 \r\n\
+//Returns the number of buffer pointers that are no longer bound to their\r\n\
+//located variable\r\n\
+int validateGlueVars()\r\n\
+{\r\n\
+	int unbound = 0;\r\n\
+\r\n";
+	glueVars << validateVars.str();
+	glueVars << "\r\n\
+	return unbound;\r\n\
+}\r\n\
+\r\n\
 void updateTime()\r\n\
 {\r\n\
+#ifdef IEC_TIME_NS\r\n\
+	__CURRENT_TIME += common_ticktime__;\r\n\
+#else\r\n\
 	__CURRENT_TIME.tv_nsec += common_ticktime__;\r\n\
 \r\n\
 	if (__CURRENT_TIME.tv_nsec >= 1000000000)\r\n\
@@ -234,6 +260,7 @@ void updateTime()\r\n\
 		__CURRENT_TIME.tv_nsec -= 1000000000;\r\n\
 		__CURRENT_TIME.tv_sec += 1;\r\n\
 	}\r\n\
+#endif\r\n\
 }";
 }
 
@@ -0,0 +1,428 @@
+//-----------------------------------------------------------------------------
+// Copyright 2019 Novasom Industries
+//
+// Based on the software by Thiago Alves
+// This file is part of the OpenPLC Software Stack.
+//
+// OpenPLC is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenPLC is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenPLC.  If not, see <http://www.gnu.org/licenses/>.
+//------
+//
+// Load generator for the Modbus/TCP server of the NOVAplc. It opens N
+// connections, sends a mix of FC 1, 3 and 16 requests (optionally pipelined)
+// for a given time and reports the throughput and the latency percentiles.
+// When the runtime is on the same machine it also reports the scan cycle
+// overruns that happened during the run, read from /dev/shm/novaplc_stats.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+
+#include "../core/ladder.h"
+
+#define MAX_CONNECTIONS		256
+#define MAX_PIPELINE		16
+
+struct bench_options
+{
+	const char *host;
+	int port;
+	int connections;
+	int duration;
+	int pipeline;
+	int address;
+	int quantity;
+	int weight[3]; //FC 1, 3, 16
+};
+
+struct bench_thread
+{
+	pthread_t thread;
+	int index;
+	uint64_t transactions;
+	uint64_t errors;
+	uint64_t per_fc[3];
+	uint64_t latency[SCAN_HIST_BUCKETS];
+	uint64_t max_latency;
+	int failed;
+};
+
+static struct bench_options opts;
+static struct bench_thread threads[MAX_CONNECTIONS];
+static volatile int running = 1;
+static const int fc_codes[3] = { 1, 3, 16 };
+
+//-----------------------------------------------------------------------------
+// Helper function - Current time in nanoseconds
+//-----------------------------------------------------------------------------
+static inline uint64_t nowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Latency (in microseconds) below which the given fraction
+// of the transactions falls. The buckets are those of the scan statistics
+// (core/scan_hist.h)
+//-----------------------------------------------------------------------------
+static uint64_t histPercentile(uint64_t *hist, uint64_t count, double fraction)
+{
+	int bucket = scanHistRank(hist, count, fraction);
+
+	return bucket >= 0 ? scanHistBucketValue(bucket) : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Picks the function code of the next request according to the mix
+//-----------------------------------------------------------------------------
+static int pickFunction(unsigned int *seed)
+{
+	int total = opts.weight[0] + opts.weight[1] + opts.weight[2];
+	int r = rand_r(seed) % total;
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (r < opts.weight[i]) return i;
+		r -= opts.weight[i];
+	}
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Builds a request. Returns its size in bytes
+//-----------------------------------------------------------------------------
+static int buildRequest(unsigned char *buffer, uint16_t tid, int fc)
+{
+	int length;
+
+	buffer[0] = tid >> 8;
+	buffer[1] = tid & 0xff;
+	buffer[2] = 0;
+	buffer[3] = 0;
+	buffer[6] = 1;
+	buffer[7] = fc_codes[fc];
+	buffer[8] = opts.address >> 8;
+	buffer[9] = opts.address & 0xff;
+	buffer[10] = opts.quantity >> 8;
+	buffer[11] = opts.quantity & 0xff;
+
+	if (fc_codes[fc] == 16)
+	{
+		buffer[12] = opts.quantity * 2;
+		for (int i = 0; i < opts.quantity; i++)
+		{
+			buffer[13 + i * 2] = tid >> 8;
+			buffer[14 + i * 2] = i;
+		}
+		length = 13 + opts.quantity * 2;
+	}
+	else
+	{
+		length = 12;
+	}
+
+	buffer[4] = (length - 6) >> 8;
+	buffer[5] = (length - 6) & 0xff;
+
+	return length;
+}
+
+//-----------------------------------------------------------------------------
+// Helper function - Reads exactly size bytes
+//-----------------------------------------------------------------------------
+static int readAll(int fd, unsigned char *buffer, int size)
+{
+	int total = 0;
+
+	while (total < size)
+	{
+		int n = read(fd, buffer + total, size - total);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return -1;
+		total += n;
+	}
+
+	return total;
+}
+
+//-----------------------------------------------------------------------------
+// One connection. Sends a batch of pipelined requests, waits for all the
+// responses and starts again until the time is over
+//-----------------------------------------------------------------------------
+static void *benchThread(void *arg)
+{
+	struct bench_thread *t = (struct bench_thread *)arg;
+	unsigned char request[MAX_PIPELINE * 260];
+	unsigned char response[260];
+	unsigned int seed = t->index + 1;
+	uint16_t tid = 0;
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(opts.port);
+	struct hostent *host = gethostbyname(opts.host);
+	if (host == NULL)
+	{
+		t->failed = 1;
+		return NULL;
+	}
+	memcpy(&addr.sin_addr, host->h_addr, host->h_length);
+
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+	{
+		printf("Connection %d: could not connect to %s:%d\n", t->index, opts.host, opts.port);
+		t->failed = 1;
+		if (fd >= 0) close(fd);
+		return NULL;
+	}
+	int nodelay = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+	while (running)
+	{
+		int size = 0;
+
+		for (int i = 0; i < opts.pipeline; i++)
+		{
+			int fc = pickFunction(&seed);
+			size += buildRequest(request + size, tid++, fc);
+			t->per_fc[fc]++;
+		}
+
+		//the whole batch leaves with one write, so it shares the send time
+		uint64_t start = nowNs();
+		if (write(fd, request, size) != size)
+		{
+			printf("Connection %d: write failed\n", t->index);
+			t->failed = 1;
+			break;
+		}
+
+		for (int i = 0; i < opts.pipeline; i++)
+		{
+			if (readAll(fd, response, 6) < 0)
+			{
+				printf("Connection %d: connection closed by the server\n", t->index);
+				t->failed = 1;
+				break;
+			}
+
+			int length = (response[4] << 8) | response[5];
+			if (length < 2 || length > 254 || readAll(fd, response + 6, length) < 0)
+			{
+				printf("Connection %d: invalid response\n", t->index);
+				t->failed = 1;
+				break;
+			}
+
+			uint64_t latency = nowNs() - start;
+
+			t->latency[scanHistBucket(latency / 1000)]++;
+			if (latency / 1000 > t->max_latency) t->max_latency = latency / 1000;
+			if (response[7] & 0x80) t->errors++;
+			t->transactions++;
+		}
+
+		if (t->failed) break;
+	}
+
+	close(fd);
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Maps the scan statistics published by the runtime. Returns NULL if the
+// runtime is not running on this machine
+//-----------------------------------------------------------------------------
+static struct scan_stats *mapScanStats()
+{
+	int fd = shm_open(SCAN_STATS_SHM, O_RDONLY, 0);
+	if (fd < 0) return NULL;
+
+	void *area = mmap(NULL, sizeof(struct scan_stats), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (area == MAP_FAILED) return NULL;
+
+	struct scan_stats *stats = (struct scan_stats *)area;
+	if (__atomic_load_n(&stats->magic, __ATOMIC_ACQUIRE) != SCAN_STATS_MAGIC)
+	{
+		munmap(area, sizeof(struct scan_stats));
+		return NULL;
+	}
+
+	return stats;
+}
+
+//-----------------------------------------------------------------------------
+// Parses the request mix, for example "1:1,3:4,16:1"
+//-----------------------------------------------------------------------------
+static int parseMix(const char *mix)
+{
+	opts.weight[0] = opts.weight[1] = opts.weight[2] = 0;
+
+	while (*mix)
+	{
+		int fc, weight;
+		if (sscanf(mix, "%d:%d", &fc, &weight) != 2) return -1;
+
+		if (fc == 1) opts.weight[0] = weight;
+		else if (fc == 3) opts.weight[1] = weight;
+		else if (fc == 16) opts.weight[2] = weight;
+		else return -1;
+
+		while (*mix && *mix != ',') mix++;
+		if (*mix == ',') mix++;
+	}
+
+	return (opts.weight[0] + opts.weight[1] + opts.weight[2]) > 0 ? 0 : -1;
+}
+
+void print_usage()
+{
+	printf("Usage: ./modbus_bench [-h host] [-p port] [-c connections] [-d seconds]\n");
+	printf("                      [-q pipeline] [-m mix] [-a address] [-n quantity]\n");
+	printf("-c number of concurrent connections (default 4)\n");
+	printf("-d duration of the test in seconds (default 10)\n");
+	printf("-q requests sent back to back on each connection, 1 to %d (default 1)\n", MAX_PIPELINE);
+	printf("-m weights of FC 1, 3 and 16 in the mix (default 1:1,3:1,16:1)\n");
+	printf("-a first coil/register accessed (default 0), -n number of them (default 10)\n");
+}
+
+int main(int argc, char **argv)
+{
+	int opt;
+
+	opts.host = "127.0.0.1";
+	opts.port = 502;
+	opts.connections = 4;
+	opts.duration = 10;
+	opts.pipeline = 1;
+	opts.address = 0;
+	opts.quantity = 10;
+	parseMix("1:1,3:1,16:1");
+
+	while ((opt = getopt(argc, argv, "h:p:c:d:q:m:a:n:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'h': opts.host = optarg; break;
+			case 'p': opts.port = atoi(optarg); break;
+			case 'c': opts.connections = atoi(optarg); break;
+			case 'd': opts.duration = atoi(optarg); break;
+			case 'q': opts.pipeline = atoi(optarg); break;
+			case 'a': opts.address = atoi(optarg); break;
+			case 'n': opts.quantity = atoi(optarg); break;
+			case 'm':
+				if (parseMix(optarg) < 0)
+				{
+					printf("Invalid mix %s\n", optarg);
+					return 1;
+				}
+				break;
+			default:
+				print_usage();
+				return 1;
+		}
+	}
+
+	if (opts.connections < 1 || opts.connections > MAX_CONNECTIONS ||
+		opts.pipeline < 1 || opts.pipeline > MAX_PIPELINE ||
+		opts.quantity < 1 || opts.quantity > 120 || opts.duration < 1)
+	{
+		print_usage();
+		return 1;
+	}
+
+	struct scan_stats *stats = mapScanStats();
+	uint64_t cycles_before = 0, overruns_before = 0;
+	if (stats != NULL)
+	{
+		cycles_before = __atomic_load_n(&stats->cycles, __ATOMIC_RELAXED);
+		overruns_before = __atomic_load_n(&stats->overruns, __ATOMIC_RELAXED);
+	}
+
+	printf("Running %d connections x %d pipelined requests against %s:%d for %d s\n",
+		opts.connections, opts.pipeline, opts.host, opts.port, opts.duration);
+
+	uint64_t start = nowNs();
+	for (int i = 0; i < opts.connections; i++)
+	{
+		threads[i].index = i;
+		pthread_create(&threads[i].thread, NULL, benchThread, &threads[i]);
+	}
+
+	sleep(opts.duration);
+	running = 0;
+
+	for (int i = 0; i < opts.connections; i++)
+		pthread_join(threads[i].thread, NULL);
+	double elapsed = (nowNs() - start) / 1e9;
+
+	//merge the results of all the connections
+	static uint64_t latency[SCAN_HIST_BUCKETS];
+	uint64_t transactions = 0, errors = 0, max_latency = 0, per_fc[3] = { 0, 0, 0 };
+	int failed = 0;
+	for (int i = 0; i < opts.connections; i++)
+	{
+		struct bench_thread *t = &threads[i];
+		transactions += t->transactions;
+		errors += t->errors;
+		failed += t->failed;
+		if (t->max_latency > max_latency) max_latency = t->max_latency;
+		for (int f = 0; f < 3; f++) per_fc[f] += t->per_fc[f];
+		for (int b = 0; b < SCAN_HIST_BUCKETS; b++) latency[b] += t->latency[b];
+	}
+
+	printf("Transactions: %llu in %.2f s (%.0f per second), %llu exceptions, %d connections failed\n",
+		(unsigned long long)transactions, elapsed, transactions / elapsed, (unsigned long long)errors, failed);
+	printf("Requests sent: FC1 %llu, FC3 %llu, FC16 %llu\n",
+		(unsigned long long)per_fc[0], (unsigned long long)per_fc[1], (unsigned long long)per_fc[2]);
+
+	if (transactions > 0)
+	{
+		printf("Latency: p50 %llu us  p99 %llu us  p99.9 %llu us  max %llu us\n",
+			(unsigned long long)histPercentile(latency, transactions, 0.50),
+			(unsigned long long)histPercentile(latency, transactions, 0.99),
+			(unsigned long long)histPercentile(latency, transactions, 0.999),
+			(unsigned long long)max_latency);
+	}
+
+	if (stats != NULL)
+	{
+		printf("Runtime: %llu scan cycles, %llu overruns during the test (worst overrun so far %llu us)\n",
+			(unsigned long long)(__atomic_load_n(&stats->cycles, __ATOMIC_RELAXED) - cycles_before),
+			(unsigned long long)(__atomic_load_n(&stats->overruns, __ATOMIC_RELAXED) - overruns_before),
+			(unsigned long long)__atomic_load_n(&stats->max_overrun_ns, __ATOMIC_RELAXED) / 1000);
+	}
+	else
+	{
+		printf("Runtime: scan statistics not available (/dev/shm%s not found)\n", SCAN_STATS_SHM);
+	}
+
+	return failed == opts.connections ? 1 : 0;
+}
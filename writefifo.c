@@ -1,38 +1,83 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <string.h>
-#include <pthread.h>
-#include <time.h>
-#include <signal.h>
 #include <stdlib.h>
 
-
+/*
+ * Sends a command to the control socket of novaplc and prints the answer:
+ *   ./writefifo [-s socket] START | PAUSE | STOP | STEP [n] | STATUS
+ *                           | FORCE <var> <value> | UNFORCE <var>|ALL
+ */
 int main(int argc, char *argv[])
 {
 int fd;
-char plcfifo[32];
-char	readlin[32];
-    sprintf(plcfifo,"/tmp/plcfifo");
+const char *path = "/tmp/novaplc.sock";
+char line[128];
+int first = 1;
+int len = 0;
+struct sockaddr_un addr;
 
-    printf("argc = %d\n",argc);
-    printf("argv = %s\n",argv[argc-1]);
+    if ( argc > 2 && strcmp(argv[1], "-s") == 0 )
+    {
+        path = argv[2];
+        first = 3;
+    }
 
-    if ( argc != 2)
+    if ( argc <= first )
     {
-	    printf("argc = %d\n",argc);
-	    exit(1);
+        printf("Usage: %s [-s socket] START | PAUSE | STOP | STEP [n] | STATUS | FORCE <var> <value> | UNFORCE <var>|ALL\n", argv[0]);
+        exit(1);
     }
 
-    bzero(readlin,32);
-    strcat(readlin,argv[argc-1]);
+    /* the socket takes lines of up to 127 characters, newline included */
+    for ( ; first < argc; first++ )
+    {
+        len += snprintf(line + len, sizeof(line) - 1 - len, "%s%s", len > 0 ? " " : "", argv[first]);
+        if ( len > (int)sizeof(line) - 2 )
+        {
+            printf("Command too long\n");
+            exit(1);
+        }
+    }
+    line[len++] = '\n';
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if ( fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 )
+    {
+        perror(path);
+        exit(1);
+    }
 
+    if ( write(fd, line, len) != len )
+    {
+        perror("write");
+        exit(1);
+    }
 
-    fd = open(plcfifo, O_WRONLY);
-    write(fd, readlin, strlen(readlin));
+    /* the answer is a single line, STEP answers once the scans have run */
+    len = 0;
+    while ( len < (int)sizeof(line) - 1 )
+    {
+        int n = read(fd, line + len, sizeof(line) - 1 - len);
+        if ( n <= 0 )
+            break;
+        len += n;
+        if ( line[len - 1] == '\n' )
+            break;
+    }
     close(fd);
 
-    exit(0);
+    line[len] = '\0';
+    printf("%s", line);
+
+    exit(strncmp(line, "OK", 2) == 0 ? 0 : 1);
 }